@@ -7,7 +7,7 @@
 QT       += core gui webkit sql network phonon
 INCLUDEPATH += src/
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
 TARGET = CloudClient
 TEMPLATE = app
@@ -59,7 +59,20 @@ SOURCES += src/main.cpp\
     src/urllineedit.cpp \
     src/searchlineedit.cpp \
     src/simpleeditor.cpp \
-    src/unifiedpage.cpp
+    src/unifiedpage.cpp \
+    src/taskcache.cpp \
+    src/jsonreader.cpp \
+    src/requestscheduler.cpp \
+    src/taskstore.cpp \
+    src/trafficrecorder.cpp \
+    src/replaynetworkmanager.cpp \
+    src/daemon.cpp \
+    src/bencodereader.cpp \
+    src/torrentfile.cpp \
+    src/magnetlink.cpp \
+    src/functionfields.cpp \
+    src/searchindex.cpp \
+    src/tasktreemodel.cpp
 
 HEADERS  += src/mainwindow.h \
     src/thundercore.h \
@@ -84,7 +97,20 @@ HEADERS  += src/mainwindow.h \
     src/searchlineedit.h \
     src/simpleeditor.h \
     src/unifiedpage.h \
-    src/config.h
+    src/config.h \
+    src/taskcache.h \
+    src/jsonreader.h \
+    src/requestscheduler.h \
+    src/taskstore.h \
+    src/trafficrecorder.h \
+    src/replaynetworkmanager.h \
+    src/daemon.h \
+    src/bencodereader.h \
+    src/torrentfile.h \
+    src/magnetlink.h \
+    src/functionfields.h \
+    src/searchindex.h \
+    src/tasktreemodel.h
 
 FORMS    += ui/mainwindow.ui \
     ui/thunderpanel.ui \
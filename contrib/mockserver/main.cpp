@@ -0,0 +1,99 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTimer>
+#include <cstdio>
+
+#include "mockserver.h"
+
+static void usage ()
+{
+    printf ("Usage: mockserver [options]\n"
+            "  --port N                listen on port N (8080)\n"
+            "  --tasks N               tasks in the account (1000)\n"
+            "  --bt-files N            files in every BT task (20)\n"
+            "  --bt-percent N          share of BT tasks (10)\n"
+            "  --unfinished-percent N  share of tasks still downloading (5)\n"
+            "  --latency MSECS         delay of every response (0)\n"
+            "  --jitter MSECS          random extra delay (0)\n"
+            "\n"
+            "Point the client at it with\n"
+            "  [Server]\n"
+            "  BaseUrl=http://127.0.0.1:8080\n");
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    MockServer::Options options;
+    int port = 8080;
+
+    const QStringList & args = a.arguments();
+    for (int i = 1; i < args.size(); ++i)
+    {
+        const QString & arg = args.at(i);
+        if (arg == "--help" || arg == "-h" || i + 1 >= args.size())
+        {
+            usage ();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+
+        const int value = args.at(++i).toInt();
+
+        if (arg == "--port")
+            port = value;
+        else if (arg == "--tasks")
+            options.tasks = value;
+        else if (arg == "--bt-files")
+            options.btFiles = value;
+        else if (arg == "--bt-percent")
+            options.btPercent = value;
+        else if (arg == "--unfinished-percent")
+            options.unfinishedPercent = value;
+        else if (arg == "--latency")
+            options.latency = value;
+        else if (arg == "--jitter")
+            options.jitter = value;
+        else
+        {
+            usage ();
+            return 1;
+        }
+    }
+
+    MockServer server (options);
+    if (! server.listen(QHostAddress::LocalHost, port))
+    {
+        fprintf (stderr, "Cannot listen on port %d: %s\n",
+                 port, server.errorString().toLocal8Bit().constData());
+        return 1;
+    }
+
+    printf ("Serving %d task(s) on http://127.0.0.1:%d\n", options.tasks, port);
+    fflush (stdout);
+
+    /// Counters are printed whenever they changed
+    QTimer stats;
+    QObject::connect (&stats, SIGNAL(timeout()), &server, SLOT(printStats()));
+    stats.start(5000);
+
+    return a.exec();
+}
@@ -0,0 +1,549 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mockserver.h"
+
+#include <cstdio>
+
+// sub tasks per fill_bt_list page
+#define BT_PER_PAGE 30
+
+#define TASK_SIZE 734003200ULL
+
+MockServer::MockServer(const MockServer::Options &options, QObject *parent) :
+    QTcpServer(parent),
+    my_options (options),
+    my_printedTotal (0),
+    my_started (QDateTime::currentDateTime())
+{
+}
+
+void MockServer::incomingConnection(int handle)
+{
+    QTcpSocket *socket = new QTcpSocket (this);
+    socket->setSocketDescriptor(handle);
+
+    connect (socket, SIGNAL(readyRead()), SLOT(slotReadyRead()));
+    connect (socket, SIGNAL(disconnected()), SLOT(slotDisconnected()));
+}
+
+void MockServer::slotDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*> (sender());
+
+    my_buffers.remove(socket);
+    socket->deleteLater();
+}
+
+void MockServer::slotReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*> (sender());
+
+    QByteArray & buffer = my_buffers[socket];
+    buffer.append(socket->readAll());
+
+    /// Keep-alive connections carry one request after another
+    Request request;
+    while (takeRequest(buffer, request))
+    {
+        ++ my_counts[request.url.path()];
+        reply (socket, handle (request));
+    }
+}
+
+bool MockServer::takeRequest(QByteArray &buffer, MockServer::Request &request)
+{
+    const int headerEnd = buffer.indexOf("\r\n\r\n");
+    if (headerEnd < 0)
+        return false;
+
+    const QList<QByteArray> & lines = buffer.left(headerEnd).split('\n');
+    const QList<QByteArray> & requestLine = lines.first().trimmed().split(' ');
+    if (requestLine.size() < 2)
+    {
+        buffer.clear();
+        return false;
+    }
+
+    request.headers.clear();
+    for (int i = 1; i < lines.size(); ++i)
+    {
+        const int colon = lines.at(i).indexOf(':');
+        if (colon > 0)
+            request.headers.insert(lines.at(i).left(colon).trimmed().toLower(),
+                                   lines.at(i).mid(colon + 1).trimmed());
+    }
+
+    const int length = request.headers.value("content-length").toInt();
+    if (buffer.size() < headerEnd + 4 + length)
+        return false;
+
+    request.method = requestLine.at(0);
+    request.url    = QUrl::fromEncoded("http://localhost" + requestLine.at(1));
+    request.body   = buffer.mid(headerEnd + 4, length);
+
+    buffer.remove(0, headerEnd + 4 + length);
+    return true;
+}
+
+void MockServer::reply(QTcpSocket *socket, const MockServer::Response &response)
+{
+    QByteArray data = "HTTP/1.1 " + QByteArray::number(response.status) +
+            (response.status == 200 ? " OK" : " Not Found") + "\r\n"
+            "Content-Type: " + (response.contentType.isEmpty()
+                                ? QByteArray ("text/html; charset=utf-8")
+                                : response.contentType) + "\r\n"
+            "Content-Length: " + QByteArray::number(response.body.size()) + "\r\n"
+            "Connection: keep-alive\r\n";
+
+    foreach (const QByteArray & cookie, response.cookies)
+    {
+        data += "Set-Cookie: " + cookie + "; path=/\r\n";
+    }
+
+    data += "\r\n" + response.body;
+
+    int msecs = my_options.latency;
+    if (my_options.jitter > 0)
+        msecs += qrand() % (my_options.jitter + 1);
+
+    if (msecs <= 0)
+    {
+        socket->write(data);
+        return;
+    }
+
+    new DelayedWrite (socket, data, msecs);
+}
+
+MockServer::Response MockServer::handle(const MockServer::Request &request)
+{
+    const QString & path = request.url.path();
+
+    if (path == "/check")
+        return check (request);
+    if (path == "/image")
+        return captcha (request);
+    if (path.startsWith("/sec2login"))
+        return sec2login (request);
+    if (path == "/login")
+        return login (request);
+    if (path == "/interface/showtask_unfresh")
+        return showTasks (request);
+    if (path == "/interface/fill_bt_list")
+        return fillBTList (request);
+    if (path == "/interface/task_check")
+        return taskCheck (request);
+    if (path == "/interface/url_query")
+        return urlQuery (request);
+    if (path == "/interface/batch_task_check")
+        return batchTaskCheck (request);
+    if (path == "/interface/torrent_upload")
+        return torrentUpload (request);
+    if (path == "/interface/task_process")
+        return taskProcess (request);
+    if (path == "/interface/task_delay")
+        return taskDelay (request);
+    if (path.startsWith("/interface/") || path == "/user_history")
+        return plain (request);
+
+    Response response;
+    response.status = 404;
+    return response;
+}
+
+void MockServer::printStats()
+{
+    int total = 0;
+    foreach (int count, my_counts)
+    {
+        total += count;
+    }
+
+    if (total == my_printedTotal)
+        return;
+
+    my_printedTotal = total;
+    printf ("%d request(s) served\n", total);
+
+    QMapIterator<QString, int> it (my_counts);
+    while (it.hasNext())
+    {
+        it.next();
+        printf ("  %6d %s\n", it.value(), it.key().toLocal8Bit().constData());
+    }
+
+    fflush (stdout);
+}
+
+/////// Account
+
+bool MockServer::isBT(int index) const
+{
+    return my_options.btPercent > 0 && index % 100 < my_options.btPercent;
+}
+
+int MockServer::progress(int index) const
+{
+    /// The last few percent of every hundred tasks are still downloading
+    if (index % 100 < 100 - my_options.unfinishedPercent)
+        return 100;
+
+    return qMin (100, index % 50 + (int) my_started.secsTo(QDateTime::currentDateTime()));
+}
+
+bool MockServer::isFinished(int index) const
+{
+    return progress(index) == 100;
+}
+
+QByteArray MockServer::taskId(int index) const
+{
+    return QByteArray::number(Q_UINT64_C(150000000000) + index);
+}
+
+QByteArray MockServer::cid(int index) const
+{
+    return QByteArray::number(Q_UINT64_C(0x1234567890abcdef) + index, 16)
+            .repeated(3).left(40).toUpper();
+}
+
+QByteArray MockServer::quote(const QString &text)
+{
+    QByteArray result = "\"";
+    foreach (const QChar & c, text)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        result += QString (c).toUtf8();
+    }
+
+    return result + "\"";
+}
+
+QByteArray MockServer::taskJson(int index) const
+{
+    const QByteArray & id = taskId(index);
+    const bool finished = isFinished(index);
+
+    const QString & name = isBT(index)
+            ? QString ("Mock.Season.%1.Complete").arg(index)
+            : QString ("Mock.Movie.%1.720p.BluRay.x264.mkv").arg(index);
+    const QByteArray & source = isBT(index)
+            ? "bt://" + cid(index)
+            : "ed2k://|file|" + name.toUtf8() + "|" + QByteArray::number(TASK_SIZE) + "|" +
+              cid(index).left(32) + "|/";
+    const QByteArray & link = finished
+            ? "http:\\/\\/gdl.lixian.vip.xunlei.com\\/download?fid=" + cid(index) +
+              "&tid=" + id + "&g=" + cid(index)
+            : QByteArray ();
+
+    return "{\"id\":\"" + id + "\","
+            "\"url\":" + quote(QString::fromUtf8(source)) + ","
+            "\"cid\":\"" + cid(index) + "\","
+            "\"taskname\":" + quote(name) + ","
+            "\"lixian_url\":\"" + link + "\","
+            "\"ysfilesize\":\"" + QByteArray::number(TASK_SIZE + index) + "\","
+            "\"download_status\":\"" + (finished ? "2" : "1") + "\","
+            "\"progress\":\"" + QByteArray::number(progress(index)) + "\","
+            "\"left_live_time\":\"" + QByteArray::number(7 - index % 7) + "\\u5929\"}";
+}
+
+/////// Login
+
+MockServer::Response MockServer::check(const MockServer::Request &request)
+{
+    Q_UNUSED(request);
+
+    /// No captcha needed, the leading "0:" is stripped by the client
+    Response response;
+    response.cookies << "check_result=0:!mck";
+    return response;
+}
+
+MockServer::Response MockServer::captcha(const MockServer::Request &request)
+{
+    Q_UNUSED(request);
+
+    Response response;
+    response.contentType = "image/jpeg";
+    response.body = QByteArray (64, '\0');
+    return response;
+}
+
+MockServer::Response MockServer::sec2login(const MockServer::Request &request)
+{
+    Q_UNUSED(request);
+
+    Response response;
+    response.cookies << "blogresult=0"
+                     << "userid=12345678"
+                     << "usernick=mock"
+                     << "jumpkey=" + QByteArray::number(qrand(), 16).repeated(8)
+                     << "sessionid=" + QByteArray::number(qrand(), 16).repeated(4);
+    return response;
+}
+
+MockServer::Response MockServer::login(const MockServer::Request &request)
+{
+    Q_UNUSED(request);
+
+    Response response;
+    response.body = "<html><body>mock</body></html>";
+    return response;
+}
+
+/////// Task list
+
+MockServer::Response MockServer::showTasks(const MockServer::Request &request)
+{
+    Response response;
+    const QByteArray & callback = request.url.queryItemValue("callback").toAscii();
+
+    /// Same as an expired session on the real service
+    if (! request.headers.value("cookie").contains("jumpkey="))
+    {
+        response.body = callback + "({\"rtcode\":-11})";
+        return response;
+    }
+
+    const int perPage = qMax (1, request.url.queryItemValue("tasknum").toInt());
+    const int page    = qMax (1, request.url.queryItemValue("page").toInt());
+
+    QByteArray tasks;
+    for (int i = (page - 1) * perPage; i < qMin (page * perPage, my_options.tasks); ++i)
+    {
+        if (! tasks.isEmpty())
+            tasks += ",";
+        tasks += taskJson(i);
+    }
+
+    response.body = callback + "({\"rtcode\":0,\"info\":{"
+            "\"total_num\":\"" + QByteArray::number(my_options.tasks) + "\","
+            "\"user\":{\"cookie\":\"MOCKGDRIVEID\",\"max_store\":\"10995116277760\"},"
+            "\"tasks\":[" + tasks + "]}})";
+    return response;
+}
+
+MockServer::Response MockServer::fillBTList(const MockServer::Request &request)
+{
+    const QByteArray & tid = request.url.queryItemValue("tid").toAscii();
+    const int page = qMax (1, request.url.queryItemValue("p").toInt());
+
+    QByteArray records;
+    for (int i = (page - 1) * BT_PER_PAGE; i < qMin (page * BT_PER_PAGE, my_options.btFiles); ++i)
+    {
+        if (! records.isEmpty())
+            records += ",";
+
+        records += "{\"id\":\"" + QByteArray::number(i) + "\","
+                "\"title\":\"Mock.Episode." + QByteArray::number(i) + ".mkv\","
+                "\"filesize\":\"" + QByteArray::number(TASK_SIZE / 20 + i) + "\","
+                "\"download_status\":\"2\","
+                "\"downurl\":\"http:\\/\\/gdl.lixian.vip.xunlei.com\\/download?tid=" +
+                tid + "&index=" + QByteArray::number(i) + "\"}";
+    }
+
+    /// The client skips exactly "fill_bt_list("
+    Response response;
+    response.body = "fill_bt_list({\"Result\":{"
+            "\"Tid\":\"" + tid + "\","
+            "\"Infoid\":\"" + request.url.queryItemValue("infoid").toAscii() + "\","
+            "\"Record\":[" + records + "],"
+            "\"now_page\":" + QByteArray::number(page) + ","
+            "\"btnum\":" + QByteArray::number(my_options.btFiles) + ","
+            "\"btpernum\":" + QByteArray::number(BT_PER_PAGE) + "}})";
+    return response;
+}
+
+/////// Adding tasks
+
+MockServer::Response MockServer::taskCheck(const MockServer::Request &request)
+{
+    const QString & url = request.url.queryItemValue("url");
+    const QString & name = url.section('|', 2, 2).isEmpty()
+            ? url.section('/', -1)
+            : url.section('|', 2, 2);
+
+    Response response;
+    response.body = request.url.queryItemValue("callback").toAscii() +
+            "('" + cid(qHash(url) % 100000) + "','" + cid(qHash(url) % 100000).left(20) + "','" +
+            QByteArray::number(TASK_SIZE) + "','0','" + name.toUtf8() +
+            "','0','0','0','0','0','0')";
+    return response;
+}
+
+MockServer::Response MockServer::urlQuery(const MockServer::Request &request)
+{
+    QByteArray names, sizes, rawSizes, unknown, exts, indexes;
+    for (int i = 0; i < my_options.btFiles; ++i)
+    {
+        const char *separator = i > 0 ? "," : "";
+
+        names    += separator + ("'Mock.Episode." + QByteArray::number(i) + ".mkv'");
+        sizes    += separator + QByteArray ("'35M'");
+        rawSizes += separator + ("'" + QByteArray::number(TASK_SIZE / 20 + i) + "'");
+        unknown  += separator + QByteArray ("'0'");
+        exts     += separator + QByteArray ("'mkv'");
+        indexes  += separator + ("'" + QByteArray::number(i) + "'");
+    }
+
+    /// queryUrl(flag, infoid, size, title, full, 6 arrays, 2 trailing fields)
+    Response response;
+    response.body = request.url.queryItemValue("callback").toAscii() +
+            "(1,'" + cid(qHash(request.url.queryItemValue("u")) % 100000) + "','" +
+            QByteArray::number(TASK_SIZE) + "','Mock.Magnet.Folder','0'" +
+            ",new Array(" + names + ")" +
+            ",new Array(" + sizes + ")" +
+            ",new Array(" + rawSizes + ")" +
+            ",new Array(" + unknown + ")" +
+            ",new Array(" + exts + ")" +
+            ",new Array(" + indexes + ")" +
+            ",'0','0')";
+    return response;
+}
+
+MockServer::Response MockServer::batchTaskCheck(const MockServer::Request &request)
+{
+    QUrl form;
+    form.setEncodedQuery(request.body);
+
+    QByteArray items;
+    foreach (const QString & url,
+             form.queryItemValue("url").split(QRegExp("[\r\n]+"), QString::SkipEmptyParts))
+    {
+        if (! items.isEmpty())
+            items += ",";
+
+        items += "{\"url\":" + quote(url) + ","
+                "\"name\":" + quote(url.section('/', -1)) + ","
+                "\"filesize\":\"" + QByteArray::number(TASK_SIZE) + "\","
+                "\"formatsize\":\"700M\"}";
+    }
+
+    Response response;
+    response.body = "<script>document.domain='xunlei.com';parent.begin_task_batch_resp(["
+            + items + "],'123456');</script>";
+    return response;
+}
+
+MockServer::Response MockServer::torrentUpload(const MockServer::Request &request)
+{
+    Q_UNUSED(request);
+
+    QByteArray files;
+    for (int i = 0; i < my_options.btFiles; ++i)
+    {
+        if (! files.isEmpty())
+            files += ",";
+
+        files += "{\"id\":\"" + QByteArray::number(i) + "\","
+                "\"subtitle\":\"Mock.Episode." + QByteArray::number(i) + ".mkv\","
+                "\"subformatsize\":\"35M\","
+                "\"subsize\":\"" + QByteArray::number(TASK_SIZE / 20 + i) + "\","
+                "\"findex\":\"" + QByteArray::number(i) + "\"}";
+    }
+
+    /// The client skips 51 leading and 10 trailing bytes
+    Response response;
+    response.body = "<script>document.domain=\"xunlei.com\";var btResult ="
+            "{\"ret_value\":1,\"infoid\":\"" + cid(my_options.tasks) + "\","
+            "\"ftitle\":\"Mock.Torrent.Folder\","
+            "\"btsize\":\"" + QByteArray::number(TASK_SIZE) + "\","
+            "\"filelist\":[" + files + "]};</script>";
+    return response;
+}
+
+/////// Housekeeping
+
+MockServer::Response MockServer::taskProcess(const MockServer::Request &request)
+{
+    QUrl form;
+    form.setEncodedQuery(request.body);
+
+    QByteArray records;
+    foreach (const QString & id, form.queryItemValue("list").split(",", QString::SkipEmptyParts))
+    {
+        const int index = (int) (id.toULongLong() - Q_UINT64_C(150000000000));
+        if (index < 0 || index >= my_options.tasks)
+            continue;
+
+        if (! records.isEmpty())
+            records += ",";
+
+        records += "{\"tid\":\"" + id.toAscii() + "\","
+                "\"download_status\":\"" + (isFinished(index) ? "2" : "1") + "\","
+                "\"percent\":\"" + QByteArray::number(progress(index)) + "\","
+                "\"lixian_url\":\"" + (isFinished(index)
+                                       ? "http:\\/\\/gdl.lixian.vip.xunlei.com\\/download?fid=" +
+                                         cid(index)
+                                       : QByteArray ()) + "\"}";
+    }
+
+    Response response;
+    response.body = request.url.queryItemValue("callback").toAscii() +
+            "({\"Process\":{\"Record\":[" + records + "],\"Task\":{}}})";
+    return response;
+}
+
+MockServer::Response MockServer::taskDelay(const MockServer::Request &request)
+{
+    QByteArray list;
+    foreach (const QString & item,
+             request.url.queryItemValue("taskids").split(",", QString::SkipEmptyParts))
+    {
+        if (! list.isEmpty())
+            list += ",";
+
+        list += "{\"tid\":\"" + item.section('_', 0, 0).toAscii() + "\","
+                "\"result\":1,\"left_live_time\":\"7\\u5929\"}";
+    }
+
+    Response response;
+    response.body = "task_delay_resp({\"result\":1,\"list\":[" + list + "]})";
+    return response;
+}
+
+MockServer::Response MockServer::plain(const MockServer::Request &request)
+{
+    QByteArray callback = request.url.queryItemValue("callback").toAscii();
+    if (callback.isEmpty())
+        callback = "a";
+
+    Response response;
+    response.body = callback + "({\"result\":1})";
+    return response;
+}
+
+/////// DelayedWrite
+
+DelayedWrite::DelayedWrite(QTcpSocket *socket, const QByteArray &data, int msecs) :
+    QObject(socket),
+    my_socket (socket),
+    my_data (data)
+{
+    QTimer::singleShot(msecs, this, SLOT(slotWrite()));
+}
+
+void DelayedWrite::slotWrite()
+{
+    if (my_socket)
+        my_socket->write(my_data);
+
+    deleteLater();
+}
@@ -0,0 +1,153 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MOCKSERVER_H
+#define MOCKSERVER_H
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QPointer>
+#include <QTimer>
+#include <QHash>
+#include <QMap>
+#include <QUrl>
+#include <QDateTime>
+#include <QStringList>
+
+/*!
+ * \brief Stand-in for the Xunlei cloud endpoints used by ThunderCore,
+ *        serving a generated account over plain HTTP/1.1.
+ *
+ *        Every host of the real service is folded into this one server,
+ *        point ThunderCore at it with Server/BaseUrl.
+ */
+class MockServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    struct Options
+    {
+        Options () : tasks (1000), btFiles (20), btPercent (10),
+            unfinishedPercent (5), latency (0), jitter (0) {}
+
+        // account size
+        int tasks, btFiles, btPercent, unfinishedPercent;
+
+        // msecs added to each response
+        int latency, jitter;
+    };
+
+    explicit MockServer(const Options & options, QObject *parent = 0);
+
+    /*!
+     * \brief Requests served so far, by path
+     */
+    const QMap<QString, int> & requestCounts () const { return my_counts; }
+
+public slots:
+    void printStats ();
+
+protected:
+    void incomingConnection (int handle);
+
+private:
+    struct Request
+    {
+        QByteArray method;
+        QUrl url;
+        QHash<QByteArray, QByteArray> headers;
+        QByteArray body;
+    };
+
+    struct Response
+    {
+        Response () : status (200) {}
+
+        int status;
+        QByteArray contentType;
+        QList<QByteArray> cookies;
+        QByteArray body;
+    };
+
+    Options my_options;
+    QMap<QString, int> my_counts;
+    int my_printedTotal;
+
+    /*!
+     * \brief Unfinished tasks progress as time goes by
+     */
+    QDateTime my_started;
+
+    /*!
+     * \brief Bytes received per connection, until a request is complete
+     */
+    QHash<QTcpSocket*, QByteArray> my_buffers;
+
+    bool takeRequest (QByteArray & buffer, Request & request);
+    Response handle (const Request & request);
+    void reply (QTcpSocket *socket, const Response & response);
+
+    Response check (const Request & request);
+    Response captcha (const Request & request);
+    Response sec2login (const Request & request);
+    Response login (const Request & request);
+    Response showTasks (const Request & request);
+    Response fillBTList (const Request & request);
+    Response taskCheck (const Request & request);
+    Response urlQuery (const Request & request);
+    Response batchTaskCheck (const Request & request);
+    Response torrentUpload (const Request & request);
+    Response taskProcess (const Request & request);
+    Response taskDelay (const Request & request);
+    Response plain (const Request & request);
+
+    /*!
+     * \brief Generated account, tasks are derived from their index
+     */
+    bool isBT (int index) const;
+    bool isFinished (int index) const;
+    int progress (int index) const;
+    QByteArray taskId (int index) const;
+    QByteArray cid (int index) const;
+    QByteArray taskJson (int index) const;
+
+    static QByteArray quote (const QString & text);
+
+private slots:
+    void slotReadyRead ();
+    void slotDisconnected ();
+};
+
+/*!
+ * \brief Holds a response back for the configured latency
+ */
+class DelayedWrite : public QObject
+{
+    Q_OBJECT
+public:
+    DelayedWrite (QTcpSocket *socket, const QByteArray & data, int msecs);
+
+private:
+    QPointer<QTcpSocket> my_socket;
+    QByteArray my_data;
+
+private slots:
+    void slotWrite ();
+};
+
+#endif // MOCKSERVER_H
@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Mock Xunlei cloud server, see main.cpp for options
+#
+#-------------------------------------------------
+
+QT       += core network
+QT       -= gui
+
+TARGET = mockserver
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+SOURCES += main.cpp \
+    mockserver.cpp
+
+HEADERS += mockserver.h
@@ -0,0 +1,43 @@
+#-------------------------------------------------
+#
+# Decoders benchmarked on a capture, run with
+# CLOUDCLIENT_CAPTURE=file.cap ./tst_capture, where file.cap
+# was written by CloudClient --record-traffic file.cap
+#
+#-------------------------------------------------
+
+QT       += core gui network webkit sql testlib
+
+TARGET = tst_capture
+
+include(../tests.pri)
+
+LIBS += -lqjson
+
+SOURCES += tst_capture.cpp \
+    $$SRC/thundercore.cpp \
+    $$SRC/util.cpp \
+    $$SRC/taskcache.cpp \
+    $$SRC/jsonreader.cpp \
+    $$SRC/requestscheduler.cpp \
+    $$SRC/taskstore.cpp \
+    $$SRC/trafficrecorder.cpp \
+    $$SRC/replaynetworkmanager.cpp \
+    $$SRC/bencodereader.cpp \
+    $$SRC/torrentfile.cpp \
+    $$SRC/magnetlink.cpp \
+    $$SRC/functionfields.cpp
+
+HEADERS += $$SRC/thundercore.h \
+    $$SRC/CloudObject.h \
+    $$SRC/util.h \
+    $$SRC/taskcache.h \
+    $$SRC/jsonreader.h \
+    $$SRC/requestscheduler.h \
+    $$SRC/taskstore.h \
+    $$SRC/trafficrecorder.h \
+    $$SRC/replaynetworkmanager.h \
+    $$SRC/bencodereader.h \
+    $$SRC/torrentfile.h \
+    $$SRC/magnetlink.h \
+    $$SRC/functionfields.h
@@ -0,0 +1,272 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+
+#include "replies.h"
+#include "thundercore.h"
+#include "trafficrecorder.h"
+
+// replies of each kind in the generated capture, and tasks or files in each
+#define FIXTURE_REPLIES 20
+#define FIXTURE_ITEMS 500
+
+/*!
+ * \brief Decoders run on the replies of a capture, a real one when
+ *        CLOUDCLIENT_CAPTURE names a file written with --record-traffic,
+ *        a generated one otherwise
+ */
+class TestCapture : public QObject
+{
+    Q_OBJECT
+public:
+    TestCapture ();
+
+private:
+    QString my_path;
+    bool my_generated;
+
+    // reply bodies by ThunderCore::RequestKind
+    QHash<int, QList<QByteArray> > my_bodies;
+
+    bool writeFixture (const QString & path) const;
+
+    /*!
+     * \return tasks or files decoded, -1 on error
+     */
+    static int decodeBody (int kind, const QByteArray & body);
+
+private slots:
+    void initTestCase ();
+    void cleanupTestCase ();
+
+    void fixtureRoundTrip ();
+
+    void decode_data ();
+    void decode ();
+};
+
+TestCapture::TestCapture() :
+    my_generated (false)
+{
+}
+
+bool TestCapture::writeFixture(const QString &path) const
+{
+    TrafficRecorder recorder;
+    if (! recorder.open(path))
+        return false;
+
+    TrafficRecord record;
+    record.operation = QNetworkAccessManager::GetOperation;
+    record.status    = 200;
+    record.elapsed   = 120;
+    record.headerNames  << "Content-Type";
+    record.headerValues << "text/html; charset=utf-8";
+
+    for (int i = 0; i < FIXTURE_REPLIES; ++i)
+    {
+        const QByteArray & page = QByteArray::number(i + 1);
+
+        record.kind = ThunderCore::TaskPage;
+        record.url  = "http://dynamic.cloud.vip.xunlei.com/interface/showtask_unfresh?p=" + page;
+        record.body = Replies::cloudPage(FIXTURE_ITEMS);
+        recorder.record(record);
+
+        record.kind = ThunderCore::BTFolder;
+        record.url  = "http://dynamic.cloud.vip.xunlei.com/interface/fill_bt_list?p=" + page;
+        record.body = Replies::btFolder(FIXTURE_ITEMS);
+        recorder.record(record);
+
+        record.kind = ThunderCore::UrlQuery;
+        record.url  = "http://dynamic.cloud.vip.xunlei.com/interface/url_query?random=" + page;
+        record.body = Replies::urlQuery(FIXTURE_ITEMS);
+        recorder.record(record);
+    }
+
+    record.operation = QNetworkAccessManager::PostOperation;
+    for (int i = 0; i < FIXTURE_REPLIES; ++i)
+    {
+        record.kind = ThunderCore::TorrentUpload;
+        record.url  = "http://dynamic.cloud.vip.xunlei.com/interface/torrent_upload";
+        record.body = Replies::torrentUpload(FIXTURE_ITEMS);
+        recorder.record(record);
+    }
+
+    /// A form POST, checked by fixtureRoundTrip()
+    record.kind        = ThunderCore::TaskDelete;
+    record.url         = "http://dynamic.cloud.vip.xunlei.com/interface/task_delete";
+    record.body        = "delete_task_resp({\"result\":1})";
+    record.requestBody = "taskids=150000000000,&databases=0,";
+    recorder.record(record);
+
+    return true;
+}
+
+int TestCapture::decodeBody(int kind, const QByteArray &body)
+{
+    switch (kind)
+    {
+    case ThunderCore::TaskPage:
+    {
+        QList<Thunder::Task> tasks;
+        QString gdriveid;
+        int total = 0;
+
+        return ThunderCore::decodeCloudPage(body, tasks, total, gdriveid) ? tasks.size() : -1;
+    }
+    case ThunderCore::BTFolder:
+    {
+        Thunder::BitorrentTask bt_task;
+        int now_page, btnum, btpernum;
+        bool finished;
+
+        return ThunderCore::decodeBTFolderPage(body, bt_task, now_page, btnum, btpernum, finished)
+                ? bt_task.subtasks.size() : -1;
+    }
+    case ThunderCore::TorrentUpload:
+    {
+        Thunder::BitorrentTask bt_task;
+        return ThunderCore::decodeTorrentUpload(body, bt_task) ? bt_task.subtasks.size() : -1;
+    }
+    case ThunderCore::UrlQuery:
+    {
+        Thunder::BitorrentTask bt_task;
+        return ThunderCore::decodeUrlQuery(body, bt_task) ? bt_task.subtasks.size() : -1;
+    }
+    }
+
+    return -1;
+}
+
+void TestCapture::initTestCase()
+{
+    my_path = QString::fromLocal8Bit(qgetenv("CLOUDCLIENT_CAPTURE"));
+    if (my_path.isEmpty())
+    {
+        my_path = QDir::temp().filePath(QString ("tst_capture-%1.cap")
+                                        .arg(QCoreApplication::applicationPid()));
+        my_generated = true;
+
+        QVERIFY(writeFixture(my_path));
+    }
+
+    bool ok = false;
+    const QList<TrafficRecord> & records = TrafficRecorder::load(my_path, &ok);
+    QVERIFY2(ok, qPrintable(QString ("Not a capture: %1").arg(my_path)));
+
+    foreach (const TrafficRecord & record, records)
+    {
+        if (record.status == 200)
+            my_bodies[record.kind].append(record.body);
+    }
+
+    qDebug("%d records in %s", records.size(), qPrintable(my_path));
+}
+
+void TestCapture::cleanupTestCase()
+{
+    if (my_generated)
+        QFile::remove(my_path);
+}
+
+void TestCapture::fixtureRoundTrip()
+{
+    if (! my_generated)
+        QSKIP("Only the generated capture is known", SkipSingle);
+
+    const QList<TrafficRecord> & records = TrafficRecorder::load(my_path);
+    QCOMPARE(records.size(), 4 * FIXTURE_REPLIES + 1);
+
+    const TrafficRecord & first = records.first();
+    QCOMPARE(first.kind, (int) ThunderCore::TaskPage);
+    QCOMPARE(first.elapsed, 120);
+    QCOMPARE(first.headerNames, QList<QByteArray> () << "Content-Type");
+    QCOMPARE(first.body, Replies::cloudPage(FIXTURE_ITEMS));
+    QVERIFY(first.requestBody.isEmpty());
+
+    const TrafficRecord & last = records.last();
+    QCOMPARE(last.operation, (qint32) QNetworkAccessManager::PostOperation);
+    QCOMPARE(last.requestBody, QByteArray ("taskids=150000000000,&databases=0,"));
+
+    /// Not enough left of the record for it to be read
+    QFile file (my_path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+
+    const QString & truncated = my_path + ".truncated";
+    QFile copy (truncated);
+    QVERIFY(copy.open(QIODevice::WriteOnly));
+    copy.write(file.read(file.size() - 8));
+    copy.close();
+
+    bool ok = false;
+    QCOMPARE(TrafficRecorder::load(truncated, &ok).size(), 4 * FIXTURE_REPLIES);
+    QVERIFY(ok);
+
+    QFile::remove(truncated);
+}
+
+void TestCapture::decode_data()
+{
+    QTest::addColumn<int>("kind");
+
+    QTest::newRow("showtask_unfresh/decodeCloudPage") << (int) ThunderCore::TaskPage;
+    QTest::newRow("url_query/decodeUrlQuery") << (int) ThunderCore::UrlQuery;
+    QTest::newRow("fill_bt_list/decodeBTFolderPage") << (int) ThunderCore::BTFolder;
+    QTest::newRow("torrent_upload/decodeTorrentUpload") << (int) ThunderCore::TorrentUpload;
+}
+
+void TestCapture::decode()
+{
+    QFETCH(int, kind);
+
+    const QList<QByteArray> & bodies = my_bodies.value(kind);
+    if (bodies.isEmpty())
+        QSKIP("No such reply in the capture", SkipSingle);
+
+    int decoded = 0, items = 0;
+    QBENCHMARK {
+        decoded = items = 0;
+        foreach (const QByteArray & body, bodies)
+        {
+            const int count = decodeBody(kind, body);
+            if (count >= 0)
+            {
+                ++ decoded;
+                items += count;
+            }
+        }
+    }
+
+    qDebug("%d of %d replies decoded, %d tasks or files", decoded, bodies.size(), items);
+
+    /// A real capture may hold error pages too
+    if (my_generated)
+        QCOMPARE(items, FIXTURE_REPLIES * FIXTURE_ITEMS);
+    else
+        QVERIFY(decoded > 0);
+}
+
+/// Nothing here needs an event loop or a display
+QTEST_APPLESS_MAIN(TestCapture)
+
+#include "tst_capture.moc"
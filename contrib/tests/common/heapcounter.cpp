@@ -0,0 +1,163 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "heapcounter.h"
+
+#if defined(__GLIBC__)
+
+#include <cstddef>
+#include <cerrno>
+#include <malloc.h>
+
+extern "C" {
+void *__libc_malloc (size_t size);
+void *__libc_calloc (size_t count, size_t size);
+void *__libc_realloc (void *ptr, size_t size);
+void *__libc_memalign (size_t alignment, size_t size);
+void  __libc_free (void *ptr);
+}
+
+namespace {
+
+qint64 heap_current = 0;
+qint64 heap_peak    = 0;
+
+void countAllocated (void *ptr)
+{
+    if (! ptr)
+        return;
+
+    const qint64 now = __sync_add_and_fetch (&heap_current, (qint64) malloc_usable_size (ptr));
+
+    qint64 peak = heap_peak;
+    while (now > peak && ! __sync_bool_compare_and_swap (&heap_peak, peak, now))
+        peak = heap_peak;
+}
+
+void countFreed (void *ptr)
+{
+    if (ptr)
+        __sync_sub_and_fetch (&heap_current, (qint64) malloc_usable_size (ptr));
+}
+
+}
+
+/// The executable comes first in symbol lookup, these take over from glibc
+/// for Qt and everything else loaded
+extern "C" {
+
+void *malloc (size_t size)
+{
+    void *ptr = __libc_malloc (size);
+    countAllocated (ptr);
+    return ptr;
+}
+
+void *calloc (size_t count, size_t size)
+{
+    void *ptr = __libc_calloc (count, size);
+    countAllocated (ptr);
+    return ptr;
+}
+
+void *realloc (void *ptr, size_t size)
+{
+    countFreed (ptr);
+
+    void *result = __libc_realloc (ptr, size);
+
+    /// The old block stays if it could not be moved
+    countAllocated (result || size == 0 ? result : ptr);
+    return result;
+}
+
+void *memalign (size_t alignment, size_t size)
+{
+    void *ptr = __libc_memalign (alignment, size);
+    countAllocated (ptr);
+    return ptr;
+}
+
+void *aligned_alloc (size_t alignment, size_t size)
+{
+    return memalign (alignment, size);
+}
+
+int posix_memalign (void **result, size_t alignment, size_t size)
+{
+    if (alignment % sizeof (void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    void *ptr = memalign (alignment, size);
+    if (! ptr && size != 0)
+        return ENOMEM;
+
+    *result = ptr;
+    return 0;
+}
+
+void free (void *ptr)
+{
+    countFreed (ptr);
+    __libc_free (ptr);
+}
+
+}
+
+bool HeapCounter::isAvailable()
+{
+    return true;
+}
+
+qint64 HeapCounter::current()
+{
+    return heap_current;
+}
+
+qint64 HeapCounter::peak()
+{
+    return heap_peak;
+}
+
+void HeapCounter::resetPeak()
+{
+    heap_peak = heap_current;
+}
+
+#else
+
+bool HeapCounter::isAvailable()
+{
+    return false;
+}
+
+qint64 HeapCounter::current()
+{
+    return 0;
+}
+
+qint64 HeapCounter::peak()
+{
+    return 0;
+}
+
+void HeapCounter::resetPeak()
+{
+}
+
+#endif
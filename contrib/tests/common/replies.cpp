@@ -0,0 +1,127 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "replies.h"
+
+QByteArray Replies::urlQuery(int files)
+{
+    QByteArray names, sizes, rawSizes, unknown, exts, indexes;
+    for (int i = 0; i < files; ++i)
+    {
+        const char *separator = i > 0 ? "," : "";
+
+        names    += separator + ("'Mock.Episode." + QByteArray::number(i) + ".mkv'");
+        sizes    += separator + QByteArray ("'35M'");
+        rawSizes += separator + ("'" + QByteArray::number(36700160 + i) + "'");
+        unknown  += separator + QByteArray ("'0'");
+        exts     += separator + QByteArray ("'mkv'");
+        indexes  += separator + ("'" + QByteArray::number(i) + "'");
+    }
+
+    QByteArray reply = "queryUrl(1,'0123456789ABCDEF0123456789ABCDEF01234567','734003200',"
+            "'Mock.Magnet.Folder','0'";
+
+    reply += ",new Array(" + names + ")";
+    reply += ",new Array(" + sizes + ")";
+    reply += ",new Array(" + rawSizes + ")";
+    reply += ",new Array(" + unknown + ")";
+    reply += ",new Array(" + exts + ")";
+    reply += ",new Array(" + indexes + ")";
+
+    return reply + ",'0','0')";
+}
+
+QByteArray Replies::cloudPage(int tasks)
+{
+    QByteArray items;
+    for (int i = 0; i < tasks; ++i)
+    {
+        const QByteArray & id  = QByteArray::number(Q_UINT64_C(150000000000) + i);
+        const QByteArray & cid = QByteArray::number(Q_UINT64_C(0x1234567890abcdef) + i, 16)
+                .repeated(3).left(40).toUpper();
+        const QByteArray & name = "Mock.Movie." + QByteArray::number(i) + ".720p.BluRay.x264.mkv";
+
+        if (! items.isEmpty())
+            items += ",";
+
+        items += "{\"id\":\"" + id + "\","
+                "\"url\":\"ed2k://|file|" + name + "|734003200|" + cid.left(32) + "|/\","
+                "\"cid\":\"" + cid + "\","
+                "\"taskname\":\"" + name + "\","
+                "\"lixian_url\":\"http:\\/\\/gdl.lixian.vip.xunlei.com\\/download?fid=" + cid +
+                "&tid=" + id + "\","
+                "\"ysfilesize\":\"" + QByteArray::number(734003200 + i) + "\","
+                "\"download_status\":\"2\","
+                "\"progress\":\"100\","
+                "\"openformat\":\"movie\","
+                "\"left_live_time\":\"" + QByteArray::number(7 - i % 7) + "\\u5929\"}";
+    }
+
+    return "tc({\"rtcode\":0,\"info\":{"
+            "\"total_num\":\"" + QByteArray::number(tasks) + "\","
+            "\"user\":{\"cookie\":\"MOCKGDRIVEID\",\"max_store\":\"10995116277760\"},"
+            "\"tasks\":[" + items + "]}})";
+}
+
+QByteArray Replies::btFolder(int records)
+{
+    QByteArray items;
+    for (int i = 0; i < records; ++i)
+    {
+        if (! items.isEmpty())
+            items += ",";
+
+        items += "{\"id\":\"" + QByteArray::number(i) + "\","
+                "\"title\":\"Mock.Episode." + QByteArray::number(i) + ".mkv\","
+                "\"filesize\":\"" + QByteArray::number(36700160 + i) + "\","
+                "\"download_status\":\"2\","
+                "\"downurl\":\"http:\\/\\/gdl.lixian.vip.xunlei.com\\/download?tid=150000000000"
+                "&index=" + QByteArray::number(i) + "\"}";
+    }
+
+    return "fill_bt_list({\"Result\":{"
+            "\"Tid\":\"150000000000\","
+            "\"Infoid\":\"0123456789ABCDEF0123456789ABCDEF01234567\","
+            "\"Record\":[" + items + "],"
+            "\"now_page\":1,"
+            "\"btnum\":" + QByteArray::number(records) + ","
+            "\"btpernum\":" + QByteArray::number(records) + "}})";
+}
+
+QByteArray Replies::torrentUpload(int files)
+{
+    QByteArray items;
+    for (int i = 0; i < files; ++i)
+    {
+        if (! items.isEmpty())
+            items += ",";
+
+        items += "{\"id\":\"" + QByteArray::number(i) + "\","
+                "\"subtitle\":\"Mock.Episode." + QByteArray::number(i) + ".mkv\","
+                "\"subformatsize\":\"35M\","
+                "\"subsize\":\"" + QByteArray::number(36700160 + i) + "\","
+                "\"findex\":\"" + QByteArray::number(i) + "\"}";
+    }
+
+    /// 51 leading and 10 trailing bytes are skipped
+    return "<script>document.domain=\"xunlei.com\";var btResult ="
+            "{\"ret_value\":1,\"infoid\":\"0123456789ABCDEF0123456789ABCDEF01234567\","
+            "\"ftitle\":\"Mock.Torrent.Folder\","
+            "\"btsize\":\"734003200\","
+            "\"filelist\":[" + items + "]};</script>";
+}
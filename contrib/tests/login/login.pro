@@ -0,0 +1,48 @@
+#-------------------------------------------------
+#
+# Login against the mock server running in process,
+# run with ./tst_login
+#
+#-------------------------------------------------
+
+QT       += core gui network webkit sql testlib
+
+TARGET = tst_login
+
+include(../tests.pri)
+
+MOCK = $$PWD/../../mockserver
+
+INCLUDEPATH += $$MOCK
+
+LIBS += -lqjson
+
+SOURCES += tst_login.cpp \
+    $$MOCK/mockserver.cpp \
+    $$SRC/thundercore.cpp \
+    $$SRC/util.cpp \
+    $$SRC/taskcache.cpp \
+    $$SRC/jsonreader.cpp \
+    $$SRC/requestscheduler.cpp \
+    $$SRC/taskstore.cpp \
+    $$SRC/trafficrecorder.cpp \
+    $$SRC/replaynetworkmanager.cpp \
+    $$SRC/bencodereader.cpp \
+    $$SRC/torrentfile.cpp \
+    $$SRC/magnetlink.cpp \
+    $$SRC/functionfields.cpp
+
+HEADERS += $$MOCK/mockserver.h \
+    $$SRC/thundercore.h \
+    $$SRC/CloudObject.h \
+    $$SRC/util.h \
+    $$SRC/taskcache.h \
+    $$SRC/jsonreader.h \
+    $$SRC/requestscheduler.h \
+    $$SRC/taskstore.h \
+    $$SRC/trafficrecorder.h \
+    $$SRC/replaynetworkmanager.h \
+    $$SRC/bencodereader.h \
+    $$SRC/torrentfile.h \
+    $$SRC/magnetlink.h \
+    $$SRC/functionfields.h
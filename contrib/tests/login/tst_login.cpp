@@ -0,0 +1,143 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest>
+#include <QApplication>
+#include <QDesktopServices>
+#include <QFile>
+#include <QSettings>
+
+#include "mockserver.h"
+#include "thundercore.h"
+
+// msecs to wait for the whole task list
+#define LOGIN_TIMEOUT 30000
+
+/*!
+ * \brief Full login against MockServer running in this process
+ */
+class TestLogin : public QObject
+{
+    Q_OBJECT
+
+private:
+    /*!
+     * \brief Requests MockServer served for paths starting with prefix
+     */
+    static int served (const MockServer & server, const QString & prefix);
+
+private slots:
+    void cleanupTestCase ();
+
+    void login_data ();
+    void login ();
+};
+
+int TestLogin::served(const MockServer &server, const QString &prefix)
+{
+    int count = 0;
+
+    QMapIterator<QString, int> it (server.requestCounts());
+    while (it.hasNext())
+    {
+        it.next();
+        if (it.key().startsWith(prefix))
+            count += it.value();
+    }
+
+    return count;
+}
+
+void TestLogin::cleanupTestCase()
+{
+    QSettings settings;
+    settings.clear();
+}
+
+void TestLogin::login_data()
+{
+    QTest::addColumn<int>("tasks");
+    QTest::addColumn<int>("latency");
+
+    QTest::newRow("1000 tasks") << 1000 << 0;
+    QTest::newRow("1000 tasks, 20 ms latency") << 1000 << 20;
+    QTest::newRow("5000 tasks") << 5000 << 0;
+}
+
+void TestLogin::login()
+{
+    QFETCH(int, tasks);
+    QFETCH(int, latency);
+
+    MockServer::Options options;
+    options.tasks   = tasks;
+    options.latency = latency;
+
+    MockServer server (options);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QSettings settings;
+    settings.setValue("Server/BaseUrl",
+                      QString ("http://127.0.0.1:%1").arg(server.serverPort()));
+    settings.sync();
+
+    /// A new account each time, a stored session would skip the login
+    const QString & user = QString ("mock-%1-%2")
+            .arg(QCoreApplication::applicationPid()).arg(QTest::currentDataTag());
+
+    ThunderCore *core = new ThunderCore;
+    core->login(user, Util::getMD5Hex("secret"));
+
+    for (int waited = 0; core->getLoginDuration() == 0 && waited < LOGIN_TIMEOUT; waited += 50)
+        QTest::qWait(50);
+
+    qDebug("%d tasks in %lld ms", core->getCloudTasks().size(), core->getLoginDuration());
+
+    QVERIFY(core->getLoginDuration() > 0);
+    QCOMPARE(core->getLoginStatus(), ThunderCore::NoError);
+    QCOMPARE(core->getCloudTasks().size(), tasks);
+
+    /// Every reply of the login is accounted for by both ends
+    QCOMPARE(served(server, "/check"), 1);
+    QCOMPARE(core->getRequestStats(ThunderCore::LoginCheck).count, 1);
+    QCOMPARE(core->getRequestStats(ThunderCore::Sec2Login).count, served(server, "/sec2login"));
+    QCOMPARE(core->getRequestStats(ThunderCore::CloudLogin).count, served(server, "/login"));
+
+    const int pages = served(server, "/interface/showtask_unfresh");
+    QVERIFY(pages > 0);
+    QCOMPARE(core->getRequestStats(ThunderCore::TaskPage).count, pages);
+
+    delete core;
+
+    const QString & cache = QDesktopServices::storageLocation(QDesktopServices::DataLocation)
+            + "/cache-" + Util::getMD5Hex(user) + ".sqlite";
+    QFile::remove(cache);
+}
+
+/// QtGui is linked for QDesktopServices, no display is needed
+int main(int argc, char *argv[])
+{
+    QApplication app (argc, argv, false);
+    app.setOrganizationName("CloudClient Tests");
+    app.setApplicationName("tst_login");
+
+    TestLogin test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_login.moc"
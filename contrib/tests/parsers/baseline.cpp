@@ -0,0 +1,224 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "baseline.h"
+#include "util.h"
+
+#include <QDateTime>
+#include <QVariant>
+
+#include "qjson/parser.h"
+
+QStringList Baseline::parseFunctionFields(const QByteArray &d)
+{
+    QByteArray data = d;
+    data.remove(0, data.indexOf("("));
+    data.chop(1);
+
+    QStringList result;
+    bool inQuote = false;
+    int field = 1;
+    int lastPos = 0;
+
+    for (int i = 0; i < data.size(); ++i)
+    {
+        if (data.at(i) == ' ' || data.at(i) == '\t')
+            continue;
+        else if (data.at(i) == '\'')
+        {
+            if (i > 0)
+            {
+                if (data.at(i - 1) == '\\')
+                {
+                    continue;
+                }
+            }
+
+            if (inQuote)
+            {
+                result.append(QString::fromUtf8(data.mid(lastPos + 1, i - lastPos - 1)));
+                inQuote = false;
+            }
+            else
+            {
+                inQuote = true;
+                lastPos = i;
+            }
+        }
+        else if (data.at(i) == ',')
+        {
+            if (! inQuote)
+            {
+                ++ field;
+            }
+        }
+        else if (! inQuote)
+        {
+            int j = i;
+            while (data.at(j) >= '0' && data.at(j) <= '9' && ++j < data.size());
+            if (j != i)
+            {
+                result.append(QString::fromUtf8(data.mid (i, j - i)));
+                i = j;
+            }
+        }
+    }
+
+    return result;
+}
+
+bool Baseline::decodeCloudPage(const QByteArray &body,
+                               QList<Thunder::Task> &tasks,
+                               int &total_task_num,
+                               QString &gdriveid)
+{
+    QVariantMap json_map, json_info, user_info;
+    QJson::Parser parser;
+    bool ok = false;
+    QByteArray json = body; json.chop(1); json.remove(0, 3);
+    QVariant result = parser.parse(json, &ok);
+
+    if (! ok)
+        return false;
+
+    json_map = result.toMap();
+    if (! json_map.contains("info"))
+        return false;
+
+    json_info = json_map.value("info").toMap();
+    total_task_num = json_info.value("total_num").toInt();
+    if (! json_info.contains("tasks"))
+        return false;
+
+    user_info = json_info.value("user").toMap();
+    if (user_info.isEmpty())
+        return false;
+
+    gdriveid = user_info.value("cookie").toString();
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+
+    foreach (const QVariant & taskItem, json_info.value("tasks").toList())
+    {
+        const QVariantMap & taskMap = taskItem.toMap();
+
+        Thunder::Task task;
+        task.id       = taskMap.value("id").toULongLong();
+        task.type     = Thunder::Single;
+        task.source   = taskMap.value("url").toString().toUtf8();
+        task.cid      = taskMap.value("cid").toString().toAscii();
+        task.name     = taskMap.value("taskname").toString();
+        task.link     = taskMap.value("lixian_url").toString().toUtf8();
+        task.size     = taskMap.value("ysfilesize").toULongLong();
+        task.status   = taskMap.value("download_status").toInt();
+        task.progress = taskMap.value("progress").toInt();
+
+        const int secs = Util::parseLiveTime(taskMap.value("left_live_time").toString());
+        if (secs >= 0)
+            task.expires = now + secs;
+
+        if (! task.isEmpty())
+            tasks.append(task);
+    }
+
+    return true;
+}
+
+bool Baseline::decodeBTFolderPage(const QByteArray &data,
+                                  Thunder::BitorrentTask &bt_task,
+                                  int &now_page, int &btnum, int &btpernum,
+                                  bool &finished)
+{
+    QByteArray json = data;
+
+    // remove a(
+    json.remove (0, 13);
+
+    // chop )
+    json.chop (1);
+
+    QJson::Parser parser;
+    bool ok = false;
+    QVariant result = parser.parse(json, &ok);
+
+    if (! ok)
+        return false;
+
+    result = result.toMap().value("Result");
+
+    const QVariantMap & resultMap = result.toMap();
+
+    now_page = resultMap.value ("now_page").toInt();
+    btnum = resultMap.value("btnum").toInt();
+    btpernum = resultMap.value("btpernum").toInt();
+    finished = resultMap.size() != 0;
+
+    bt_task.taskid = resultMap.value("Tid").toString();
+
+    foreach (const QVariant & record, resultMap.value("Record").toList())
+    {
+        const QVariantMap & map = record.toMap();
+        Thunder::BTSubTask subtask;
+
+        subtask.id = map.value("id").toString();
+        subtask.size = Util::toReadableSize(map.value("filesize").toULongLong());
+        subtask.link = map.value("downurl").toString().replace("\\/", "/");
+        subtask.name = map.value("title").toString();
+
+        bt_task.subtasks.append(subtask);
+    }
+
+    return true;
+}
+
+bool Baseline::decodeTorrentUpload(const QByteArray &data, Thunder::BitorrentTask &bt_task)
+{
+    QByteArray json = data;
+
+    // remove btResult =
+    json.remove (0, 51);
+
+    // chop </script>
+    json.chop (10);
+
+    QJson::Parser parser;
+    bool ok = false;
+    QVariant result = parser.parse(json, &ok);
+
+    if (! ok)
+        return false;
+
+    bt_task.subtasks.clear();
+    bt_task.ftitle = result.toMap().value("ftitle").toString();
+    bt_task.infoid = result.toMap().value("infoid").toString();
+    bt_task.btsize = result.toMap().value("btsize").toULongLong();
+
+    foreach (const QVariant & item, result.toMap().value("filelist").toList())
+    {
+        QVariantMap map = item.toMap();
+        Thunder::BTSubTask task;
+        task.name = map.value("subtitle").toString();
+        task.format_size = map.value("subformatsize").toString();
+        task.size = map.value("subsize").toString();
+        task.id = map.value("id").toString();
+        task.findex = map.value("findex").toString();
+        bt_task.subtasks.append(task);
+    }
+
+    return true;
+}
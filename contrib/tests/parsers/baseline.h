@@ -0,0 +1,53 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include <QByteArray>
+#include <QStringList>
+
+#include "CloudObject.h"
+
+/*!
+ * \brief Parsers as they were before being replaced, kept to benchmark
+ *        the current ones against
+ */
+namespace Baseline
+{
+    /*!
+     * \brief Util::parseFunctionFields before FunctionFields
+     */
+    QStringList parseFunctionFields (const QByteArray & d);
+
+    /*!
+     * \brief QJson decoding of showtask_unfresh, fill_bt_list and
+     *        torrent_upload replies, before JsonReader
+     */
+    bool decodeCloudPage (const QByteArray & body,
+                          QList<Thunder::Task> & tasks,
+                          int & total_task_num,
+                          QString & gdriveid);
+    bool decodeBTFolderPage (const QByteArray & data,
+                             Thunder::BitorrentTask & bt_task,
+                             int & now_page, int & btnum, int & btpernum,
+                             bool & finished);
+    bool decodeTorrentUpload (const QByteArray & data, Thunder::BitorrentTask & bt_task);
+}
+
+#endif // BASELINE_H
@@ -0,0 +1,44 @@
+#-------------------------------------------------
+#
+# Parser benchmarks against the parsers they replaced,
+# run with ./tst_parsers [-iterations N]
+#
+#-------------------------------------------------
+
+QT       += core gui network webkit sql testlib
+
+TARGET = tst_parsers
+
+include(../tests.pri)
+
+LIBS += -lqjson
+
+SOURCES += tst_parsers.cpp \
+    baseline.cpp \
+    $$SRC/thundercore.cpp \
+    $$SRC/util.cpp \
+    $$SRC/taskcache.cpp \
+    $$SRC/jsonreader.cpp \
+    $$SRC/requestscheduler.cpp \
+    $$SRC/taskstore.cpp \
+    $$SRC/trafficrecorder.cpp \
+    $$SRC/replaynetworkmanager.cpp \
+    $$SRC/bencodereader.cpp \
+    $$SRC/torrentfile.cpp \
+    $$SRC/magnetlink.cpp \
+    $$SRC/functionfields.cpp
+
+HEADERS += baseline.h \
+    $$SRC/thundercore.h \
+    $$SRC/CloudObject.h \
+    $$SRC/util.h \
+    $$SRC/taskcache.h \
+    $$SRC/jsonreader.h \
+    $$SRC/requestscheduler.h \
+    $$SRC/taskstore.h \
+    $$SRC/trafficrecorder.h \
+    $$SRC/replaynetworkmanager.h \
+    $$SRC/bencodereader.h \
+    $$SRC/torrentfile.h \
+    $$SRC/magnetlink.h \
+    $$SRC/functionfields.h
@@ -0,0 +1,380 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest>
+#include <QByteArray>
+#include <QStringList>
+
+#include "baseline.h"
+#include "functionfields.h"
+#include "heapcounter.h"
+#include "replies.h"
+#include "thundercore.h"
+
+// files in the generated url_query reply
+#define URL_QUERY_FILES 20000
+
+// tasks in the generated showtask_unfresh reply, records and files of the
+// fill_bt_list and torrent_upload replies
+#define CLOUD_PAGE_TASKS 10000
+#define BT_FOLDER_RECORDS 10000
+#define TORRENT_FILES 10000
+
+class TestParsers : public QObject
+{
+    Q_OBJECT
+public:
+    TestParsers ();
+
+private:
+    enum Reply
+    {
+        CloudPage,
+        BTFolderPage,
+        TorrentUpload
+    };
+
+    QByteArray my_urlQuery;
+    QByteArray my_replies[3];
+
+    /*!
+     * \brief Decode a reply with JsonReader or QJson
+     * \return tasks or files decoded, -1 on error
+     */
+    int decodeReply (Reply reply, bool baseline) const;
+
+private slots:
+    void functionFieldsMatchBaseline ();
+    void functionFieldsEscapes ();
+    void functionFieldsNestedArrays ();
+
+    void urlQuery_data ();
+    void urlQuery ();
+
+    void decodersMatchBaseline ();
+
+    void decode_data ();
+    void decode ();
+
+    void peakMemory_data ();
+    void peakMemory ();
+};
+
+TestParsers::TestParsers() :
+    my_urlQuery (Replies::urlQuery (URL_QUERY_FILES))
+{
+    my_replies[CloudPage]     = Replies::cloudPage(CLOUD_PAGE_TASKS);
+    my_replies[BTFolderPage]  = Replies::btFolder(BT_FOLDER_RECORDS);
+    my_replies[TorrentUpload] = Replies::torrentUpload(TORRENT_FILES);
+}
+
+int TestParsers::decodeReply(TestParsers::Reply reply, bool baseline) const
+{
+    const QByteArray & data = my_replies[reply];
+
+    switch (reply)
+    {
+    case CloudPage:
+    {
+        QList<Thunder::Task> tasks;
+        QString gdriveid;
+        int total = 0;
+
+        const bool ok = baseline
+                ? Baseline::decodeCloudPage(data, tasks, total, gdriveid)
+                : ThunderCore::decodeCloudPage(data, tasks, total, gdriveid);
+
+        return ok ? tasks.size() : -1;
+    }
+    case BTFolderPage:
+    {
+        Thunder::BitorrentTask bt_task;
+        int now_page, btnum, btpernum;
+        bool finished;
+
+        const bool ok = baseline
+                ? Baseline::decodeBTFolderPage(data, bt_task, now_page, btnum, btpernum, finished)
+                : ThunderCore::decodeBTFolderPage(data, bt_task, now_page, btnum, btpernum, finished);
+
+        return ok ? bt_task.subtasks.size() : -1;
+    }
+    case TorrentUpload:
+    {
+        Thunder::BitorrentTask bt_task;
+
+        const bool ok = baseline
+                ? Baseline::decodeTorrentUpload(data, bt_task)
+                : ThunderCore::decodeTorrentUpload(data, bt_task);
+
+        return ok ? bt_task.subtasks.size() : -1;
+    }
+    }
+
+    return -1;
+}
+
+void TestParsers::functionFieldsMatchBaseline()
+{
+    const QStringList & expected = Baseline::parseFunctionFields(my_urlQuery);
+    const FunctionFields fields (my_urlQuery);
+
+    QVERIFY(! fields.hasError());
+    QCOMPARE(fields.argumentCount(), 13);
+    QCOMPARE(fields.countOf(5), URL_QUERY_FILES);
+    QCOMPARE(fields.countOf(10), URL_QUERY_FILES);
+    QCOMPARE(fields.size(), expected.size());
+
+    for (int i = 0; i < fields.size(); ++i)
+        QCOMPARE(fields.at(i), expected.at(i));
+}
+
+void TestParsers::functionFieldsEscapes()
+{
+    const FunctionFields fields ("cb('it\\'s','a\\\\b',\"say \\\"hi\\\"\","
+                                 "'\\u4e2d\\u6587.mkv','tab\\there','a,b','c)d')");
+
+    QVERIFY(! fields.hasError());
+    QCOMPARE(fields.argumentCount(), 7);
+    QCOMPARE(fields.size(), 7);
+
+    QCOMPARE(fields.at(0), QString ("it's"));
+    QCOMPARE(fields.at(1), QString ("a\\b"));
+    QCOMPARE(fields.at(2), QString ("say \"hi\""));
+    QCOMPARE(fields.at(3), QString::fromUtf8("\xe4\xb8\xad\xe6\x96\x87.mkv"));
+    QCOMPARE(fields.at(4), QString ("tab\there"));
+    QCOMPARE(fields.at(5), QString ("a,b"));
+    QCOMPARE(fields.at(6), QString ("c)d"));
+
+    QVERIFY(! fields.field(5).escaped);
+
+    /// Unterminated string
+    QVERIFY(FunctionFields ("cb('abc)").hasError());
+}
+
+void TestParsers::functionFieldsNestedArrays()
+{
+    const FunctionFields fields ("cb(1,new Array(new Array('a','b'),['c',2]),[],'d',-3)");
+
+    QVERIFY(! fields.hasError());
+    QCOMPARE(fields.argumentCount(), 5);
+
+    QCOMPARE(fields.countOf(0), 1);
+    QCOMPARE(fields.toULongLong(fields.firstOf(0)), Q_UINT64_C(1));
+
+    /// Nested arrays are flattened into their top level argument
+    QCOMPARE(fields.countOf(1), 4);
+    QCOMPARE(fields.at(fields.firstOf(1)), QString ("a"));
+    QCOMPARE(fields.at(fields.firstOf(1) + 1), QString ("b"));
+    QCOMPARE(fields.at(fields.firstOf(1) + 2), QString ("c"));
+    QCOMPARE(fields.at(fields.firstOf(1) + 3), QString ("2"));
+    QCOMPARE(fields.field(fields.firstOf(1) + 3).argument, 1);
+
+    QCOMPARE(fields.countOf(2), 0);
+
+    QCOMPARE(fields.countOf(3), 1);
+    QCOMPARE(fields.at(fields.firstOf(3)), QString ("d"));
+    QCOMPARE(fields.at(fields.firstOf(4)), QString ("-3"));
+
+    /// Unbalanced
+    QVERIFY(FunctionFields ("cb(1,new Array('a')").hasError());
+}
+
+void TestParsers::urlQuery_data()
+{
+    QTest::addColumn<bool>("baseline");
+
+    QTest::newRow("Util::parseFunctionFields") << true;
+    QTest::newRow("FunctionFields") << false;
+}
+
+void TestParsers::urlQuery()
+{
+    QFETCH(bool, baseline);
+
+    int count = 0;
+
+    /// Both decode every field, as decodeUrlQuery() does
+    if (baseline)
+    {
+        QBENCHMARK {
+            count = Baseline::parseFunctionFields(my_urlQuery).size();
+        }
+    }
+    else
+    {
+        QBENCHMARK {
+            const FunctionFields fields (my_urlQuery);
+
+            QStringList result;
+            result.reserve(fields.size());
+
+            for (int i = 0; i < fields.size(); ++i)
+                result.append(fields.at(i));
+
+            count = result.size();
+        }
+    }
+
+    QCOMPARE(count, 6 * URL_QUERY_FILES + 7);
+}
+
+void TestParsers::decodersMatchBaseline()
+{
+    QList<Thunder::Task> tasks, expectedTasks;
+    QString gdriveid, expectedGdriveid;
+    int total = 0, expectedTotal = 0;
+
+    QVERIFY(ThunderCore::decodeCloudPage(my_replies[CloudPage], tasks, total, gdriveid));
+    QVERIFY(Baseline::decodeCloudPage(my_replies[CloudPage],
+                                      expectedTasks, expectedTotal, expectedGdriveid));
+
+    QCOMPARE(total, CLOUD_PAGE_TASKS);
+    QCOMPARE(total, expectedTotal);
+    QCOMPARE(gdriveid, expectedGdriveid);
+    QCOMPARE(tasks.size(), expectedTasks.size());
+
+    for (int i = 0; i < tasks.size(); ++i)
+    {
+        const Thunder::Task & task = tasks.at(i), & expected = expectedTasks.at(i);
+
+        QCOMPARE(task.id, expected.id);
+        QCOMPARE(task.name, expected.name);
+        QCOMPARE(task.cid, expected.cid);
+        QCOMPARE(task.link, expected.link);
+        QCOMPARE(task.source, expected.source);
+        QCOMPARE(task.size, expected.size);
+        QCOMPARE((int) task.status, (int) expected.status);
+        QCOMPARE((int) task.progress, (int) expected.progress);
+
+        /// Both read the clock
+        QVERIFY(qAbs ((qint64) task.expires - (qint64) expected.expires) <= 1);
+    }
+
+    Thunder::BitorrentTask folder, expectedFolder;
+    int now_page, btnum, btpernum, expectedPage, expectedBtnum, expectedBtpernum;
+    bool finished, expectedFinished;
+
+    QVERIFY(ThunderCore::decodeBTFolderPage(my_replies[BTFolderPage], folder,
+                                            now_page, btnum, btpernum, finished));
+    QVERIFY(Baseline::decodeBTFolderPage(my_replies[BTFolderPage], expectedFolder,
+                                         expectedPage, expectedBtnum, expectedBtpernum,
+                                         expectedFinished));
+
+    QCOMPARE(now_page, expectedPage);
+    QCOMPARE(btnum, expectedBtnum);
+    QCOMPARE(btpernum, expectedBtpernum);
+    QCOMPARE(finished, expectedFinished);
+    QCOMPARE(folder.taskid, expectedFolder.taskid);
+    QCOMPARE(folder.subtasks.size(), BT_FOLDER_RECORDS);
+    QCOMPARE(folder.subtasks.size(), expectedFolder.subtasks.size());
+
+    for (int i = 0; i < folder.subtasks.size(); ++i)
+    {
+        QCOMPARE(folder.subtasks.at(i).id, expectedFolder.subtasks.at(i).id);
+        QCOMPARE(folder.subtasks.at(i).name, expectedFolder.subtasks.at(i).name);
+        QCOMPARE(folder.subtasks.at(i).size, expectedFolder.subtasks.at(i).size);
+        QCOMPARE(folder.subtasks.at(i).link, expectedFolder.subtasks.at(i).link);
+    }
+
+    Thunder::BitorrentTask torrent, expectedTorrent;
+
+    QVERIFY(ThunderCore::decodeTorrentUpload(my_replies[TorrentUpload], torrent));
+    QVERIFY(Baseline::decodeTorrentUpload(my_replies[TorrentUpload], expectedTorrent));
+
+    QCOMPARE(torrent.ftitle, expectedTorrent.ftitle);
+    QCOMPARE(torrent.infoid, expectedTorrent.infoid);
+    QCOMPARE(torrent.btsize, expectedTorrent.btsize);
+    QCOMPARE(torrent.subtasks.size(), TORRENT_FILES);
+    QCOMPARE(torrent.subtasks.size(), expectedTorrent.subtasks.size());
+
+    for (int i = 0; i < torrent.subtasks.size(); ++i)
+    {
+        QCOMPARE(torrent.subtasks.at(i).id, expectedTorrent.subtasks.at(i).id);
+        QCOMPARE(torrent.subtasks.at(i).name, expectedTorrent.subtasks.at(i).name);
+        QCOMPARE(torrent.subtasks.at(i).size, expectedTorrent.subtasks.at(i).size);
+        QCOMPARE(torrent.subtasks.at(i).format_size, expectedTorrent.subtasks.at(i).format_size);
+        QCOMPARE(torrent.subtasks.at(i).findex, expectedTorrent.subtasks.at(i).findex);
+    }
+}
+
+void TestParsers::decode_data()
+{
+    QTest::addColumn<int>("reply");
+    QTest::addColumn<bool>("baseline");
+    QTest::addColumn<int>("expected");
+
+    QTest::newRow("showtask_unfresh/JsonReader") << (int) CloudPage << false << CLOUD_PAGE_TASKS;
+    QTest::newRow("showtask_unfresh/QJson") << (int) CloudPage << true << CLOUD_PAGE_TASKS;
+    QTest::newRow("fill_bt_list/JsonReader") << (int) BTFolderPage << false << BT_FOLDER_RECORDS;
+    QTest::newRow("fill_bt_list/QJson") << (int) BTFolderPage << true << BT_FOLDER_RECORDS;
+    QTest::newRow("torrent_upload/JsonReader") << (int) TorrentUpload << false << TORRENT_FILES;
+    QTest::newRow("torrent_upload/QJson") << (int) TorrentUpload << true << TORRENT_FILES;
+}
+
+void TestParsers::decode()
+{
+    QFETCH(int, reply);
+    QFETCH(bool, baseline);
+    QFETCH(int, expected);
+
+    int count = 0;
+    QBENCHMARK {
+        count = decodeReply((Reply) reply, baseline);
+    }
+
+    QCOMPARE(count, expected);
+}
+
+void TestParsers::peakMemory_data()
+{
+    QTest::addColumn<int>("reply");
+
+    QTest::newRow("showtask_unfresh") << (int) CloudPage;
+    QTest::newRow("fill_bt_list") << (int) BTFolderPage;
+    QTest::newRow("torrent_upload") << (int) TorrentUpload;
+}
+
+void TestParsers::peakMemory()
+{
+    if (! HeapCounter::isAvailable())
+        QSKIP("Heap usage is only counted with glibc", SkipAll);
+
+    QFETCH(int, reply);
+
+    qint64 peaks[2];
+    for (int baseline = 0; baseline < 2; ++baseline)
+    {
+        const qint64 before = HeapCounter::current();
+        HeapCounter::resetPeak();
+
+        QVERIFY(decodeReply((Reply) reply, baseline) > 0);
+
+        peaks[baseline] = HeapCounter::peak() - before;
+    }
+
+    qDebug("Peak heap, reply of %d bytes: JsonReader %lld KiB, QJson %lld KiB",
+           my_replies[reply].size(), peaks[0] / 1024, peaks[1] / 1024);
+
+    /// Structs only, against a copy of the reply and a QVariant tree
+    QVERIFY(peaks[0] < peaks[1]);
+}
+
+/// Nothing here needs an event loop or a display
+QTEST_APPLESS_MAIN(TestParsers)
+
+#include "tst_parsers.moc"
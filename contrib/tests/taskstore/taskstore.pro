@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Memory per task of TaskStore, run with ./tst_taskstore
+#
+#-------------------------------------------------
+
+QT       += core gui network testlib
+
+TARGET = tst_taskstore
+
+include(../tests.pri)
+
+SOURCES += tst_taskstore.cpp \
+    $$SRC/taskstore.cpp \
+    $$SRC/util.cpp
+
+HEADERS += $$SRC/taskstore.h \
+    $$SRC/CloudObject.h \
+    $$SRC/util.h
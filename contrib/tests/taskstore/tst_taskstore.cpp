@@ -0,0 +1,147 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest>
+#include <QDateTime>
+
+#include "heapcounter.h"
+#include "taskstore.h"
+
+// an archive account holds this many tasks, and should stay under 100 MB
+#define ACCOUNT_TASKS 100000
+#define BYTES_PER_TASK_MAX 1024
+
+class TestTaskStore : public QObject
+{
+    Q_OBJECT
+
+private:
+    /*!
+     * \brief Tasks with field lengths as seen on real accounts
+     */
+    static QList<Thunder::Task> syntheticTasks (int count);
+
+    /*!
+     * \brief Heap payload of implicitly shared strings, header included
+     */
+    static qint64 payloadBytes (const QByteArray & data);
+    static qint64 payloadBytes (const QString & data);
+
+private slots:
+    void memoryPerTask_data ();
+    void memoryPerTask ();
+
+    void setTasks ();
+};
+
+QList<Thunder::Task> TestTaskStore::syntheticTasks(int count)
+{
+    QList<Thunder::Task> tasks;
+    tasks.reserve(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        Thunder::Task task;
+        task.id       = Q_UINT64_C(150000000000) + i;
+        task.size     = 700 * 1024 * 1024 + i;
+        task.expires  = QDateTime::currentMSecsSinceEpoch() / 1000 + 7 * 86400;
+        task.status   = i % 3;
+        task.type     = i % 10 == 0 ? Thunder::BT : Thunder::Single;
+        task.progress = i % 101;
+        task.cid      = QByteArray::number(Q_UINT64_C(0x1234567890abcdef) + i, 16)
+                .repeated(3).left(40).toUpper();
+        task.name     = QString::fromUtf8("[Archive] Some.Movie.Title.2012.720p.BluRay.x264-%1.mkv")
+                .arg(i);
+        task.source   = "ed2k://|file|Some.Movie.Title.2012.720p.BluRay.x264-" +
+                QByteArray::number(i) + ".mkv|734003200|0123456789ABCDEF0123456789ABCDEF|/";
+        task.link     = "http://gdl.lixian.vip.xunlei.com/download?fid=" +
+                QByteArray(120, 'x') + "&mid=666&threshold=150&tid=" +
+                task.cid + "&srcid=4&verno=1&g=" + task.cid + "&ui=" +
+                QByteArray::number(i) + "&s=734003200&pt=0&ti=0";
+        tasks.append(task);
+    }
+
+    return tasks;
+}
+
+qint64 TestTaskStore::payloadBytes(const QByteArray &data)
+{
+    return data.isEmpty() ? 0 : 24 + data.capacity() + 1;
+}
+
+qint64 TestTaskStore::payloadBytes(const QString &data)
+{
+    return data.isEmpty() ? 0 : 24 + 2 * (data.capacity() + 1);
+}
+
+void TestTaskStore::memoryPerTask_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("100k") << ACCOUNT_TASKS;
+}
+
+void TestTaskStore::memoryPerTask()
+{
+    QFETCH(int, count);
+
+    const qint64 before = HeapCounter::current();
+
+    TaskStore store;
+    store.setTasks(syntheticTasks (count));
+
+    const qint64 after = HeapCounter::current();
+
+    qint64 payload = 0;
+    foreach (const Thunder::Task & task, store.tasks())
+    {
+        payload += sizeof (Thunder::Task) + sizeof (void*) +
+                payloadBytes(task.cid) + payloadBytes(task.name) +
+                payloadBytes(task.link) + payloadBytes(task.source);
+    }
+
+    qDebug("sizeof(Task) = %d bytes, estimated payload %lld bytes per task",
+           (int) sizeof (Thunder::Task), payload / count);
+
+    if (! HeapCounter::isAvailable())
+        QSKIP("Heap usage is only counted with glibc", SkipSingle);
+
+    /// Indexes included
+    qDebug("Heap growth: %lld bytes per task, %s for all tasks",
+           (after - before) / count,
+           qPrintable(Util::toReadableSize(after - before)));
+
+    QVERIFY((after - before) / count < BYTES_PER_TASK_MAX);
+}
+
+void TestTaskStore::setTasks()
+{
+    const QList<Thunder::Task> & tasks = syntheticTasks (ACCOUNT_TASKS);
+
+    /// Copying the list and building the indexes
+    QBENCHMARK {
+        TaskStore store;
+        store.setTasks(tasks);
+    }
+}
+
+/// Nothing here needs an event loop or a display
+QTEST_APPLESS_MAIN(TestTaskStore)
+
+#include "tst_taskstore.moc"
@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Shared by the test targets, sources of the client are
+# listed by each target from $$SRC
+#
+#-------------------------------------------------
+
+CONFIG   += console testcase
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+SRC = $$PWD/../../src
+
+INCLUDEPATH += $$SRC $$PWD/common
+
+SOURCES += $$PWD/common/heapcounter.cpp \
+    $$PWD/common/replies.cpp
+HEADERS += $$PWD/common/heapcounter.h \
+    $$PWD/common/replies.h
@@ -0,0 +1,12 @@
+#-------------------------------------------------
+#
+# Tests and benchmarks, one target each
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS = parsers \
+    taskstore \
+    capture \
+    login
@@ -20,6 +20,7 @@
 #define CLOUDOBJECT_H
 
 #include <QString>
+#include <QByteArray>
 #include <QUrl>
 #include <QIcon>
 
@@ -73,36 +74,63 @@ namespace Thunder
 
     struct BitorrentTask
     {
+        BitorrentTask () : btsize (0), page (0), complete (false) {}
+
         QString ftitle;
         QString infoid;
         QString taskid;
         unsigned long long btsize;
         QList<BTSubTask> subtasks;
+
+        /*!
+         * \brief Page carried by subtasks, page 1 replaces what was shown before
+         */
+        int page;
+
+        /*!
+         * \brief No more pages to come
+         */
+        bool complete;
     };
 
+    /*!
+     * \brief A cloud task, kept small since archive accounts hold 100k of them.
+     *        URLs and cid are ASCII / UTF-8 bytes, small fields are packed.
+     */
     struct Task
     {
+        Task () : id (0), size (0), expires (0), status (0), type (Single), progress (0) {}
+
         /*!
          * \brief Task ID
          */
-        QString id;
+        quint64 id;
 
         /*!
-         * \brief status 2=Done 1=No
+         * \brief Task size in bytes
+         */
+        unsigned long long size;
+
+        /*!
+         * \brief Expiry in secs since epoch, 0 if unknown
          */
-        int status;
+        quint32 expires;
 
-        QString cid;
+        /*!
+         * \brief status 2=Done 1=No
+         */
+        unsigned status   : 4;
 
         /*!
-         * \brief Task size in bytes
+         * \brief Task type, i.e single file or BT, see TaskType
          */
-        unsigned long long size;
+        unsigned type     : 2;
+        unsigned progress : 7;
 
         /*!
-         * \brief Task type, i.e single file or BT
+         * \brief Content id, hex encoded
          */
-        TaskType type;
+        QByteArray cid;
 
         /*!
          * \brief Display task name
@@ -112,24 +140,27 @@ namespace Thunder
         /*!
          * \brief Download link
          */
-        QString link, bt_url;
+        QByteArray link;
 
         /*!
-         * \brief Source address
+         * \brief Source address, UTF-8. bt:// for BT tasks
          */
-        QString source;
+        QByteArray source;
+
+        QString taskid () const
+        {
+            return QString::number(id);
+        }
 
-        bool finished()
+        bool finished() const
         {
             return status == 2;
         }
 
-        bool isEmpty()
+        bool isEmpty() const
         {
             return name.isEmpty();
         }
-
-        int progress;
     };
 
     struct File
@@ -18,11 +18,13 @@
 
 #include "addcloudtask.h"
 #include "ui_addcloudtask.h"
+#include <QHash>
+#include <QSet>
 
-#define OFFSET_SUBID 1
-#define OFFSET_SIZE 2
 #define OFFSET_URL 3
-#define OFFSET_FINDEX 3
+
+// rows are added for at most this many ms per event loop pass
+#define POPULATE_BUDGET 10
 
 AddCloudTask::AddCloudTask(ThunderCore *tc, QWidget *parent) :
     QDialog(parent),
@@ -30,6 +32,9 @@ AddCloudTask::AddCloudTask(ThunderCore *tc, QWidget *parent) :
     tcore (tc),
     bt_model(new QStandardItemModel),
     batch_model(new QStandardItemModel),
+    batch_totalSize (0),
+    bt_shownRows (0),
+    bt_localPreview (false),
     row_filter(QRegExp ("\\.(txt|url|html|htm|mht|exe|com)$"))
 {
     ui->setupUi(this);
@@ -51,6 +56,9 @@ AddCloudTask::AddCloudTask(ThunderCore *tc, QWidget *parent) :
 
     connect (tcore, SIGNAL(RemoteTaskChanged(ThunderCore::RemoteTaskType)),
              SLOT(slotRemoteTaskChanged(ThunderCore::RemoteTaskType)));
+
+    bt_populateTimer.setInterval(0);
+    connect (&bt_populateTimer, SIGNAL(timeout()), SLOT(slotPopulateBitorrentRows()));
 }
 
 AddCloudTask::~AddCloudTask()
@@ -84,6 +92,15 @@ void AddCloudTask::showEvent(QShowEvent *e)
 void AddCloudTask::loadBrowserLinks(const QString &urls)
 {
     ui->tabWidget->setCurrentIndex(2);
+    checkBatchTasks (urls);
+}
+
+void AddCloudTask::checkBatchTasks(const QString &urls)
+{
+    batch_model->setRowCount(0);
+    batch_totalSize = 0;
+
+    ui->sizeLabelBatchJob->setText(tr("Checking tasks .."));
     tcore->addBatchTaskPre (urls);
 }
 
@@ -107,42 +124,23 @@ void AddCloudTask::slotRemoteTaskChanged(ThunderCore::RemoteTaskType type)
         break;
     case ThunderCore::BitorrentTaskReady:
     {
-        bt_model->setRowCount(0);
         const Thunder::BitorrentTask & bttask = tcore->getUploadedBTTasks();
 
-        ui->sizeLabelBT->setText(tr("%1 (Total: %2)")
-                                 .arg(bttask.ftitle)
-                                 .arg(Util::toReadableSize(bttask.btsize)));
-
-        foreach (const Thunder::BTSubTask & task, bttask.subtasks)
-        {
-            QList<QStandardItem*> items;
-            items << new QStandardItem (task.format_size)
-                  << new QStandardItem (task.name);
-
-            for (int i = 0; i < items.size(); ++i)
-                items.at(i)->setTextAlignment(Qt::AlignCenter);
-
-            items.first()->setData(task.id, Qt::UserRole + OFFSET_SUBID);
-            items.first()->setData(task.size, Qt::UserRole + OFFSET_SIZE);
-            items.first()->setData(task.findex, Qt::UserRole + OFFSET_FINDEX);
-
-            bt_model->appendRow(items);
-
-            if (row_filter.indexIn(task.name.toLower()) == -1)
-                for (int i = 0; i < 2; ++ i)
-                    ui->tableViewBT->selectionModel()->select(
-                                bt_model->index(bt_model->rowCount() - 1, i),
-                                QItemSelectionModel::Select);
-        }
+        /// Keep the rows and selection of the local preview if every file
+        /// is found in the server listing, otherwise start over from it
+        const bool merged = bt_localPreview && mergeBitorrentTask(bttask);
+        bt_localPreview = false;
 
-        //        ui->tableViewBT->selectAll();
+        if (merged)
+            updateBitorrentOkButton();
+        else
+            showBitorrentTask(bttask);
     }
         break;
     case ThunderCore::BatchTaskReady:
     {
-        batch_model->setRowCount(0);
-        unsigned long long task_tot_size = 0;
+        /// One chunk of the list, appended to what arrived before
+        const int firstRow = batch_model->rowCount();
 
         foreach (const Thunder::BatchTask & batch_task, tcore->getUploadedBatchTasks())
         {
@@ -155,13 +153,22 @@ void AddCloudTask::slotRemoteTaskChanged(ThunderCore::RemoteTaskType type)
             for (int i = 0; i < items.size(); ++i)
                 items.at(i)->setTextAlignment(Qt::AlignCenter);
 
-            task_tot_size += batch_task.size;
+            batch_totalSize += batch_task.size;
             batch_model->appendRow(items);
         }
 
-        ui->tableViewBatch->selectAll();
-        ui->sizeLabelBatchJob->setText(tr("Total size of tasks: %1")
-                                       .arg(Util::toReadableSize(task_tot_size)));
+        if (batch_model->rowCount() > firstRow)
+            ui->tableViewBatch->selectionModel()->select(
+                        QItemSelection (batch_model->index(firstRow, 0),
+                                        batch_model->index(batch_model->rowCount() - 1, 1)),
+                        QItemSelectionModel::Select);
+
+        const QString & total = tr("Total size of tasks: %1")
+                .arg(Util::toReadableSize(batch_totalSize));
+
+        ui->sizeLabelBatchJob->setText(tcore->isBatchCheckPending()
+                                       ? tr("%1 (checking ..)").arg(total)
+                                       : total);
     }
         break;
     default:
@@ -170,6 +177,163 @@ void AddCloudTask::slotRemoteTaskChanged(ThunderCore::RemoteTaskType type)
     }
 }
 
+void AddCloudTask::showBitorrentTask(const Thunder::BitorrentTask &bttask)
+{
+    clearBitorrentRows();
+
+    bt_subtasks = bttask.subtasks;
+    bt_summary  = tr("%1 (Total: %2)")
+            .arg(bttask.ftitle)
+            .arg(Util::toReadableSize(bttask.btsize));
+
+    ui->sizeLabelBT->setText(bt_summary);
+
+    bt_populateTimer.start();
+    updateBitorrentOkButton();
+}
+
+bool AddCloudTask::mergeBitorrentTask(const Thunder::BitorrentTask &bttask)
+{
+    if (bttask.subtasks.size() != bt_subtasks.size())
+        return false;
+
+    QHash<QString, int> byFindex, byName;
+    for (int i = 0; i < bttask.subtasks.size(); ++i)
+    {
+        byFindex.insert(bttask.subtasks.at(i).findex, i);
+        byName.insert(bttask.subtasks.at(i).name, i);
+    }
+
+    /// Server entries in the order of the rows shown
+    QList<Thunder::BTSubTask> merged;
+    QSet<int> used;
+
+    foreach (const Thunder::BTSubTask & local, bt_subtasks)
+    {
+        /// Local findex is the index of the file in the torrent
+        int found = byFindex.value(local.findex, -1);
+        if (found < 0)
+            found = byName.value(local.name, -1);
+        if (found < 0)
+            found = byName.value(local.name.section('/', -1), -1);
+
+        if (found < 0 || used.contains(found))
+            return false;
+
+        used.insert(found);
+        merged.append(bttask.subtasks.at(found));
+    }
+
+    bt_subtasks = merged;
+    return true;
+}
+
+void AddCloudTask::clearBitorrentRows()
+{
+    bt_populateTimer.stop();
+    bt_subtasks.clear();
+    bt_shownRows = 0;
+
+    bt_model->setRowCount(0);
+    updateBitorrentOkButton();
+}
+
+void AddCloudTask::updateBitorrentOkButton()
+{
+    ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(
+                ! bt_localPreview && ! bt_populateTimer.isActive());
+}
+
+void AddCloudTask::slotPopulateBitorrentRows()
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    /// Wanted rows are selected in ranges, not cell by cell
+    QItemSelection selection;
+    int selectedFrom = -1;
+
+    while (bt_shownRows < bt_subtasks.size())
+    {
+        const Thunder::BTSubTask & task = bt_subtasks.at(bt_shownRows);
+
+        QList<QStandardItem*> items;
+        items << new QStandardItem (task.format_size)
+              << new QStandardItem (task.name);
+
+        for (int i = 0; i < items.size(); ++i)
+            items.at(i)->setTextAlignment(Qt::AlignCenter);
+
+        bt_model->appendRow(items);
+
+        const bool wanted = row_filter.indexIn(task.name.toLower()) == -1;
+        if (wanted && selectedFrom < 0)
+            selectedFrom = bt_shownRows;
+        else if (! wanted && selectedFrom >= 0)
+        {
+            selection.select(bt_model->index(selectedFrom, 0),
+                             bt_model->index(bt_shownRows - 1, 1));
+            selectedFrom = -1;
+        }
+
+        ++ bt_shownRows;
+
+        if (bt_shownRows % 64 == 0 && elapsed.elapsed() >= POPULATE_BUDGET)
+            break;
+    }
+
+    if (selectedFrom >= 0)
+        selection.select(bt_model->index(selectedFrom, 0),
+                         bt_model->index(bt_shownRows - 1, 1));
+
+    if (! selection.isEmpty())
+        ui->tableViewBT->selectionModel()->select(selection, QItemSelectionModel::Select);
+
+    if (bt_shownRows < bt_subtasks.size())
+    {
+        ui->sizeLabelBT->setText(tr("%1, listing %2 of %3 files ..")
+                                 .arg(bt_summary)
+                                 .arg(bt_shownRows)
+                                 .arg(bt_subtasks.size()));
+        return;
+    }
+
+    bt_populateTimer.stop();
+    ui->sizeLabelBT->setText(bt_summary);
+
+    updateBitorrentOkButton();
+}
+
+void AddCloudTask::previewTorrent(const QString &file)
+{
+    ui->tabWidget->setCurrentIndex(1);
+
+    TorrentFile torrent;
+    if (! torrent.load(file))
+    {
+        /// Not readable here, leave it to the server
+        bt_localPreview = false;
+        tcore->uploadBitorrent(file);
+        return;
+    }
+
+    const Thunder::Task *existing = tcore->findTorrentTask(torrent.infoHash());
+    if (existing)
+    {
+        clearBitorrentRows();
+        ui->sizeLabelBT->setText(tr("Already in the cloud: %1").arg(existing->name));
+        return;
+    }
+
+    showBitorrentTask(torrent.toBitorrentTask());
+
+    /// Committing needs the upload result
+    bt_localPreview = true;
+    updateBitorrentOkButton();
+
+    tcore->uploadBitorrent(file);
+}
+
 void AddCloudTask::on_url_textChanged(const QString &arg1)
 {
     if (arg1.startsWith("magnet:"))
@@ -206,10 +370,12 @@ void AddCloudTask::on_buttonBox_accepted()
                  ui->tableViewBT->selectionModel()->selectedIndexes())
             if (index.column() == 0)
             {
+                const Thunder::BTSubTask & subtask = bt_subtasks.at(index.row());
+
                 Thunder::BTSubTask task;
                 task.id     = QString::number(index.row());
-                task.findex = bt_model->data(index, Qt::UserRole + OFFSET_FINDEX).toString();
-                task.size   = bt_model->data(index, Qt::UserRole + OFFSET_SIZE).toString();
+                task.findex = subtask.findex;
+                task.size   = subtask.size;
 
                 tasks.append(task);
             }
@@ -239,8 +405,7 @@ void AddCloudTask::on_buttonBox_accepted()
 
 void AddCloudTask::loadDraggedInTorrent(const QUrl &url)
 {
-    ui->tabWidget->setCurrentIndex(1);
-    tcore->uploadBitorrent(url.toLocalFile());
+    previewTorrent(url.toLocalFile());
 }
 
 void AddCloudTask::on_uploadBTFile_clicked()
@@ -253,7 +418,7 @@ void AddCloudTask::on_uploadBTFile_clicked()
     if (file.isEmpty())
         return;
 
-    tcore->uploadBitorrent(file);
+    previewTorrent(file);
 }
 
 void AddCloudTask::on_openEditorBtn_clicked()
@@ -261,15 +426,49 @@ void AddCloudTask::on_openEditorBtn_clicked()
     SimpleEditor *editor = new SimpleEditor (this);
     editor->exec();
 
-    tcore->addBatchTaskPre(editor->getText());
+    checkBatchTasks(editor->getText());
 }
 
 void AddCloudTask::on_getClipboardBtn_clicked()
 {
-    tcore->addBatchTaskPre(QApplication::clipboard()->text());
+    checkBatchTasks(QApplication::clipboard()->text());
 }
 
 void AddCloudTask::on_magnet_textChanged(const QString &arg1)
 {
-    tcore->addMagnetTask(arg1);
+    const QStringList & uris = MagnetLink::find(arg1);
+
+    /// A pasted bunch is added as a whole, no file selection
+    if (uris.size() > 1)
+    {
+        tcore->addMagnetTasks(uris);
+
+        ui->magnet->clear();
+        clearBitorrentRows();
+        ui->sizeLabelBT->setText(tr("%1 magnet link(s) queued, all files are added.")
+                                 .arg(uris.size()));
+        return;
+    }
+
+    /// Also drops a query still pending for the text before
+    tcore->addMagnetTask(arg1.trimmed());
+
+    const MagnetLink magnet (arg1.trimmed());
+    if (magnet.isValid())
+    {
+        const Thunder::Task *existing = tcore->findTorrentTask(magnet.infoHash());
+        if (existing)
+        {
+            clearBitorrentRows();
+            ui->sizeLabelBT->setText(tr("Already in the cloud: %1").arg(existing->name));
+            return;
+        }
+
+        /// Shown until the server lists the files
+        ui->sizeLabelBT->setText(magnet.size() > 0
+                                 ? tr("%1 (Total: %2)")
+                                   .arg(magnet.name())
+                                   .arg(Util::toReadableSize(magnet.size()))
+                                 : magnet.name());
+    }
 }
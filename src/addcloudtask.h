@@ -27,6 +27,9 @@
 #include <QFileDialog>
 #include <QDragEnterEvent>
 #include <QDropEvent>
+#include <QPushButton>
+#include <QTimer>
+#include <QElapsedTimer>
 
 #include "thundercore.h"
 #include "simpleeditor.h"
@@ -76,6 +79,8 @@ private slots:
 
     void slotSelectAllRows ();
 
+    void slotPopulateBitorrentRows ();
+
 protected:
     void showEvent(QShowEvent *e);
 
@@ -88,6 +93,52 @@ private:
 
     QStandardItemModel *bt_model, *batch_model;
 
+    /*!
+     * \brief Size of batch rows so far, chunks arrive one by one
+     */
+    unsigned long long batch_totalSize;
+
+    /*!
+     * \brief Clear the batch table and check a new list of URLs
+     * \param urls
+     */
+    void checkBatchTasks (const QString & urls);
+
+    /*!
+     * \brief List the files of a torrent right away, then upload it
+     *        unless it is in the cloud already
+     * \param file
+     */
+    void previewTorrent (const QString & file);
+    void showBitorrentTask (const Thunder::BitorrentTask & bttask);
+    void clearBitorrentRows ();
+
+    /*!
+     * \brief Take the server listing for the rows of the local preview,
+     *        matched by file index or name
+     * \param bttask
+     * \return false if a file could not be matched, rows are untouched then
+     */
+    bool mergeBitorrentTask (const Thunder::BitorrentTask & bttask);
+
+    /*!
+     * \brief Files of the torrent, rows are added a slice per event loop pass
+     */
+    QList<Thunder::BTSubTask> bt_subtasks;
+    int bt_shownRows;
+    QString bt_summary;
+    QTimer bt_populateTimer;
+
+    /*!
+     * \brief Committing waits for the upload result and for all rows
+     */
+    void updateBitorrentOkButton ();
+
+    /*!
+     * \brief Rows are a local preview, the upload result is merged in
+     */
+    bool bt_localPreview;
+
     QRegExp row_filter;
 
 signals:
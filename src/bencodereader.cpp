@@ -0,0 +1,200 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bencodereader.h"
+
+#include <cstring>
+
+#define MAX_DEPTH 64
+
+bool BencodeReader::Slice::operator== (const char *literal) const
+{
+    return (int) strlen (literal) == size && memcmp (data, literal, size) == 0;
+}
+
+BencodeReader::BencodeReader(const char *begin, const char *end) :
+    my_pos (begin),
+    my_end (end),
+    my_error (begin > end),
+    my_depth (0)
+{
+}
+
+bool BencodeReader::expect(char c)
+{
+    if (my_error || my_pos >= my_end || *my_pos != c)
+    {
+        my_error = true;
+        return false;
+    }
+
+    ++ my_pos;
+    return true;
+}
+
+bool BencodeReader::beginDict()
+{
+    return expect ('d');
+}
+
+bool BencodeReader::beginList()
+{
+    return expect ('l');
+}
+
+bool BencodeReader::nextElement()
+{
+    if (my_error || my_pos >= my_end)
+    {
+        my_error = true;
+        return false;
+    }
+
+    if (*my_pos == 'e')
+    {
+        ++ my_pos;
+        return false;
+    }
+
+    return true;
+}
+
+bool BencodeReader::nextKey(BencodeReader::Slice &key)
+{
+    if (! nextElement())
+        return false;
+
+    return scanString(key);
+}
+
+bool BencodeReader::scanString(BencodeReader::Slice &value)
+{
+    qlonglong length = 0;
+    const char *p = my_pos;
+
+    while (! my_error && p < my_end && *p >= '0' && *p <= '9' && length <= my_end - my_pos)
+        length = length * 10 + (*p++ - '0');
+
+    if (my_error || p == my_pos || p >= my_end || *p != ':' || length > my_end - p - 1)
+    {
+        my_error = true;
+        return false;
+    }
+
+    value.data = p + 1;
+    value.size = (int) length;
+    my_pos = value.data + value.size;
+
+    return true;
+}
+
+bool BencodeReader::scanInteger(qlonglong &value)
+{
+    if (! expect ('i'))
+        return false;
+
+    bool negative = false;
+    if (my_pos < my_end && *my_pos == '-')
+    {
+        negative = true;
+        ++ my_pos;
+    }
+
+    const char *start = my_pos;
+    value = 0;
+
+    while (my_pos < my_end && *my_pos >= '0' && *my_pos <= '9')
+        value = value * 10 + (*my_pos++ - '0');
+
+    if (my_pos == start || ! expect ('e'))
+    {
+        my_error = true;
+        return false;
+    }
+
+    if (negative)
+        value = -value;
+
+    return true;
+}
+
+BencodeReader::Slice BencodeReader::readString()
+{
+    Slice value;
+    scanString(value);
+
+    return value;
+}
+
+qlonglong BencodeReader::readInteger()
+{
+    qlonglong value = 0;
+    scanInteger(value);
+
+    return value;
+}
+
+BencodeReader::Slice BencodeReader::raw()
+{
+    Slice value;
+    value.data = my_pos;
+
+    if (my_error || my_pos >= my_end)
+    {
+        my_error = true;
+        return value;
+    }
+
+    switch (*my_pos)
+    {
+    case 'i':
+    {
+        qlonglong dummy;
+        scanInteger(dummy);
+    }
+        break;
+    case 'l':
+    case 'd':
+    {
+        if (++ my_depth > MAX_DEPTH)
+        {
+            my_error = true;
+            break;
+        }
+
+        /// Keys of a dictionary are strings, no need to tell them apart
+        ++ my_pos;
+        while (nextElement())
+        {
+            skipValue();
+        }
+
+        -- my_depth;
+    }
+        break;
+    default:
+    {
+        Slice dummy;
+        scanString(dummy);
+    }
+        break;
+    }
+
+    value.size = my_error ? 0 : (int) (my_pos - value.data);
+    return value;
+}
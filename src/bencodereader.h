@@ -0,0 +1,107 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCODEREADER_H
+#define BENCODEREADER_H
+
+#include <QString>
+#include <QByteArray>
+
+/*!
+ * \brief Pull style bencode reader working on a borrowed buffer,
+ *        the counterpart of JsonReader for .torrent files.
+ *
+ *        Nothing is copied until a value is decoded, raw() gives the exact
+ *        bytes of a value, i.e for hashing the info dictionary:
+ *
+ *        reader.beginDict();
+ *        while (reader.nextKey(key))
+ *            if (key == "info") info = reader.raw();
+ *            else reader.skipValue();
+ */
+class BencodeReader
+{
+public:
+    /*!
+     * \brief Raw bytes inside the buffer
+     */
+    struct Slice
+    {
+        Slice () : data (0), size (0) {}
+
+        const char *data;
+        int size;
+
+        bool operator== (const char *literal) const;
+        bool operator!= (const char *literal) const { return ! (*this == literal); }
+
+        /*!
+         * \brief Bytes shared with the buffer, valid as long as the buffer is
+         */
+        QByteArray toRawData () const { return QByteArray::fromRawData(data, size); }
+        QString toString () const { return QString::fromUtf8(data, size); }
+    };
+
+    BencodeReader (const char *begin, const char *end);
+
+    bool hasError () const { return my_error; }
+
+    /*!
+     * \brief Enter a dictionary, use nextKey() to iterate
+     * \return false if the next value is not a dictionary
+     */
+    bool beginDict ();
+
+    /*!
+     * \brief Read the next key, the value must be consumed afterwards
+     * \param key
+     * \return false at the end of current dictionary
+     */
+    bool nextKey (Slice & key);
+
+    bool beginList ();
+
+    /*!
+     * \brief Move to the next element, which must be consumed afterwards
+     * \return false at the end of current list
+     */
+    bool nextElement ();
+
+    Slice readString ();
+    qlonglong readInteger ();
+
+    /*!
+     * \brief Skip the next value and return its encoded bytes
+     * \return
+     */
+    Slice raw ();
+    bool skipValue () { raw (); return ! my_error; }
+
+private:
+    const char *my_pos, *my_end;
+    bool my_error;
+
+    // nesting limit, a hostile file must not exhaust the stack
+    int my_depth;
+
+    bool expect (char c);
+    bool scanString (Slice & value);
+    bool scanInteger (qlonglong & value);
+};
+
+#endif // BENCODEREADER_H
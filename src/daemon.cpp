@@ -0,0 +1,752 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "daemon.h"
+#include "qjson/serializer.h"
+
+#include <QFile>
+#include <QDir>
+
+// JSON-RPC 2.0 error codes
+#define RPC_PARSE_ERROR      -32700
+#define RPC_INVALID_REQUEST  -32600
+#define RPC_METHOD_NOT_FOUND -32601
+#define RPC_INVALID_PARAMS   -32602
+
+// concurrent downloads unless Daemon/MaxDownloads says otherwise
+#define MAX_DOWNLOADS 2
+
+/*!
+ * Methods callable over the socket, positional parameters only
+ */
+const Daemon::MethodEntry Daemon::my_methods[] =
+{
+    { "cloud.login",          &Daemon::cloudLogin },
+    { "cloud.sendCaptcha",    &Daemon::cloudSendCaptcha },
+    { "cloud.getStatus",      &Daemon::cloudGetStatus },
+    { "cloud.refresh",        &Daemon::cloudRefresh },
+    { "cloud.listTasks",      &Daemon::cloudListTasks },
+    { "cloud.getLinks",       &Daemon::cloudGetLinks },
+    { "cloud.addUris",        &Daemon::cloudAddUris },
+    { "cloud.remove",         &Daemon::cloudRemove },
+    { "download.add",         &Daemon::downloadAdd },
+    { "download.list",        &Daemon::downloadList },
+    { "download.pause",       &Daemon::downloadPause },
+    { "download.resume",      &Daemon::downloadResume },
+    { "download.remove",      &Daemon::downloadRemove },
+    { "system.multicall",     &Daemon::systemMulticall },
+    { "system.listMethods",   &Daemon::systemListMethods },
+    { 0, 0 }
+};
+
+Daemon::Daemon(QObject *parent) :
+    QObject(parent),
+    my_core (new ThunderCore (this)),
+    my_server (new QLocalServer (this)),
+    my_nextGid (1)
+{
+    QSettings settings;
+    settings.beginGroup("Daemon");
+    my_maxDownloads = qMax (1, settings.value("MaxDownloads", MAX_DOWNLOADS).toInt());
+
+    connect (my_server, SIGNAL(newConnection()), SLOT(slotNewConnection()));
+
+    connect (my_core, SIGNAL(StatusChanged(ThunderCore::ChangeType)),
+             SLOT(slotStatusChanged(ThunderCore::ChangeType)));
+    connect (my_core, SIGNAL(error(QString,ThunderCore::ErrorCategory)),
+             SLOT(slotError(QString,ThunderCore::ErrorCategory)));
+    connect (my_core, SIGNAL(CloudTaskUpdated(Thunder::Task)),
+             SLOT(slotCloudTaskUpdated(Thunder::Task)));
+    connect (my_core, SIGNAL(CloudTaskFinished(Thunder::Task)),
+             SLOT(slotCloudTaskFinished(Thunder::Task)));
+}
+
+bool Daemon::listen(const QString &name)
+{
+    /// Left behind by a crashed daemon
+    QLocalServer::removeServer(name);
+    return my_server->listen(name);
+}
+
+QString Daemon::errorString() const
+{
+    return my_server->errorString();
+}
+
+void Daemon::login()
+{
+    QSettings settings;
+    settings.beginGroup("General");
+
+    const QString & user = settings.value("User").toString();
+    const QString & credential = settings.value("Credential").toString();
+
+    if (user.isEmpty() || credential.isEmpty())
+    {
+        qWarning() << "No stored account, waiting for cloud.login";
+        return;
+    }
+
+    my_core->loadCachedTasks(user);
+    my_core->login(user, credential);
+}
+
+/////// Connections
+
+void Daemon::slotNewConnection()
+{
+    while (QLocalSocket *socket = my_server->nextPendingConnection())
+    {
+        my_buffers.insert(socket, QByteArray ());
+
+        connect (socket, SIGNAL(readyRead()), SLOT(slotReadyRead()));
+        connect (socket, SIGNAL(disconnected()), SLOT(slotDisconnected()));
+    }
+}
+
+void Daemon::slotDisconnected()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket*> (sender());
+
+    my_buffers.remove(socket);
+    socket->deleteLater();
+}
+
+void Daemon::slotReadyRead()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket*> (sender());
+
+    QByteArray & buffer = my_buffers[socket];
+    buffer.append(socket->readAll());
+
+    int end;
+    while ((end = buffer.indexOf('\n')) >= 0)
+    {
+        const QByteArray & line = buffer.left(end).trimmed();
+        buffer.remove(0, end + 1);
+
+        if (line.isEmpty())
+            continue;
+
+        QJson::Parser parser;
+        bool ok = false;
+
+        const QVariant & message = parser.parse(line, &ok);
+        if (! ok)
+        {
+            QVariantMap response;
+            response.insert("jsonrpc", "2.0");
+            response.insert("id", QVariant ());
+            response.insert("error", makeError(RPC_PARSE_ERROR, parser.errorString()));
+
+            send (socket, response);
+            continue;
+        }
+
+        const QVariant & response = handleMessage(message);
+
+        /// Nothing to say for notifications
+        if (response.isValid())
+            send (socket, response);
+    }
+}
+
+void Daemon::send(QLocalSocket *socket, const QVariant &message)
+{
+    QJson::Serializer serializer;
+    socket->write(serializer.serialize(message) + "\n");
+}
+
+void Daemon::notify(const QString &method, const QVariantMap &params)
+{
+    QVariantMap message;
+    message.insert("jsonrpc", "2.0");
+    message.insert("method", method);
+    message.insert("params", QVariantList () << params);
+
+    foreach (QLocalSocket *socket, my_buffers.keys())
+    {
+        send (socket, message);
+    }
+}
+
+/////// JSON-RPC
+
+QVariant Daemon::handleMessage(const QVariant &message)
+{
+    if (message.type() != QVariant::List)
+        return handleRequest(message);
+
+    const QVariantList & batch = message.toList();
+    if (batch.isEmpty())
+    {
+        QVariantMap response;
+        response.insert("jsonrpc", "2.0");
+        response.insert("id", QVariant ());
+        response.insert("error", makeError(RPC_INVALID_REQUEST, "Empty batch"));
+
+        return response;
+    }
+
+    QVariantList responses;
+    foreach (const QVariant & request, batch)
+    {
+        const QVariant & response = handleRequest(request);
+        if (response.isValid())
+            responses.append(response);
+    }
+
+    /// A batch of notifications only
+    if (responses.isEmpty())
+        return QVariant ();
+
+    return responses;
+}
+
+QVariant Daemon::handleRequest(const QVariant &request)
+{
+    const QVariantMap & map = request.toMap();
+
+    QVariantMap response;
+    response.insert("jsonrpc", "2.0");
+    response.insert("id", map.value("id"));
+
+    if (map.value("method").type() != QVariant::String)
+    {
+        response.insert("error", makeError(RPC_INVALID_REQUEST, "Invalid request"));
+        return response;
+    }
+
+    QVariantMap error;
+    const QVariant & result = call (map.value("method").toString(),
+                                    map.value("params").toList(),
+                                    error);
+
+    if (! map.contains("id"))
+        return QVariant ();
+
+    if (! error.isEmpty())
+        response.insert("error", error);
+    else
+        response.insert("result", result);
+
+    return response;
+}
+
+QVariant Daemon::call(const QString &method, const QVariantList &params, QVariantMap &error)
+{
+    for (int i = 0; my_methods[i].name; ++i)
+    {
+        if (method == QLatin1String (my_methods[i].name))
+            return (this->*my_methods[i].method) (params, error);
+    }
+
+    error = makeError(RPC_METHOD_NOT_FOUND, "Method not found: " + method);
+    return QVariant ();
+}
+
+QVariantMap Daemon::makeError(int code, const QString &message)
+{
+    QVariantMap error;
+    error.insert("code", code);
+    error.insert("message", message);
+
+    return error;
+}
+
+QVariantMap Daemon::taskToVariant(const Thunder::Task &task)
+{
+    QVariantMap map;
+    map.insert("id", task.taskid());
+    map.insert("name", task.name);
+    map.insert("size", (qulonglong) task.size);
+    map.insert("status", task.finished() ? "complete" : "active");
+    map.insert("progress", (int) task.progress);
+    map.insert("bt", task.type == Thunder::BT);
+    map.insert("cid", QString::fromAscii(task.cid));
+    map.insert("source", QString::fromUtf8(task.source));
+    map.insert("link", QString::fromUtf8(task.link));
+    map.insert("expires", (uint) task.expires);
+
+    return map;
+}
+
+QVariantMap Daemon::downloadToVariant(const Daemon::Download &download)
+{
+    static const char *statusNames[] = { "waiting", "active", "paused", "complete", "error" };
+
+    QVariantMap map;
+    map.insert("gid", download.gid);
+    map.insert("name", download.name);
+    map.insert("url", download.url);
+    map.insert("status", statusNames[download.status]);
+
+    if (download.downloader)
+    {
+        const Downloader::TaskInfoX & info = download.downloader->currentTaskInfo;
+
+        map.insert("totalLength", (qulonglong) download.downloader->getFileSize());
+        map.insert("completedLength", (qulonglong) info.transfered);
+        map.insert("downloadSpeed", info.speed);
+        map.insert("path", download.downloader->getSaveFilePath());
+    }
+
+    return map;
+}
+
+/////// Downloads
+
+int Daemon::addDownload(const QString &url, const QString &name)
+{
+    Download download;
+    download.gid  = my_nextGid ++;
+    download.url  = url;
+
+    /// Names come from the socket or the server, keep them inside the
+    /// storage location
+    download.name = QString (name).replace('/', '_').replace('\\', '_');
+    if (download.name.isEmpty() || download.name == "." || download.name == "..")
+        download.name = QString ("download-%1").arg(download.gid);
+
+    my_downloads.insert(download.gid, download);
+    startDownloads();
+
+    return download.gid;
+}
+
+void Daemon::startDownloads()
+{
+    int active = 0;
+    foreach (const Download & download, my_downloads)
+    {
+        if (download.status == Download::Active)
+            ++ active;
+    }
+
+    QSettings settings;
+    settings.beginGroup("Transf0r");
+
+    /// Same default as the preferences dialog
+    QString storage = settings.value("StorageLocation").toString();
+    if (storage.isEmpty())
+        storage = Util::getHomeLocation();
+
+    QMap<int, Download>::iterator it;
+    for (it = my_downloads.begin(); it != my_downloads.end() && active < my_maxDownloads; ++it)
+    {
+        Download & download = it.value();
+        if (download.status != Download::Waiting)
+            continue;
+
+        /// Same cookies as DownloaderChildWidget, gdriveid is required
+        QNetworkCookieJar *cj = new QNetworkCookieJar;
+        cj->setCookiesFromUrl(Util::parseMozillaCookieFile(my_core->getCookieFilePath()),
+                              QUrl (download.url));
+
+        if (! download.downloader)
+        {
+            download.downloader = new Downloader (this);
+            download.downloader->setProperty("gid", download.gid);
+
+            connect (download.downloader, SIGNAL(taskStatusChanged(Downloader::TaskStatusX)),
+                     SLOT(slotDownloadStatusChanged(Downloader::TaskStatusX)));
+        }
+
+        download.downloader->setCookieJar(cj);
+        download.downloader->startDownload(download.url,
+                                           storage + QDir::separator() + download.name);
+
+        download.status = Download::Active;
+        ++ active;
+    }
+}
+
+void Daemon::slotDownloadStatusChanged(Downloader::TaskStatusX status)
+{
+    const int gid = sender()->property("gid").toInt();
+    if (! my_downloads.contains(gid))
+        return;
+
+    Download & download = my_downloads[gid];
+    QString event;
+
+    switch (status)
+    {
+    case Downloader::Running:
+        download.status = Download::Active;
+        event = "download.onStart";
+        break;
+    case Downloader::Paused:
+        download.status = Download::Paused;
+        event = "download.onPause";
+        break;
+    case Downloader::Finished:
+        download.status = Download::Complete;
+        event = "download.onComplete";
+        break;
+    case Downloader::Failed:
+        download.status = Download::Error;
+        event = "download.onError";
+        break;
+    }
+
+    notify (event, downloadToVariant(download));
+
+    if (download.status != Download::Active)
+        startDownloads();
+}
+
+Daemon::Download *Daemon::findDownload(const QVariantList &params, QVariantMap &error)
+{
+    const int gid = params.value(0).toInt();
+    if (! my_downloads.contains(gid))
+    {
+        error = makeError(RPC_INVALID_PARAMS, "No such download");
+        return 0;
+    }
+
+    return &my_downloads[gid];
+}
+
+/////// ThunderCore events
+
+void Daemon::slotStatusChanged(ThunderCore::ChangeType type)
+{
+    QVariantMap params;
+
+    switch (type)
+    {
+    case ThunderCore::TaskChanged:
+        params.insert("count", my_core->getTaskStore()->size());
+        notify ("cloud.onTaskListChanged", params);
+        break;
+    case ThunderCore::LoginChanged:
+        params.insert("loggedIn", my_core->getLoginStatus() == ThunderCore::NoError);
+        notify ("cloud.onLoginChanged", params);
+        break;
+    case ThunderCore::CapchaReady:
+        /// Answered by cloud.sendCaptcha
+        params.insert("image", QString::fromAscii(my_core->getCapchaCode().toBase64()));
+        notify ("cloud.onCaptchaRequired", params);
+        break;
+    }
+}
+
+void Daemon::slotError(const QString &body, ThunderCore::ErrorCategory category)
+{
+    if (category < ThunderCore::Warning)
+    {
+        qDebug() << body;
+        return;
+    }
+
+    qWarning() << body;
+
+    QVariantMap params;
+    params.insert("message", body);
+    params.insert("critical", category == ThunderCore::Critical);
+    notify ("cloud.onError", params);
+}
+
+void Daemon::slotCloudTaskUpdated(const Thunder::Task &task)
+{
+    notify ("cloud.onTaskUpdated", taskToVariant(task));
+}
+
+void Daemon::slotCloudTaskFinished(const Thunder::Task &task)
+{
+    notify ("cloud.onTaskFinished", taskToVariant(task));
+
+    QSettings settings;
+    settings.beginGroup("Transf0r");
+
+    /// Same rule as the GUI, BT folders are downloaded file by file
+    if (settings.value("AutoDownloadFinished", false).toBool() &&
+            task.type != Thunder::BT && ! task.link.isEmpty())
+        addDownload(QString::fromUtf8(task.link), task.name);
+}
+
+/////// Methods
+
+QVariant Daemon::cloudLogin(const QVariantList &params, QVariantMap &error)
+{
+    if (params.isEmpty())
+    {
+        login ();
+        return "OK";
+    }
+
+    if (params.size() < 2)
+    {
+        error = makeError(RPC_INVALID_PARAMS, "Expected [user, password]");
+        return QVariant ();
+    }
+
+    /// Stored the same way as the preferences dialog does, login expects
+    /// the MD5 of the password
+    my_core->loadCachedTasks(params.at(0).toString());
+    my_core->login(params.at(0).toString(), Util::getMD5Hex(params.at(1).toString()));
+
+    return "OK";
+}
+
+QVariant Daemon::cloudSendCaptcha(const QVariantList &params, QVariantMap &error)
+{
+    if (params.isEmpty())
+    {
+        error = makeError(RPC_INVALID_PARAMS, "Expected [code]");
+        return QVariant ();
+    }
+
+    my_core->loginWithCapcha(params.at(0).toString().toAscii());
+    return "OK";
+}
+
+QVariant Daemon::cloudGetStatus(const QVariantList &params, QVariantMap &error)
+{
+    Q_UNUSED(params);
+    Q_UNUSED(error);
+
+    static const char *loginNames[] = { "ok", "captcha", "failed" };
+
+    int active = 0;
+    foreach (const Download & download, my_downloads)
+    {
+        if (download.status == Download::Active)
+            ++ active;
+    }
+
+    QVariantMap status;
+    status.insert("login", loginNames[my_core->getLoginStatus()]);
+    status.insert("tasks", my_core->getTaskStore()->size());
+    status.insert("downloads", my_downloads.size());
+    status.insert("activeDownloads", active);
+
+    return status;
+}
+
+QVariant Daemon::cloudRefresh(const QVariantList &params, QVariantMap &error)
+{
+    Q_UNUSED(params);
+    Q_UNUSED(error);
+
+    my_core->reloadCloudTasks();
+    return "OK";
+}
+
+QVariant Daemon::cloudListTasks(const QVariantList &params, QVariantMap &error)
+{
+    Q_UNUSED(error);
+
+    const TaskStore *store = my_core->getTaskStore();
+    const int offset = qMax (0, params.value(0).toInt());
+    const int count  = params.size() > 1 ? params.at(1).toInt() : store->size();
+
+    QVariantList tasks;
+    for (int i = offset; i < qMin (store->size(), offset + count); ++i)
+    {
+        tasks.append(taskToVariant(store->at(i)));
+    }
+
+    return tasks;
+}
+
+QVariant Daemon::cloudGetLinks(const QVariantList &params, QVariantMap &error)
+{
+    Q_UNUSED(error);
+
+    QVariantList links;
+    foreach (const QVariant & id, params)
+    {
+        const Thunder::Task *task = my_core->getTaskStore()->findById(id.toULongLong());
+        if (! task)
+            continue;
+
+        QVariantMap link;
+        link.insert("id", task->taskid());
+        link.insert("name", task->name);
+        link.insert("link", QString::fromUtf8(task->link));
+
+        links.append(link);
+    }
+
+    return links;
+}
+
+QVariant Daemon::cloudAddUris(const QVariantList &params, QVariantMap &error)
+{
+    QStringList urls;
+    foreach (const QVariant & url, params)
+    {
+        if (! url.toString().isEmpty())
+            urls.append(url.toString());
+    }
+
+    if (urls.isEmpty())
+    {
+        error = makeError(RPC_INVALID_PARAMS, "Expected [url, ...]");
+        return QVariant ();
+    }
+
+    /// Committed as a batch, the task list is reloaded afterwards
+    my_core->addBatchTaskPost(urls);
+    return "OK";
+}
+
+QVariant Daemon::cloudRemove(const QVariantList &params, QVariantMap &error)
+{
+    QStringList ids;
+    foreach (const QVariant & id, params)
+    {
+        ids.append(id.toString());
+    }
+
+    if (ids.isEmpty())
+    {
+        error = makeError(RPC_INVALID_PARAMS, "Expected [id, ...]");
+        return QVariant ();
+    }
+
+    my_core->removeCloudTasks(ids);
+    return "OK";
+}
+
+QVariant Daemon::downloadAdd(const QVariantList &params, QVariantMap &error)
+{
+    /// [url, name] of any link, or [id] of a finished cloud task
+    if (params.size() > 1)
+        return addDownload(params.at(0).toString(), params.at(1).toString());
+
+    const Thunder::Task *task = my_core->getTaskStore()->findById(params.value(0).toULongLong());
+    if (! task)
+    {
+        error = makeError(RPC_INVALID_PARAMS, "No such task");
+        return QVariant ();
+    }
+
+    if (task->type == Thunder::BT || task->link.isEmpty())
+    {
+        error = makeError(RPC_INVALID_PARAMS, "Task has no download link");
+        return QVariant ();
+    }
+
+    return addDownload(QString::fromUtf8(task->link), task->name);
+}
+
+QVariant Daemon::downloadList(const QVariantList &params, QVariantMap &error)
+{
+    Q_UNUSED(params);
+    Q_UNUSED(error);
+
+    QVariantList downloads;
+    foreach (const Download & download, my_downloads)
+    {
+        downloads.append(downloadToVariant(download));
+    }
+
+    return downloads;
+}
+
+QVariant Daemon::downloadPause(const QVariantList &params, QVariantMap &error)
+{
+    Download *download = findDownload(params, error);
+    if (! download)
+        return QVariant ();
+
+    if (download->status == Download::Waiting)
+        download->status = Download::Paused;
+    else if (download->status == Download::Active)
+        download->downloader->stop();
+
+    return download->gid;
+}
+
+QVariant Daemon::downloadResume(const QVariantList &params, QVariantMap &error)
+{
+    Download *download = findDownload(params, error);
+    if (! download)
+        return QVariant ();
+
+    if (download->status == Download::Paused || download->status == Download::Error)
+    {
+        download->status = Download::Waiting;
+        startDownloads();
+    }
+
+    return download->gid;
+}
+
+QVariant Daemon::downloadRemove(const QVariantList &params, QVariantMap &error)
+{
+    Download *download = findDownload(params, error);
+    if (! download)
+        return QVariant ();
+
+    const int gid = download->gid;
+
+    /// Partial files are kept, same as aria2
+    if (download->downloader)
+    {
+        download->downloader->disconnect(this);
+        download->downloader->stop();
+        download->downloader->deleteLater();
+    }
+
+    my_downloads.remove(gid);
+    startDownloads();
+
+    return gid;
+}
+
+QVariant Daemon::systemMulticall(const QVariantList &params, QVariantMap &error)
+{
+    Q_UNUSED(error);
+
+    /// [[{methodName, params}, ...]], results are wrapped in lists like aria2
+    QVariantList results;
+    foreach (const QVariant & item, params.value(0).toList())
+    {
+        const QVariantMap & map = item.toMap();
+
+        QVariantMap callError;
+        const QVariant & result = call (map.value("methodName").toString(),
+                                        map.value("params").toList(),
+                                        callError);
+
+        if (callError.isEmpty())
+            results.append(QVariant (QVariantList () << result));
+        else
+            results.append(callError);
+    }
+
+    return results;
+}
+
+QVariant Daemon::systemListMethods(const QVariantList &params, QVariantMap &error)
+{
+    Q_UNUSED(params);
+    Q_UNUSED(error);
+
+    QVariantList methods;
+    for (int i = 0; my_methods[i].name; ++i)
+    {
+        methods.append(QString::fromAscii(my_methods[i].name));
+    }
+
+    return methods;
+}
@@ -0,0 +1,145 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <QObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QVariant>
+#include <QHash>
+#include <QMap>
+
+#include "thundercore.h"
+#include "downloader.h"
+
+/*!
+ * \brief Headless mode, ThunderCore and downloads driven over a local socket
+ *
+ *        Clients send JSON-RPC 2.0 requests, one per line, similar to the
+ *        RPC interface of aria2. Batches are accepted as JSON arrays and
+ *        through system.multicall. Task and download events are pushed to
+ *        every client as notifications.
+ */
+class Daemon : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Daemon(QObject *parent = 0);
+
+    /*!
+     * \brief Listen on a socket name or path, a stale socket is replaced
+     * \param name
+     * \return
+     */
+    bool listen (const QString & name);
+    QString errorString () const;
+
+    /*!
+     * \brief Login with the account stored by the GUI
+     */
+    void login ();
+
+private:
+    struct Download
+    {
+        enum Status
+        {
+            Waiting,
+            Active,
+            Paused,
+            Complete,
+            Error
+        };
+
+        Download () : gid (0), status (Waiting), downloader (0) {}
+
+        int gid;
+        Status status;
+        QString url, name;
+        Downloader *downloader;
+    };
+
+    ThunderCore *my_core;
+    QLocalServer *my_server;
+
+    /*!
+     * \brief Unfinished input line of each client
+     */
+    QHash<QLocalSocket*, QByteArray> my_buffers;
+
+    QMap<int, Download> my_downloads;
+    int my_nextGid;
+    int my_maxDownloads;
+
+    typedef QVariant (Daemon::*Method) (const QVariantList & params, QVariantMap & error);
+    struct MethodEntry
+    {
+        const char *name;
+        Method method;
+    };
+    static const MethodEntry my_methods[];
+
+    QVariant handleMessage (const QVariant & message);
+    QVariant handleRequest (const QVariant & request);
+    QVariant call (const QString & method, const QVariantList & params, QVariantMap & error);
+
+    void notify (const QString & method, const QVariantMap & params);
+    void send (QLocalSocket *socket, const QVariant & message);
+
+    static QVariantMap taskToVariant (const Thunder::Task & task);
+    QVariantMap downloadToVariant (const Download & download);
+    static QVariantMap makeError (int code, const QString & message);
+
+    /*!
+     * \brief Start waiting downloads while below the concurrency limit
+     */
+    void startDownloads ();
+    int addDownload (const QString & url, const QString & name);
+    Download *findDownload (const QVariantList & params, QVariantMap & error);
+
+    QVariant cloudLogin (const QVariantList & params, QVariantMap & error);
+    QVariant cloudSendCaptcha (const QVariantList & params, QVariantMap & error);
+    QVariant cloudGetStatus (const QVariantList & params, QVariantMap & error);
+    QVariant cloudRefresh (const QVariantList & params, QVariantMap & error);
+    QVariant cloudListTasks (const QVariantList & params, QVariantMap & error);
+    QVariant cloudGetLinks (const QVariantList & params, QVariantMap & error);
+    QVariant cloudAddUris (const QVariantList & params, QVariantMap & error);
+    QVariant cloudRemove (const QVariantList & params, QVariantMap & error);
+    QVariant downloadAdd (const QVariantList & params, QVariantMap & error);
+    QVariant downloadList (const QVariantList & params, QVariantMap & error);
+    QVariant downloadPause (const QVariantList & params, QVariantMap & error);
+    QVariant downloadResume (const QVariantList & params, QVariantMap & error);
+    QVariant downloadRemove (const QVariantList & params, QVariantMap & error);
+    QVariant systemMulticall (const QVariantList & params, QVariantMap & error);
+    QVariant systemListMethods (const QVariantList & params, QVariantMap & error);
+
+private slots:
+    void slotNewConnection ();
+    void slotReadyRead ();
+    void slotDisconnected ();
+
+    void slotStatusChanged (ThunderCore::ChangeType type);
+    void slotError (const QString & body, ThunderCore::ErrorCategory category);
+    void slotCloudTaskUpdated (const Thunder::Task & task);
+    void slotCloudTaskFinished (const Thunder::Task & task);
+    void slotDownloadStatusChanged (Downloader::TaskStatusX status);
+};
+
+#endif // DAEMON_H
@@ -51,7 +51,7 @@ DownloaderChildWidget::DownloaderChildWidget(QListWidgetItem *item,
              this , SLOT(taskStatusChanged(Downloader::TaskStatusX)));
     ///
     ui->label->setText(fileName);
-    ui->fileIcon->setPixmap(Util::getFileAttr(m_fileName).icon.pixmap(24));
+    ui->fileIcon->setPixmap(Util::getFileIcon(m_fileName).pixmap(24));
 
     QList<QNetworkCookie> cookies = Util::parseMozillaCookieFile(
                 QDesktopServices::storageLocation(QDesktopServices::HomeLocation)
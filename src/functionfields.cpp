@@ -0,0 +1,214 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "functionfields.h"
+
+#include <cstring>
+
+FunctionFields::FunctionFields(const QByteArray &data) :
+    my_data (data),
+    my_error (false)
+{
+    tokenize ();
+}
+
+void FunctionFields::tokenize()
+{
+    const char *p   = my_data.constData();
+    const char *end = p + my_data.size();
+
+    p = (const char*) memchr (p, '(', end - p);
+    if (! p)
+    {
+        my_error = true;
+        my_argumentStarts.append(0);
+        return;
+    }
+
+    /// A big url_query reply has ~6 fields per 40 bytes
+    my_fields.reserve(my_data.size() / 8);
+    my_argumentStarts.append(0);
+
+    int depth = 0;
+    int argument = 0;
+
+    while (p < end)
+    {
+        const char c = *p;
+
+        if (c == '\'' || c == '"')
+        {
+            Field field;
+            field.data     = ++ p;
+            field.argument = argument;
+            field.quoted   = true;
+            field.escaped  = false;
+
+            while (p < end && *p != c)
+            {
+                if (*p == '\\')
+                {
+                    field.escaped = true;
+                    ++ p;
+                }
+
+                ++ p;
+            }
+
+            if (p >= end)
+            {
+                my_error = true;
+                break;
+            }
+
+            field.size = p - field.data;
+            my_fields.append(field);
+
+            ++ p;
+        }
+        else if (c == '(' || c == '[')
+        {
+            ++ depth;
+            ++ p;
+        }
+        else if (c == ')' || c == ']')
+        {
+            ++ p;
+            if (-- depth == 0)
+                break;
+        }
+        else if (c == ',')
+        {
+            if (depth == 1)
+            {
+                ++ argument;
+                my_argumentStarts.append(my_fields.size());
+            }
+
+            ++ p;
+        }
+        else if ((c >= '0' && c <= '9') || c == '-' || c == '.')
+        {
+            Field field;
+            field.data     = p;
+            field.argument = argument;
+            field.quoted   = false;
+            field.escaped  = false;
+
+            while (p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' ||
+                               *p == '.' || *p == 'e' || *p == 'E'))
+                ++ p;
+
+            field.size = p - field.data;
+            my_fields.append(field);
+        }
+        else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$')
+        {
+            /// new Array, true, null ..
+            while (p < end && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+                               (*p >= '0' && *p <= '9') || *p == '_' || *p == '$'))
+                ++ p;
+        }
+        else
+            ++ p;
+    }
+
+    if (depth != 0)
+        my_error = true;
+
+    my_argumentStarts.append(my_fields.size());
+}
+
+QString FunctionFields::at(int i) const
+{
+    const Field & field = my_fields.at(i);
+    if (! field.escaped)
+        return QString::fromUtf8(field.data, field.size);
+
+    return decode (field);
+}
+
+qulonglong FunctionFields::toULongLong(int i) const
+{
+    const Field & field = my_fields.at(i);
+
+    qulonglong value = 0;
+    for (int j = 0; j < field.size && field.data[j] >= '0' && field.data[j] <= '9'; ++j)
+        value = value * 10 + (field.data[j] - '0');
+
+    return value;
+}
+
+QString FunctionFields::decode(const FunctionFields::Field &field)
+{
+    QString result;
+    QByteArray run;
+
+    const char *p   = field.data;
+    const char *end = field.data + field.size;
+
+    while (p < end)
+    {
+        if (*p != '\\' || p + 1 >= end)
+        {
+            run.append(*p++);
+            continue;
+        }
+
+        const char c = p[1];
+        p += 2;
+
+        switch (c)
+        {
+        case 'n': run.append('\n'); break;
+        case 't': run.append('\t'); break;
+        case 'r': run.append('\r'); break;
+        case 'b': run.append('\b'); break;
+        case 'f': run.append('\f'); break;
+        case 'u':
+        case 'x':
+        {
+            const int digits = c == 'u' ? 4 : 2;
+            bool ok = false;
+            const ushort code = end - p >= digits
+                    ? QByteArray (p, digits).toUShort(&ok, 16)
+                    : 0;
+
+            if (! ok)
+            {
+                run.append(c);
+                break;
+            }
+
+            /// Code units are not UTF-8, flush what came before
+            result.append(QString::fromUtf8(run));
+            result.append(QChar (code));
+            run.clear();
+
+            p += digits;
+        }
+            break;
+        default:
+            // \\ \' \" \/
+            run.append(c);
+            break;
+        }
+    }
+
+    return result + QString::fromUtf8(run);
+}
@@ -0,0 +1,92 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FUNCTIONFIELDS_H
+#define FUNCTIONFIELDS_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+
+/*!
+ * \brief Arguments of a JavaScript function call response, i.e
+ *        queryUrl(1,'abc',new Array('x','y'),'0')
+ *
+ *        The response is tokenized in one pass. Fields point into the
+ *        response, which is shared, not copied, and are decoded only when
+ *        asked for. Strings and numbers become fields, arrays are flattened
+ *        and each field remembers the top level argument it came from.
+ *        Other literals such as true or null are skipped.
+ */
+class FunctionFields
+{
+public:
+    struct Field
+    {
+        const char *data;
+        int size;
+
+        // top level argument, arrays count as one argument
+        int argument;
+
+        bool quoted;
+        bool escaped;
+    };
+
+    explicit FunctionFields (const QByteArray & data);
+
+    /*!
+     * \brief No call found, or an unterminated string or call
+     */
+    bool hasError () const { return my_error; }
+
+    int size () const { return my_fields.size(); }
+    const Field & field (int i) const { return my_fields.at(i); }
+
+    /*!
+     * \brief Decoded text of a field, with escapes resolved
+     * \param i
+     * \return
+     */
+    QString at (int i) const;
+    qulonglong toULongLong (int i) const;
+
+    int argumentCount () const { return my_argumentStarts.size() - 1; }
+
+    /*!
+     * \brief Fields of an argument are [firstOf(), firstOf() + countOf())
+     */
+    int firstOf (int argument) const { return my_argumentStarts.at(argument); }
+    int countOf (int argument) const
+    {
+        return my_argumentStarts.at(argument + 1) - my_argumentStarts.at(argument);
+    }
+
+private:
+    QByteArray my_data;
+    QVector<Field> my_fields;
+
+    // index of the first field of each argument, plus one past the last
+    QVector<int> my_argumentStarts;
+    bool my_error;
+
+    void tokenize ();
+    static QString decode (const Field & field);
+};
+
+#endif // FUNCTIONFIELDS_H
@@ -0,0 +1,354 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "jsonreader.h"
+
+#include <cstring>
+
+bool JsonReader::Slice::operator== (const char *literal) const
+{
+    return (int) strlen (literal) == size && memcmp (data, literal, size) == 0;
+}
+
+JsonReader::JsonReader(const char *begin, const char *end) :
+    my_pos (begin),
+    my_end (end),
+    my_error (begin > end)
+{
+}
+
+void JsonReader::skipWhitespace()
+{
+    while (my_pos < my_end &&
+           (*my_pos == ' ' || *my_pos == '\t' || *my_pos == '\r' || *my_pos == '\n'))
+        ++ my_pos;
+}
+
+bool JsonReader::expect(char c)
+{
+    skipWhitespace();
+
+    if (my_error || my_pos >= my_end || *my_pos != c)
+    {
+        my_error = true;
+        return false;
+    }
+
+    ++ my_pos;
+    return true;
+}
+
+bool JsonReader::beginObject()
+{
+    return expect ('{');
+}
+
+bool JsonReader::beginArray()
+{
+    return expect ('[');
+}
+
+bool JsonReader::nextMember(JsonReader::Slice &key)
+{
+    skipWhitespace();
+    if (my_error || my_pos >= my_end)
+    {
+        my_error = true;
+        return false;
+    }
+
+    if (*my_pos == '}')
+    {
+        ++ my_pos;
+        return false;
+    }
+
+    if (*my_pos == ',')
+    {
+        ++ my_pos;
+        skipWhitespace();
+    }
+
+    bool escaped = false;
+    if (! scanString(key, escaped))
+        return false;
+
+    return expect (':');
+}
+
+bool JsonReader::nextElement()
+{
+    skipWhitespace();
+    if (my_error || my_pos >= my_end)
+    {
+        my_error = true;
+        return false;
+    }
+
+    if (*my_pos == ']')
+    {
+        ++ my_pos;
+        return false;
+    }
+
+    if (*my_pos == ',')
+        ++ my_pos;
+
+    return true;
+}
+
+bool JsonReader::scanString(JsonReader::Slice &raw, bool &escaped)
+{
+    if (my_pos >= my_end || *my_pos != '"')
+    {
+        my_error = true;
+        return false;
+    }
+
+    const char *begin = ++ my_pos;
+    escaped = false;
+
+    while (my_pos < my_end && *my_pos != '"')
+    {
+        if (*my_pos == '\\')
+        {
+            escaped = true;
+            ++ my_pos;
+        }
+
+        ++ my_pos;
+    }
+
+    if (my_pos >= my_end)
+    {
+        my_error = true;
+        return false;
+    }
+
+    raw.data = begin;
+    raw.size = my_pos - begin;
+
+    // closing quote
+    ++ my_pos;
+
+    return true;
+}
+
+JsonReader::Slice JsonReader::scanScalar()
+{
+    Slice raw;
+    raw.data = my_pos;
+
+    while (my_pos < my_end && ! strchr (",}] \t\r\n", *my_pos))
+        ++ my_pos;
+
+    raw.size = my_pos - raw.data;
+    if (raw.size == 0)
+        my_error = true;
+
+    return raw;
+}
+
+QString JsonReader::readString()
+{
+    skipWhitespace();
+    if (my_error || my_pos >= my_end)
+    {
+        my_error = true;
+        return QString();
+    }
+
+    Slice raw;
+    switch (*my_pos)
+    {
+    case '"':
+    {
+        bool escaped = false;
+        if (! scanString(raw, escaped))
+            return QString();
+
+        return escaped ? decodeString(raw) : QString::fromUtf8(raw.data, raw.size);
+    }
+    case '{':
+    case '[':
+        skipValue();
+        return QString();
+    default:
+        raw = scanScalar();
+        if (raw == "null")
+            return QString();
+
+        return QString::fromAscii(raw.data, raw.size);
+    }
+}
+
+qlonglong JsonReader::readLongLong()
+{
+    skipWhitespace();
+    if (my_error || my_pos >= my_end)
+    {
+        my_error = true;
+        return 0;
+    }
+
+    Slice raw;
+    bool escaped = false;
+
+    switch (*my_pos)
+    {
+    case '"':
+        if (! scanString(raw, escaped))
+            return 0;
+        return toLongLong(raw);
+    case '{':
+    case '[':
+        skipValue();
+        return 0;
+    default:
+        return toLongLong(scanScalar());
+    }
+}
+
+qulonglong JsonReader::readULongLong()
+{
+    return (qulonglong) readLongLong();
+}
+
+bool JsonReader::skipValue()
+{
+    skipWhitespace();
+    if (my_error || my_pos >= my_end)
+    {
+        my_error = true;
+        return false;
+    }
+
+    Slice raw;
+    bool escaped = false;
+
+    if (*my_pos == '"')
+        return scanString(raw, escaped);
+
+    if (*my_pos != '{' && *my_pos != '[')
+    {
+        scanScalar();
+        return ! my_error;
+    }
+
+    /// Nested containers, only strings need special care
+    int depth = 0;
+    while (my_pos < my_end)
+    {
+        switch (*my_pos)
+        {
+        case '"':
+            if (! scanString(raw, escaped))
+                return false;
+            continue;
+        case '{':
+        case '[':
+            ++ depth;
+            break;
+        case '}':
+        case ']':
+            if (-- depth == 0)
+            {
+                ++ my_pos;
+                return true;
+            }
+            break;
+        default:
+            break;
+        }
+
+        ++ my_pos;
+    }
+
+    my_error = true;
+    return false;
+}
+
+qlonglong JsonReader::toLongLong(const JsonReader::Slice &raw)
+{
+    const char *p = raw.data, *end = raw.data + raw.size;
+    bool negative = false;
+    qlonglong value = 0;
+
+    if (p < end && *p == '-')
+    {
+        negative = true;
+        ++ p;
+    }
+
+    for (; p < end && *p >= '0' && *p <= '9'; ++ p)
+        value = value * 10 + (*p - '0');
+
+    return negative ? -value : value;
+}
+
+QString JsonReader::decodeString(const JsonReader::Slice &raw)
+{
+    QString result;
+    result.reserve(raw.size);
+
+    const char *p = raw.data, *end = raw.data + raw.size;
+    const char *chunk = p;
+
+    while (p < end)
+    {
+        if (*p != '\\')
+        {
+            ++ p;
+            continue;
+        }
+
+        result.append(QString::fromUtf8(chunk, p - chunk));
+        if (++ p >= end)
+            break;
+
+        switch (*p)
+        {
+        case 'b': result.append(QLatin1Char('\b')); break;
+        case 'f': result.append(QLatin1Char('\f')); break;
+        case 'n': result.append(QLatin1Char('\n')); break;
+        case 'r': result.append(QLatin1Char('\r')); break;
+        case 't': result.append(QLatin1Char('\t')); break;
+        case 'u':
+            if (end - p > 4)
+            {
+                // surrogate pairs arrive as two escapes, appended one by one
+                bool ok = false;
+                ushort code = QByteArray::fromRawData(p + 1, 4).toUShort(&ok, 16);
+                if (ok)
+                    result.append(QChar(code));
+
+                p += 4;
+            }
+            break;
+        default:
+            // \" \\ \/
+            result.append(QLatin1Char(*p));
+            break;
+        }
+
+        chunk = ++ p;
+    }
+
+    result.append(QString::fromUtf8(chunk, p - chunk));
+    return result;
+}
@@ -0,0 +1,105 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include <QString>
+#include <QByteArray>
+
+/*!
+ * \brief Pull style JSON reader working on a borrowed buffer.
+ *
+ *        Values are decoded only when asked for, everything else is
+ *        skipped without allocation, so structs can be filled directly:
+ *
+ *        reader.beginObject();
+ *        while (reader.nextMember(key))
+ *            if (key == "id") task.id = reader.readString();
+ *            else reader.skipValue();
+ */
+class JsonReader
+{
+public:
+    /*!
+     * \brief Raw, undecoded bytes inside the buffer
+     */
+    struct Slice
+    {
+        const char *data;
+        int size;
+
+        bool operator== (const char *literal) const;
+        bool operator!= (const char *literal) const { return ! (*this == literal); }
+    };
+
+    JsonReader (const char *begin, const char *end);
+
+    bool hasError () const { return my_error; }
+
+    /*!
+     * \brief Enter an object, use nextMember() to iterate
+     * \return false if the next value is not an object
+     */
+    bool beginObject ();
+
+    /*!
+     * \brief Read the key of next member, the value must be consumed afterwards
+     * \param key
+     * \return false at the end of current object
+     */
+    bool nextMember (Slice & key);
+
+    bool beginArray ();
+
+    /*!
+     * \brief Move to the next element, which must be consumed afterwards
+     * \return false at the end of current array
+     */
+    bool nextElement ();
+
+    /*!
+     * \brief Read a string, numbers and literals are returned as text
+     * \return
+     */
+    QString readString ();
+
+    /*!
+     * \brief Read an integer, quoted numbers are accepted as well
+     * \return
+     */
+    qlonglong readLongLong ();
+    qulonglong readULongLong ();
+    int readInt () { return (int) readLongLong(); }
+
+    bool skipValue ();
+
+private:
+    const char *my_pos, *my_end;
+    bool my_error;
+
+    void skipWhitespace ();
+    bool expect (char c);
+    bool scanString (Slice & raw, bool & escaped);
+    Slice scanScalar ();
+
+    static QString decodeString (const Slice & raw);
+    static qlonglong toLongLong (const Slice & raw);
+};
+
+#endif // JSONREADER_H
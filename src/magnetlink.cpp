@@ -0,0 +1,94 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "magnetlink.h"
+
+#include <QUrl>
+#include <QRegExp>
+
+MagnetLink::MagnetLink(const QString &uri) :
+    my_size (0)
+{
+    if (! uri.startsWith("magnet:?", Qt::CaseInsensitive))
+        return;
+
+    /// QUrl would not split the query of an opaque URI
+    foreach (const QString & item, uri.mid(8).split('&', QString::SkipEmptyParts))
+    {
+        const QString & key = item.section('=', 0, 0).toLower();
+        const QString & value = QUrl::fromPercentEncoding(
+                    item.section('=', 1).replace('+', ' ').toUtf8());
+
+        if (key == "xt" && value.startsWith("urn:btih:", Qt::CaseInsensitive))
+        {
+            const QByteArray & hash = value.mid(9).toAscii();
+
+            if (hash.size() == 40 && QRegExp ("[0-9a-fA-F]{40}").exactMatch(hash))
+                my_infoHash = hash.toUpper();
+            else if (hash.size() == 32)
+                my_infoHash = fromBase32(hash.toUpper()).toHex().toUpper();
+        }
+        else if (key == "dn")
+            my_name = value;
+        else if (key == "tr")
+            my_trackers.append(value);
+        else if (key == "xl")
+            my_size = value.toULongLong();
+    }
+}
+
+QByteArray MagnetLink::fromBase32(const QByteArray &text)
+{
+    QByteArray result;
+    quint64 buffer = 0;
+    int bits = 0;
+
+    foreach (char c, text)
+    {
+        int value;
+        if (c >= 'A' && c <= 'Z')
+            value = c - 'A';
+        else if (c >= '2' && c <= '7')
+            value = c - '2' + 26;
+        else
+            return QByteArray ();
+
+        buffer = (buffer << 5) | value;
+        bits += 5;
+
+        if (bits >= 8)
+        {
+            bits -= 8;
+            result.append((char) ((buffer >> bits) & 0xff));
+        }
+    }
+
+    return result;
+}
+
+QStringList MagnetLink::find(const QString &text)
+{
+    QStringList uris;
+    foreach (const QString & word, text.split(QRegExp("\\s+"), QString::SkipEmptyParts))
+    {
+        if (word.startsWith("magnet:?", Qt::CaseInsensitive))
+            uris.append(word);
+    }
+
+    return uris;
+}
@@ -0,0 +1,68 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAGNETLINK_H
+#define MAGNETLINK_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+
+/*!
+ * \brief Fields of a magnet URI, parsed without asking the server
+ *
+ *        magnet:?xt=urn:btih:<hash>&dn=<name>&tr=<tracker>&xl=<size>
+ *        Base32 info-hashes are converted to hex.
+ */
+class MagnetLink
+{
+public:
+    explicit MagnetLink (const QString & uri);
+
+    /*!
+     * \brief Whether a BT info-hash was found, a half typed link is not valid
+     */
+    bool isValid () const { return ! my_infoHash.isEmpty(); }
+
+    /*!
+     * \brief Info-hash in upper case hex, as used by cloud BT tasks
+     */
+    QByteArray infoHash () const { return my_infoHash; }
+    QString name () const { return my_name; }
+    QStringList trackers () const { return my_trackers; }
+
+    /*!
+     * \brief Exact length hint, 0 if not given
+     */
+    unsigned long long size () const { return my_size; }
+
+    /*!
+     * \brief Magnet URIs in a piece of text, one per whitespace separated word
+     */
+    static QStringList find (const QString & text);
+
+private:
+    QByteArray my_infoHash;
+    QString my_name;
+    QStringList my_trackers;
+    unsigned long long my_size;
+
+    static QByteArray fromBase32 (const QByteArray & text);
+};
+
+#endif // MAGNETLINK_H
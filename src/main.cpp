@@ -20,15 +20,44 @@
 #include <QApplication>
 #include "util.h"
 #include "mediaplayer.h"
+#include "daemon.h"
 
 int main(int argc, char *argv[])
 {
+    /// --daemon [socket], JSON-RPC over a local socket, no UI involved
+    for (int i = 1; i < argc; ++i)
+    {
+        if (qstrcmp (argv[i], "--daemon") != 0)
+            continue;
+
+        QCoreApplication a(argc, argv);
+        a.setApplicationName("CloudClient");
+        a.setApplicationVersion("0.70");
+        a.setOrganizationName("Labo-A.L");
+
+        const QString & name = i + 1 < argc && argv[i + 1][0] != '-'
+                ? QString::fromLocal8Bit(argv[i + 1])
+                : QString ("cloudclient");
+
+        Daemon daemon;
+        if (! daemon.listen(name))
+        {
+            fprintf (stderr, "Cannot listen on %s: %s\n",
+                     name.toLocal8Bit().constData(),
+                     daemon.errorString().toLocal8Bit().constData());
+            return 1;
+        }
+
+        daemon.login();
+        return a.exec();
+    }
+
+    /// --record-traffic FILE and --replay-traffic FILE are read by ThunderCore
     QApplication a(argc, argv);
     a.setApplicationName("CloudClient");
     a.setApplicationVersion("0.70");
     a.setOrganizationName("Labo-A.L");
 
-    Util::init();
     MediaPlayer::init();
 
     MainWindow w;
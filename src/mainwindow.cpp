@@ -50,9 +50,19 @@ MainWindow::MainWindow(QWidget *parent) :
     connect (tcore, SIGNAL(BTSubTaskReady(Thunder::BitorrentTask)),
              tpanel, SLOT(setBTSubTask(Thunder::BitorrentTask)));
 
+    connect (tpanel, SIGNAL(BTFolderWanted(QString,QString)),
+             tcore, SLOT(fetchBTFolder(QString,QString)));
+    connect (tpanel, SIGNAL(BTFolderUnwanted(QString)),
+             tcore, SLOT(cancelBTFolder(QString)));
+
     connect (tcore, SIGNAL(CookiesReady(QString)),
              tpanel, SLOT(slotCookiesReady(QString)));
 
+    /// Rows follow the task store of tcore
+    tpanel->setTaskStore(tcore->getTaskStore());
+    connect (tcore, SIGNAL(CloudTaskFinished(Thunder::Task)),
+             SLOT(slotCloudTaskFinished(Thunder::Task)));
+
     connect (tpanel, SIGNAL(doThisLink(Thunder::RemoteTask,
                                        ThunderPanel::RequestType,bool)),
              SLOT(slotRequestReceived(Thunder::RemoteTask,
@@ -115,11 +125,24 @@ void MainWindow::dropEvent(QDropEvent *e)
         const QList<QUrl> & urls = e->mimeData()->urls();
         if (urls.length() > 1)
         {
-            QMessageBox::information(this,
-                                     tr("Multiple files detected"),
-                                     tr("%1 can't handle more than one file at this moment, "
-                                        "only the first one will be used.").arg(QApplication::applicationName()),
-                                     QMessageBox::Ok);
+            QStringList files;
+            foreach (const QUrl & url, urls)
+            {
+                if (url.toLocalFile().endsWith(".torrent", Qt::CaseInsensitive))
+                    files.append(url.toLocalFile());
+            }
+
+            if (files.isEmpty())
+            {
+                ui->statusBar->showMessage(tr("No torrent files dropped"));
+                return;
+            }
+
+            /// All files of every torrent are added, no dialog for each
+            ui->statusBar->showMessage(tr("Uploading %1 torrent(s) ..").arg(files.size()));
+            tcore->uploadBitorrents(files);
+
+            return;
         }
 
         AddCloudTask *act = new AddCloudTask (tcore, this);
@@ -147,7 +170,10 @@ void MainWindow::login()
     const QString & credential = settings.value("Credential").toString();
 
     if (! user.isEmpty() && ! credential.isEmpty())
+    {
+        tcore->loadCachedTasks(user);
         tcore->login(user, credential);
+    }
 
     // DIRTY FIX! @TODO
     {
@@ -226,6 +252,24 @@ void MainWindow::slotRequestReceived(const Thunder::RemoteTask &task,
 
 }
 
+void MainWindow::slotCloudTaskFinished(const Thunder::Task &task)
+{
+    QSettings settings;
+    settings.beginGroup("Transf0r");
+
+    /// BT folders are downloaded file by file, not handled here
+    if (! settings.value("AutoDownloadFinished", false).toBool() ||
+            task.type == Thunder::BT)
+        return;
+
+    Thunder::RemoteTask remote;
+    remote.name = task.name;
+    remote.size = Util::toReadableSize(task.size);
+    remote.url  = QString::fromUtf8(task.link);
+
+    slotRequestReceived(remote, ThunderPanel::Download, false);
+}
+
 bool MainWindow::question(const QString &body, const QString &title)
 {
     return QMessageBox::No == QMessageBox::question(this, title, body, QMessageBox::Yes,
@@ -236,15 +280,15 @@ void MainWindow::slotIndirectRequestReceived(ThunderPanel::IndirectRequestType t
 {
     if (type == ThunderPanel::RemoveTasks)
     {
-        const QPair<QStringList, QList<int> > & ids = tpanel->getSelectedTaskIDsAndRows();
-
-        if (question ( tr("Remove selected %1 item(s)?").arg(ids.first.size())) )
+        const QStringList & ids = tpanel->getSelectedTaskIds();
+        if (ids.isEmpty())
             return;
 
-        tcore->removeCloudTasks(ids.first);
+        if (question ( tr("Remove selected %1 item(s)?").arg(ids.size())) )
+            return;
 
-        /// Buggy? Unlikely.
-        tpanel->removeSelectedTasks(ids.second);
+        /// Rows go once the server confirms
+        tcore->removeCloudTasks(ids);
 
     } else if (type == ThunderPanel::AddTask) {
 
@@ -259,14 +303,7 @@ void MainWindow::slotStatusChanged(ThunderCore::ChangeType type)
         break;
     case ThunderCore::TaskChanged:
     {
-        const QList<Thunder::Task> & cloudTasks = tcore->getCloudTasks();
-        tpanel->setCloudTasks(cloudTasks);
-
-        foreach (const Thunder::Task & task, cloudTasks)
-            if (task.type == Thunder::BT)
-            {
-                tcore->getContentsOfBTFolder(task, 1);
-            }
+        /// tpanel follows the task store, BT folders are loaded on demand
     }
         break;
     case ThunderCore::CapchaReady:
@@ -359,7 +396,7 @@ void MainWindow::on_actionExportTasks_triggered()
     QByteArray data;
     foreach (const Thunder::Task & task, cloudTasks)
     {
-        data.append(task.source.toAscii()).append("\n");
+        data.append(task.source).append("\n");
     }
 
     bool ok = Util::writeFile(file, data);
@@ -73,6 +73,7 @@ private slots:
                               ThunderPanel::RequestType type,
                               bool autoOpen);
     void slotIndirectRequestReceived (ThunderPanel::IndirectRequestType type);
+    void slotCloudTaskFinished (const Thunder::Task & task);
 
     void slotShowOrHideWindow ();
 
@@ -53,6 +53,7 @@ PreferencesDlg::PreferencesDlg(QWidget *parent) :
     settings.beginGroup("Transf0r");
     ui->storageLocation->setText(settings.value("StorageLocation", Util::getHomeLocation()).toString());
     ui->useVoiceNotification->setChecked(settings.value("UseVoiceNotification", false).toBool());
+    ui->autoDownloadFinished->setChecked(settings.value("AutoDownloadFinished", false).toBool());
     settings.endGroup();
 
     int cIdx = settings.value("Index").toInt();
@@ -101,6 +102,7 @@ void PreferencesDlg::on_buttonBox_accepted()
 
     settings.beginGroup("Transf0r");
     settings.setValue("UseVoiceNotification", ui->useVoiceNotification->isChecked());
+    settings.setValue("AutoDownloadFinished", ui->autoDownloadFinished->isChecked());
     settings.setValue("StorageLocation", ui->storageLocation->text());
     settings.endGroup();
 
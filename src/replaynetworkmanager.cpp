@@ -0,0 +1,157 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "replaynetworkmanager.h"
+
+#include <QNetworkCookieJar>
+#include <QNetworkCookie>
+#include <QTimer>
+
+ReplayNetworkAccessManager::ReplayNetworkAccessManager(QObject *parent) :
+    QNetworkAccessManager(parent),
+    my_timed (false)
+{
+}
+
+bool ReplayNetworkAccessManager::load(const QString &path)
+{
+    bool ok = false;
+    const QList<TrafficRecord> & records = TrafficRecorder::load(path, &ok);
+
+    my_queues.clear();
+    foreach (const TrafficRecord & record, records)
+    {
+        my_queues[key (record.operation, QUrl::fromEncoded(record.url))].records.append(record);
+    }
+
+    return ok;
+}
+
+QByteArray ReplayNetworkAccessManager::key(int operation, const QUrl &url)
+{
+    return QByteArray::number(operation) + " " + url.host().toAscii() + url.encodedPath();
+}
+
+QNetworkReply *ReplayNetworkAccessManager::createRequest(QNetworkAccessManager::Operation op,
+                                                         const QNetworkRequest &request,
+                                                         QIODevice *outgoingData)
+{
+    Q_UNUSED(outgoingData);
+
+    const TrafficRecord *record = 0;
+
+    QHash<QByteArray, Queue>::iterator it = my_queues.find(key (op, request.url()));
+    if (it != my_queues.end() && ! it->records.isEmpty())
+    {
+        record = &it->records.at(qMin (it->next, it->records.size() - 1));
+        ++ it->next;
+
+        /// Login cookies come with the replies, same as on the wire
+        for (int i = 0; i < record->headerNames.size(); ++i)
+        {
+            if (qstricmp (record->headerNames.at(i).constData(), "Set-Cookie") == 0)
+                cookieJar()->setCookiesFromUrl(
+                            QNetworkCookie::parseCookies(record->headerValues.at(i)),
+                            request.url());
+        }
+    }
+
+    return new ReplayReply (op, request, record, my_timed && record ? record->elapsed : 0, this);
+}
+
+/////// ReplayReply
+
+ReplayReply::ReplayReply(QNetworkAccessManager::Operation op,
+                         const QNetworkRequest &request,
+                         const TrafficRecord *record,
+                         int delay,
+                         QObject *parent) :
+    QNetworkReply(parent),
+    my_offset (0)
+{
+    setOperation(op);
+    setRequest(request);
+    setUrl(request.url());
+
+    if (record)
+    {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, record->status);
+        for (int i = 0; i < record->headerNames.size(); ++i)
+        {
+            setRawHeader(record->headerNames.at(i), record->headerValues.at(i));
+        }
+
+        my_data = record->body;
+    }
+    else
+    {
+        setAttribute(QNetworkRequest::HttpStatusCodeAttribute, 404);
+        setError(ContentNotFoundError, tr("Not in the replayed capture"));
+    }
+
+    open (ReadOnly | Unbuffered);
+    QTimer::singleShot(delay, this, SLOT(slotFinish()));
+}
+
+void ReplayReply::abort()
+{
+    if (isFinished())
+        return;
+
+    my_data.clear();
+    setError(OperationCanceledError, tr("Operation canceled"));
+
+    emit error (OperationCanceledError);
+    setFinished(true);
+    emit finished();
+}
+
+qint64 ReplayReply::bytesAvailable() const
+{
+    return my_data.size() - my_offset + QNetworkReply::bytesAvailable();
+}
+
+qint64 ReplayReply::readData(char *data, qint64 maxSize)
+{
+    if (my_offset >= my_data.size())
+        return -1;
+
+    const qint64 count = qMin (maxSize, my_data.size() - my_offset);
+    memcpy (data, my_data.constData() + my_offset, count);
+    my_offset += count;
+
+    return count;
+}
+
+void ReplayReply::slotFinish()
+{
+    /// Aborted in the meantime
+    if (isFinished())
+        return;
+
+    emit metaDataChanged();
+
+    if (! my_data.isEmpty())
+        emit readyRead();
+
+    if (error() != NoError)
+        emit error (error());
+
+    setFinished(true);
+    emit finished();
+}
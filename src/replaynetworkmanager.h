@@ -0,0 +1,96 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAYNETWORKMANAGER_H
+#define REPLAYNETWORKMANAGER_H
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QHash>
+
+#include "trafficrecorder.h"
+
+/*!
+ * \brief Serves a TrafficRecorder capture instead of the network
+ *
+ *        Replies are matched by operation and URL path, in the order they
+ *        were captured; query strings carry timestamps and are ignored.
+ *        When a path runs out of records its last one is served again.
+ */
+class ReplayNetworkAccessManager : public QNetworkAccessManager
+{
+    Q_OBJECT
+public:
+    explicit ReplayNetworkAccessManager(QObject *parent = 0);
+
+    bool load (const QString & path);
+
+    /*!
+     * \brief Delay replies by their captured latency, off by default
+     */
+    void setTimed (bool timed) { my_timed = timed; }
+
+protected:
+    QNetworkReply *createRequest (Operation op,
+                                  const QNetworkRequest & request,
+                                  QIODevice *outgoingData);
+
+private:
+    struct Queue
+    {
+        Queue () : next (0) {}
+
+        QList<TrafficRecord> records;
+        int next;
+    };
+
+    QHash<QByteArray, Queue> my_queues;
+    bool my_timed;
+
+    static QByteArray key (int operation, const QUrl & url);
+};
+
+/*!
+ * \brief Reply carrying a recorded response
+ */
+class ReplayReply : public QNetworkReply
+{
+    Q_OBJECT
+public:
+    ReplayReply (QNetworkAccessManager::Operation op,
+                 const QNetworkRequest & request,
+                 const TrafficRecord *record,
+                 int delay,
+                 QObject *parent = 0);
+
+    void abort ();
+    qint64 bytesAvailable () const;
+    bool isSequential () const { return true; }
+
+protected:
+    qint64 readData (char *data, qint64 maxSize);
+
+private:
+    QByteArray my_data;
+    qint64 my_offset;
+
+private slots:
+    void slotFinish ();
+};
+
+#endif // REPLAYNETWORKMANAGER_H
@@ -0,0 +1,203 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "requestscheduler.h"
+
+RequestScheduler::RequestScheduler(QNetworkAccessManager *nam, QObject *parent) :
+    QObject(parent),
+    my_nam (nam),
+    my_nextTicket (1),
+    my_rateLimit (0)
+{
+    my_dispatchTimer.setSingleShot(true);
+    connect (&my_dispatchTimer, SIGNAL(timeout()), SLOT(slotDispatch()));
+
+    connect (my_nam, SIGNAL(finished(QNetworkReply*)),
+             SLOT(slotFinished(QNetworkReply*)));
+}
+
+void RequestScheduler::setLaneLimit(RequestScheduler::Lane lane, int limit)
+{
+    my_lanes[lane].limit = qMax (1, limit);
+    slotDispatch();
+}
+
+void RequestScheduler::setRateLimit(int requests)
+{
+    my_rateLimit = qMax (0, requests);
+    slotDispatch();
+}
+
+int RequestScheduler::queueDepth(RequestScheduler::Lane lane)
+{
+    return my_lanes[lane].queue.size();
+}
+
+qint64 RequestScheduler::averageWait(RequestScheduler::Lane lane)
+{
+    const LaneState & state = my_lanes[lane];
+    return state.dispatched == 0 ? 0 : state.waited / state.dispatched;
+}
+
+int RequestScheduler::get(const QNetworkRequest &request, RequestScheduler::Lane lane)
+{
+    return enqueue (request, QNetworkAccessManager::GetOperation, QByteArray(), 0, lane);
+}
+
+int RequestScheduler::post(const QNetworkRequest &request,
+                           const QByteArray &body,
+                           RequestScheduler::Lane lane)
+{
+    return enqueue (request, QNetworkAccessManager::PostOperation, body, 0, lane);
+}
+
+int RequestScheduler::post(const QNetworkRequest &request,
+                           QHttpMultiPart *multiPart,
+                           RequestScheduler::Lane lane)
+{
+    /// Owned by us while queued
+    multiPart->setParent(this);
+    return enqueue (request, QNetworkAccessManager::PostOperation, QByteArray(), multiPart, lane);
+}
+
+int RequestScheduler::enqueue(const QNetworkRequest &request,
+                              QNetworkAccessManager::Operation operation,
+                              const QByteArray &body,
+                              QHttpMultiPart *multiPart,
+                              RequestScheduler::Lane lane)
+{
+    PendingRequest pending;
+    pending.ticket    = my_nextTicket ++;
+    pending.request   = request;
+    pending.operation = operation;
+    pending.body      = body;
+    pending.multiPart = multiPart;
+    pending.queuedAt  = QDateTime::currentMSecsSinceEpoch();
+
+    pending.request.setAttribute(TicketAttribute, pending.ticket);
+    my_lanes[lane].queue.append(pending);
+
+    slotDispatch();
+    return pending.ticket;
+}
+
+bool RequestScheduler::isActive(int ticket)
+{
+    const QPointer<QNetworkReply> & reply = my_running.value(ticket);
+    if (reply && reply->isRunning())
+        return true;
+
+    for (int lane = 0; lane < LaneCount; ++ lane)
+    {
+        foreach (const PendingRequest & pending, my_lanes[lane].queue)
+        {
+            if (pending.ticket == ticket)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+void RequestScheduler::cancel(int ticket)
+{
+    QPointer<QNetworkReply> reply = my_running.value(ticket);
+    if (reply)
+    {
+        if (reply->isRunning())
+            reply->abort();
+
+        return;
+    }
+
+    for (int lane = 0; lane < LaneCount; ++ lane)
+    {
+        QList<PendingRequest> & queue = my_lanes[lane].queue;
+        for (int i = 0; i < queue.size(); ++ i)
+        {
+            if (queue.at(i).ticket == ticket)
+            {
+                const PendingRequest pending = queue.takeAt(i);
+                delete pending.multiPart;
+
+                emit cancelled (ticket, pending.request);
+                return;
+            }
+        }
+    }
+}
+
+void RequestScheduler::slotDispatch()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    /// Sliding window of one second for the rate cap
+    while (! my_recentDispatches.isEmpty() && now - my_recentDispatches.first() >= 1000)
+        my_recentDispatches.removeFirst();
+
+    /// Lanes are served in order of priority
+    for (int lane = 0; lane < LaneCount; ++ lane)
+    {
+        LaneState & state = my_lanes[lane];
+
+        while (! state.queue.isEmpty() && state.running < state.limit)
+        {
+            if (my_rateLimit > 0 && my_recentDispatches.size() >= my_rateLimit)
+            {
+                my_dispatchTimer.start(1000 - (now - my_recentDispatches.first()));
+                return;
+            }
+
+            const PendingRequest pending = state.queue.takeFirst();
+            QNetworkReply *reply = 0;
+
+            if (pending.multiPart)
+            {
+                reply = my_nam->post(pending.request, pending.multiPart);
+                pending.multiPart->setParent(reply);
+            }
+            else if (pending.operation == QNetworkAccessManager::PostOperation)
+                reply = my_nam->post(pending.request, pending.body);
+            else
+                reply = my_nam->get(pending.request);
+
+            my_running.insert(pending.ticket, reply);
+            my_runningLanes.insert(pending.ticket, (Lane) lane);
+            my_recentDispatches.append(now);
+
+            ++ state.running;
+            ++ state.dispatched;
+            state.waited += now - pending.queuedAt;
+        }
+    }
+}
+
+void RequestScheduler::slotFinished(QNetworkReply *reply)
+{
+    bool ok = false;
+    int ticket = reply->request().attribute(TicketAttribute).toInt(&ok);
+
+    if (! ok || ! my_runningLanes.contains(ticket))
+        return;
+
+    -- my_lanes[my_runningLanes.take(ticket)].running;
+    my_running.remove(ticket);
+
+    /// Not right away, we may be inside abort()
+    QTimer::singleShot(0, this, SLOT(slotDispatch()));
+}
@@ -0,0 +1,164 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REQUESTSCHEDULER_H
+#define REQUESTSCHEDULER_H
+
+#include <QObject>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QHttpMultiPart>
+#include <QDateTime>
+#include <QPointer>
+#include <QTimer>
+#include <QList>
+#include <QHash>
+
+/*!
+ * \brief Queues requests by priority lane before they hit the network,
+ *        with a concurrency limit per lane and a global request rate cap
+ */
+class RequestScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    enum Lane
+    {
+        // user is waiting, i.e login, add task
+        Interactive,
+
+        // task list pages
+        Refresh,
+
+        // BT folder contents
+        Prefetch,
+
+        // i.e task_delay, history
+        Housekeeping,
+
+        LaneCount
+    };
+
+    /*!
+     * \brief Request attribute holding the ticket of a request
+     */
+    static const QNetworkRequest::Attribute TicketAttribute =
+            (QNetworkRequest::Attribute) (QNetworkRequest::User + 3);
+
+    explicit RequestScheduler(QNetworkAccessManager *nam, QObject *parent = 0);
+
+    /*!
+     * \brief Queue a request
+     * \return ticket, stays valid until the reply finished
+     */
+    int get (const QNetworkRequest & request, Lane lane);
+    int post (const QNetworkRequest & request, const QByteArray & body, Lane lane);
+
+    /*!
+     * \brief Queue a multipart POST, its parts are read from their devices
+     *        when the request is sent
+     * \param multiPart taken over, deleted along with the reply
+     */
+    int post (const QNetworkRequest & request, QHttpMultiPart *multiPart, Lane lane);
+
+    /*!
+     * \brief Whether a request is queued or in flight
+     * \param ticket
+     * \return
+     */
+    bool isActive (int ticket);
+
+    /*!
+     * \brief Drop a queued request, or abort it when in flight. Either way
+     *        the owner hears back, through cancelled() or through the
+     *        finished() of the aborted reply
+     * \param ticket
+     */
+    void cancel (int ticket);
+
+    void setLaneLimit (Lane lane, int limit);
+
+    /*!
+     * \brief Cap requests sent within a second, 0 for no limit
+     * \param requests
+     */
+    void setRateLimit (int requests);
+
+    int queueDepth (Lane lane);
+
+    /*!
+     * \brief Average msecs a request of the lane spent in queue
+     * \param lane
+     * \return
+     */
+    qint64 averageWait (Lane lane);
+
+signals:
+    /*!
+     * \brief A queued request was dropped before it was sent
+     * \param ticket
+     * \param request
+     */
+    void cancelled (int ticket, const QNetworkRequest & request);
+
+private:
+    struct PendingRequest
+    {
+        int ticket;
+        QNetworkRequest request;
+        QNetworkAccessManager::Operation operation;
+        QByteArray body;
+        QHttpMultiPart *multiPart;
+        qint64 queuedAt;
+    };
+
+    struct LaneState
+    {
+        LaneState () : limit (1), running (0), dispatched (0), waited (0) {}
+
+        QList<PendingRequest> queue;
+        int limit, running;
+
+        // for averageWait()
+        qint64 dispatched, waited;
+    };
+
+    QNetworkAccessManager *my_nam;
+    LaneState my_lanes[LaneCount];
+    int my_nextTicket;
+
+    int my_rateLimit;
+    QList<qint64> my_recentDispatches;
+    QTimer my_dispatchTimer;
+
+    QHash<int, QPointer<QNetworkReply> > my_running;
+    QHash<int, Lane> my_runningLanes;
+
+    int enqueue (const QNetworkRequest & request,
+                 QNetworkAccessManager::Operation operation,
+                 const QByteArray & body,
+                 QHttpMultiPart *multiPart,
+                 Lane lane);
+
+private slots:
+    void slotDispatch ();
+    void slotFinished (QNetworkReply *reply);
+};
+
+#endif // REQUESTSCHEDULER_H
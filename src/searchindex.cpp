@@ -0,0 +1,381 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "searchindex.h"
+
+#include <QtAlgorithms>
+#include <algorithm>
+
+// removed documents are dropped from the postings past this count
+#define SEARCH_COMPACT_THRESHOLD 4096
+
+static inline bool isCJK (ushort c)
+{
+    return (c >= 0x3040 && c <= 0x30FF)     // kana
+            || (c >= 0x3400 && c <= 0x4DBF) // ideographs, extension A
+            || (c >= 0x4E00 && c <= 0x9FFF) // ideographs
+            || (c >= 0xAC00 && c <= 0xD7AF) // hangul
+            || (c >= 0xF900 && c <= 0xFAFF);
+}
+
+static QVector<int> intersect (const QVector<int> & a, const QVector<int> & b)
+{
+    QVector<int> result;
+    result.reserve(qMin (a.size(), b.size()));
+
+    int i = 0, j = 0;
+    while (i < a.size() && j < b.size())
+    {
+        if (a.at(i) < b.at(j))
+            ++ i;
+        else if (b.at(j) < a.at(i))
+            ++ j;
+        else
+        {
+            result.append(a.at(i));
+            ++ i;
+            ++ j;
+        }
+    }
+
+    return result;
+}
+
+SearchIndex::SearchIndex() :
+    my_removed (0)
+{
+}
+
+QString SearchIndex::fold(const QString &text)
+{
+    QString folded = text.toCaseFolded();
+
+    QChar *c = folded.data();
+    for (int i = 0; i < folded.size(); ++i)
+    {
+        if (! c[i].isLetterOrNumber())
+            c[i] = QLatin1Char (' ');
+    }
+
+    return folded;
+}
+
+QList<quint64> SearchIndex::grams(const QString &folded)
+{
+    QList<quint64> result;
+
+    const ushort *c = folded.utf16();
+    const int size  = folded.size();
+
+    for (int i = 0; i + 2 < size; ++i)
+    {
+        if (c[i] == ' ' || c[i + 1] == ' ' || c[i + 2] == ' ')
+            continue;
+
+        result.append((quint64 (c[i]) << 32) | (quint64 (c[i + 1]) << 16) | c[i + 2]);
+    }
+
+    /// Trigram keys are above 0xFFFF, single characters can't collide
+    for (int i = 0; i < size; ++i)
+    {
+        if (isCJK (c[i]))
+            result.append(c[i]);
+    }
+
+    qSort (result);
+    result.erase(std::unique (result.begin(), result.end()), result.end());
+
+    return result;
+}
+
+void SearchIndex::addDocument(quint64 task, int row, const QString &folded)
+{
+    const int document = my_documents.size();
+
+    Document doc;
+    doc.task    = task;
+    doc.row     = row;
+    doc.text    = folded;
+    doc.removed = false;
+    my_documents.append(doc);
+
+    foreach (const quint64 & gram, grams (folded))
+        my_postings[gram].append(document);
+
+    if (row < 0)
+        my_taskDocuments.insert(task, document);
+    else
+        my_subtaskDocuments[task].append(document);
+}
+
+void SearchIndex::removeDocument(int document)
+{
+    Document & doc = my_documents[document];
+    if (doc.removed)
+        return;
+
+    doc.removed = true;
+    doc.text.clear();
+    ++ my_removed;
+}
+
+void SearchIndex::removeSubtasks(quint64 task)
+{
+    foreach (const int & document, my_subtaskDocuments.take(task))
+        removeDocument(document);
+}
+
+void SearchIndex::compact()
+{
+    if (my_removed < SEARCH_COMPACT_THRESHOLD || my_removed * 2 < my_documents.size())
+        return;
+
+    const QVector<Document> documents = my_documents;
+
+    my_documents.clear();
+    my_postings.clear();
+    my_taskDocuments.clear();
+    my_subtaskDocuments.clear();
+    my_removed = 0;
+
+    foreach (const Document & doc, documents)
+    {
+        if (! doc.removed)
+            addDocument(doc.task, doc.row, doc.text);
+    }
+}
+
+void SearchIndex::setTasks(const QList<Thunder::Task> &tasks)
+{
+    QWriteLocker locker (&my_lock);
+
+    QSet<quint64> seen;
+    seen.reserve(tasks.size());
+
+    foreach (const Thunder::Task & task, tasks)
+    {
+        seen.insert(task.id);
+
+        const QString & folded = fold (task.name);
+        const int document = my_taskDocuments.value(task.id, -1);
+
+        if (document != -1)
+        {
+            if (my_documents.at(document).text == folded)
+                continue;
+
+            removeDocument(document);
+        }
+
+        addDocument(task.id, -1, folded);
+    }
+
+    foreach (const quint64 & id, my_taskDocuments.keys())
+    {
+        if (seen.contains(id))
+            continue;
+
+        removeDocument(my_taskDocuments.take(id));
+        removeSubtasks(id);
+    }
+
+    compact ();
+}
+
+void SearchIndex::removeTasks(const QList<quint64> &ids)
+{
+    QWriteLocker locker (&my_lock);
+
+    foreach (const quint64 & id, ids)
+    {
+        if (my_taskDocuments.contains(id))
+            removeDocument(my_taskDocuments.take(id));
+
+        removeSubtasks(id);
+    }
+
+    compact ();
+}
+
+void SearchIndex::setSubtasks(quint64 task, int firstRow, const QList<Thunder::BTSubTask> &subtasks)
+{
+    QWriteLocker locker (&my_lock);
+
+    if (firstRow == 0)
+        removeSubtasks(task);
+
+    for (int i = 0; i < subtasks.size(); ++i)
+        addDocument(task, firstRow + i, fold (subtasks.at(i).name));
+
+    compact ();
+}
+
+void SearchIndex::clear()
+{
+    QWriteLocker locker (&my_lock);
+
+    my_documents.clear();
+    my_postings.clear();
+    my_taskDocuments.clear();
+    my_subtaskDocuments.clear();
+    my_removed = 0;
+}
+
+QVector<int> SearchIndex::candidates(const QString &word) const
+{
+    const QList<quint64> & keys = grams (word);
+
+    /// Start from the rarest gram, the list only shrinks from there
+    QList<QPair<int, quint64> > lists;
+    foreach (const quint64 & key, keys)
+    {
+        QHash<quint64, QVector<int> >::const_iterator it = my_postings.constFind(key);
+        if (it == my_postings.constEnd())
+            return QVector<int> ();
+
+        lists.append(qMakePair (it.value().size(), key));
+    }
+
+    qSort (lists);
+
+    QVector<int> result = my_postings.value(lists.first().second);
+    for (int i = 1; i < lists.size() && ! result.isEmpty(); ++i)
+        result = intersect (result, my_postings.value(lists.at(i).second));
+
+    return result;
+}
+
+SearchIndex::Result SearchIndex::query(const QString &text) const
+{
+    Result result;
+    result.text = text;
+
+    const QStringList & words = fold (text).split(QLatin1Char (' '), QString::SkipEmptyParts);
+    if (words.isEmpty())
+        return result;
+
+    QReadLocker locker (&my_lock);
+
+    /// Short latin words have no gram, every document is checked then
+    QVector<int> documents;
+    bool everything = true;
+
+    foreach (const QString & word, words)
+    {
+        if (grams (word).isEmpty())
+            continue;
+
+        documents  = everything ? candidates (word) : intersect (documents, candidates (word));
+        everything = false;
+
+        if (documents.isEmpty())
+            return result;
+    }
+
+    if (everything)
+    {
+        documents.resize(my_documents.size());
+        for (int i = 0; i < documents.size(); ++i)
+            documents[i] = i;
+    }
+
+    foreach (const int & document, documents)
+    {
+        const Document & doc = my_documents.at(document);
+        if (doc.removed)
+            continue;
+
+        bool matches = true;
+        foreach (const QString & word, words)
+        {
+            if (! doc.text.contains(word))
+            {
+                matches = false;
+                break;
+            }
+        }
+
+        if (! matches)
+            continue;
+
+        if (doc.row < 0)
+            result.tasks.insert(doc.task);
+        else
+            result.subtasks[doc.task].insert(doc.row);
+    }
+
+    return result;
+}
+
+SearchFilterModel::SearchFilterModel(int idRole, QObject *parent) :
+    QSortFilterProxyModel (parent),
+    my_idRole (idRole),
+    my_active (false)
+{
+}
+
+void SearchFilterModel::setResult(const SearchIndex::Result &result)
+{
+    my_result = result;
+    my_active = true;
+
+    invalidateFilter();
+}
+
+void SearchFilterModel::clearResult()
+{
+    if (! my_active)
+        return;
+
+    my_result = SearchIndex::Result ();
+    my_active = false;
+
+    invalidateFilter();
+}
+
+void SearchFilterModel::sort(int column, Qt::SortOrder order)
+{
+    if (sourceModel())
+        sourceModel()->sort(column, order);
+}
+
+quint64 SearchFilterModel::taskId(int source_row, const QModelIndex &source_parent) const
+{
+    return sourceModel()->index(source_row, 0, source_parent).data(my_idRole).toULongLong();
+}
+
+bool SearchFilterModel::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const
+{
+    if (! my_active)
+        return QSortFilterProxyModel::filterAcceptsRow(source_row, source_parent);
+
+    /// A task matches by its name, or by one of its sub tasks
+    if (! source_parent.isValid())
+    {
+        const quint64 id = taskId (source_row, source_parent);
+        return my_result.tasks.contains(id) || my_result.subtasks.contains(id);
+    }
+
+    /// Every sub task of a matching folder is shown
+    const quint64 id = taskId (source_parent.row(), source_parent.parent());
+    if (my_result.tasks.contains(id))
+        return true;
+
+    QHash<quint64, QSet<int> >::const_iterator it = my_result.subtasks.constFind(id);
+    return it != my_result.subtasks.constEnd() && it.value().contains(source_row);
+}
@@ -0,0 +1,149 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QReadWriteLock>
+#include <QSortFilterProxyModel>
+
+#include "CloudObject.h"
+
+/*!
+ * \brief Trigram index over task names and BT sub task names
+ *
+ *        Names are case folded, punctuation becomes a space. Every three
+ *        characters are indexed, and each CJK character on its own, since
+ *        a CJK word is often one or two characters long. Candidates are
+ *        always checked against the whole name, so the index only makes
+ *        the answer faster, never different.
+ *
+ *        Updates happen on the GUI thread, queries may run anywhere.
+ */
+class SearchIndex
+{
+public:
+    struct Result
+    {
+        QString text;
+
+        // tasks with a matching name
+        QSet<quint64> tasks;
+
+        // matching rows in BT folders, by task id
+        QHash<quint64, QSet<int> > subtasks;
+
+        bool isEmpty () const { return tasks.isEmpty() && subtasks.isEmpty(); }
+    };
+
+    SearchIndex ();
+
+    /*!
+     * \brief Sync with a new task list, only renamed, new or gone tasks are touched
+     * \param tasks
+     */
+    void setTasks (const QList<Thunder::Task> & tasks);
+    void removeTasks (const QList<quint64> & ids);
+
+    /*!
+     * \brief Index sub tasks shown from firstRow on, 0 replaces the folder
+     * \param task
+     * \param firstRow
+     * \param subtasks
+     */
+    void setSubtasks (quint64 task, int firstRow, const QList<Thunder::BTSubTask> & subtasks);
+
+    void clear ();
+
+    /*!
+     * \brief Names containing every word of text
+     * \param text
+     * \return
+     */
+    Result query (const QString & text) const;
+
+    static QString fold (const QString & text);
+
+private:
+    struct Document
+    {
+        quint64 task;
+
+        // row in the BT folder, -1 for the task itself
+        int row;
+
+        QString text;
+        bool removed;
+    };
+
+    QVector<Document> my_documents;
+    QHash<quint64, QVector<int> > my_postings;
+
+    QHash<quint64, int> my_taskDocuments;
+    QHash<quint64, QList<int> > my_subtaskDocuments;
+    int my_removed;
+
+    mutable QReadWriteLock my_lock;
+
+    void addDocument (quint64 task, int row, const QString & name);
+    void removeDocument (int document);
+    void removeSubtasks (quint64 task);
+    void compact ();
+
+    static QList<quint64> grams (const QString & folded);
+    QVector<int> candidates (const QString & word) const;
+};
+
+/*!
+ * \brief Shows rows found by a SearchIndex query, with their parents
+ */
+class SearchFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+public:
+    /*!
+     * \param idRole Role of the column 0 holding the task id
+     */
+    explicit SearchFilterModel (int idRole, QObject *parent = 0);
+
+    void setResult (const SearchIndex::Result & result);
+    void clearResult ();
+    bool hasResult () const { return my_active; }
+
+    /*!
+     * \brief Rows keep the order of the source model, which sorts itself
+     */
+    void sort (int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+protected:
+    bool filterAcceptsRow (int source_row, const QModelIndex &source_parent) const;
+
+private:
+    int my_idRole;
+    bool my_active;
+    SearchIndex::Result my_result;
+
+    quint64 taskId (int source_row, const QModelIndex & source_parent) const;
+};
+
+#endif // SEARCHINDEX_H
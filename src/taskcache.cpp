@@ -0,0 +1,299 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "taskcache.h"
+
+#define TASK_COLUMNS "id, cid, status, size, type, name, link, source, progress"
+
+TaskCache::TaskCache(QObject *parent) :
+    QObject(parent),
+    my_connectionName(QString("TaskCache-%1").arg((quintptr) this))
+{
+}
+
+TaskCache::~TaskCache()
+{
+    close ();
+}
+
+bool TaskCache::isOpen()
+{
+    return my_db.isOpen();
+}
+
+bool TaskCache::open(const QString &user)
+{
+    close ();
+
+    const QString & location =
+            QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+    const QString & file = location + "/cache-" + Util::getMD5Hex(user) + ".sqlite";
+    Util::createDirectory(file);
+
+    /// Session cookies live here as well, keep it private before anything
+    /// is written to it
+    QFile db (file);
+    if (! db.open(QIODevice::ReadWrite)
+            || ! db.setPermissions(QFile::ReadOwner | QFile::WriteOwner))
+    {
+        qDebug() << "Task cache unavailable:" << db.errorString();
+        return false;
+    }
+    db.close();
+
+    my_db = QSqlDatabase::addDatabase("QSQLITE", my_connectionName);
+    my_db.setDatabaseName(file);
+
+    if (! my_db.open())
+    {
+        qDebug() << "Task cache unavailable:" << my_db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query (my_db);
+    query.exec("PRAGMA synchronous = NORMAL");
+    query.exec("CREATE TABLE IF NOT EXISTS tasks ("
+               "id TEXT PRIMARY KEY, cid TEXT, status INTEGER, size INTEGER, "
+               "type INTEGER, name TEXT, link TEXT, source TEXT, progress INTEGER, "
+               "position INTEGER)");
+    query.exec("CREATE INDEX IF NOT EXISTS tasks_cid ON tasks (cid)");
+    query.exec("CREATE TABLE IF NOT EXISTS bt_subtasks ("
+               "taskid TEXT, position INTEGER, id TEXT, name TEXT, size TEXT, "
+               "format_size TEXT, link TEXT, findex TEXT)");
+    query.exec("CREATE INDEX IF NOT EXISTS bt_subtasks_taskid "
+               "ON bt_subtasks (taskid, position)");
+    query.exec("CREATE TABLE IF NOT EXISTS session (key TEXT PRIMARY KEY, value TEXT)");
+
+    return true;
+}
+
+void TaskCache::close()
+{
+    if (! my_db.isValid())
+        return;
+
+    my_db.close();
+    my_db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(my_connectionName);
+}
+
+bool TaskCache::exec(QSqlQuery &query)
+{
+    if (query.exec())
+        return true;
+
+    qDebug() << "Task cache query failed:" << query.lastError().text();
+    return false;
+}
+
+Thunder::Task TaskCache::taskFromQuery(const QSqlQuery &query)
+{
+    Thunder::Task task;
+    task.id       = query.value(0).toULongLong();
+    task.cid      = query.value(1).toString().toAscii();
+    task.status   = query.value(2).toInt();
+    task.size     = query.value(3).toULongLong();
+    task.type     = query.value(4).toInt();
+    task.name     = query.value(5).toString();
+    task.link     = query.value(6).toString().toUtf8();
+    task.source   = query.value(7).toString().toUtf8();
+    task.progress = query.value(8).toInt();
+
+    /// expires is known again after the next refresh
+
+    return task;
+}
+
+QList<Thunder::Task> TaskCache::loadTasks()
+{
+    QList<Thunder::Task> tasks;
+    if (! isOpen()) return tasks;
+
+    QSqlQuery query (my_db);
+    query.prepare("SELECT " TASK_COLUMNS " FROM tasks ORDER BY position");
+    if (! exec (query)) return tasks;
+
+    while (query.next())
+        tasks.append(taskFromQuery(query));
+
+    return tasks;
+}
+
+void TaskCache::storeTasks(const QList<Thunder::Task> &tasks)
+{
+    if (! isOpen()) return;
+
+    my_db.transaction();
+
+    QSqlQuery query (my_db);
+    query.exec("DELETE FROM tasks");
+
+    query.prepare("INSERT OR REPLACE INTO tasks (" TASK_COLUMNS ", position) "
+                  "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+
+    for (int i = 0; i < tasks.size(); ++i)
+    {
+        const Thunder::Task & task = tasks.at(i);
+
+        query.addBindValue(task.taskid());
+        query.addBindValue(QString::fromAscii(task.cid));
+        query.addBindValue((int) task.status);
+        query.addBindValue((qlonglong) task.size);
+        query.addBindValue((int) task.type);
+        query.addBindValue(task.name);
+        query.addBindValue(QString::fromUtf8(task.link));
+        query.addBindValue(QString::fromUtf8(task.source));
+        query.addBindValue((int) task.progress);
+        query.addBindValue(i);
+
+        exec (query);
+    }
+
+    query.exec("DELETE FROM bt_subtasks WHERE taskid NOT IN (SELECT id FROM tasks)");
+
+    my_db.commit();
+}
+
+Thunder::Task TaskCache::findTaskById(const QString &id)
+{
+    Thunder::Task task;
+    if (! isOpen()) return task;
+
+    QSqlQuery query (my_db);
+    query.prepare("SELECT " TASK_COLUMNS " FROM tasks WHERE id = ?");
+    query.addBindValue(id);
+
+    if (exec (query) && query.next())
+        task = taskFromQuery(query);
+
+    return task;
+}
+
+Thunder::Task TaskCache::findTaskByCid(const QString &cid)
+{
+    Thunder::Task task;
+    if (! isOpen()) return task;
+
+    QSqlQuery query (my_db);
+    query.prepare("SELECT " TASK_COLUMNS " FROM tasks WHERE cid = ?");
+    query.addBindValue(cid);
+
+    if (exec (query) && query.next())
+        task = taskFromQuery(query);
+
+    return task;
+}
+
+QList<Thunder::BTSubTask> TaskCache::loadBTSubTasks(const QString &taskid)
+{
+    QList<Thunder::BTSubTask> subtasks;
+    if (! isOpen()) return subtasks;
+
+    QSqlQuery query (my_db);
+    query.prepare("SELECT id, name, size, format_size, link, findex FROM bt_subtasks "
+                  "WHERE taskid = ? ORDER BY position");
+    query.addBindValue(taskid);
+    if (! exec (query)) return subtasks;
+
+    while (query.next())
+    {
+        Thunder::BTSubTask subtask;
+        subtask.id          = query.value(0).toString();
+        subtask.name        = query.value(1).toString();
+        subtask.size        = query.value(2).toString();
+        subtask.format_size = query.value(3).toString();
+        subtask.link        = query.value(4).toString();
+        subtask.findex      = query.value(5).toString();
+
+        subtasks.append(subtask);
+    }
+
+    return subtasks;
+}
+
+void TaskCache::storeBTSubTasks(const QString &taskid,
+                                const QList<Thunder::BTSubTask> &subtasks,
+                                bool replace)
+{
+    if (! isOpen()) return;
+
+    my_db.transaction();
+
+    QSqlQuery query (my_db);
+    int position = 0;
+
+    if (replace)
+    {
+        query.prepare("DELETE FROM bt_subtasks WHERE taskid = ?");
+        query.addBindValue(taskid);
+        exec (query);
+    }
+    else
+    {
+        query.prepare("SELECT COUNT(*) FROM bt_subtasks WHERE taskid = ?");
+        query.addBindValue(taskid);
+        if (exec (query) && query.next())
+            position = query.value(0).toInt();
+    }
+
+    query.prepare("INSERT INTO bt_subtasks "
+                  "(taskid, position, id, name, size, format_size, link, findex) "
+                  "VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+
+    foreach (const Thunder::BTSubTask & subtask, subtasks)
+    {
+        query.addBindValue(taskid);
+        query.addBindValue(position ++);
+        query.addBindValue(subtask.id);
+        query.addBindValue(subtask.name);
+        query.addBindValue(subtask.size);
+        query.addBindValue(subtask.format_size);
+        query.addBindValue(subtask.link);
+        query.addBindValue(subtask.findex);
+
+        exec (query);
+    }
+
+    my_db.commit();
+}
+
+QString TaskCache::sessionValue(const QString &key)
+{
+    if (! isOpen()) return QString();
+
+    QSqlQuery query (my_db);
+    query.prepare("SELECT value FROM session WHERE key = ?");
+    query.addBindValue(key);
+
+    if (exec (query) && query.next())
+        return query.value(0).toString();
+
+    return QString();
+}
+
+void TaskCache::setSessionValue(const QString &key, const QString &value)
+{
+    if (! isOpen()) return;
+
+    QSqlQuery query (my_db);
+    query.prepare("INSERT OR REPLACE INTO session (key, value) VALUES (?, ?)");
+    query.addBindValue(key);
+    query.addBindValue(value);
+
+    exec (query);
+}
@@ -0,0 +1,89 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TASKCACHE_H
+#define TASKCACHE_H
+
+#include <QObject>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QStringList>
+#include <QDesktopServices>
+#include <QFile>
+#include <QDebug>
+
+#include "CloudObject.h"
+#include "util.h"
+
+/*!
+ * \brief Local SQLite copy of the last known cloud task list,
+ *        so the UI has something to show before login completes
+ */
+class TaskCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TaskCache(QObject *parent = 0);
+    ~TaskCache();
+
+    /*!
+     * \brief Open (or create) the cache of an account
+     * \param user name, each account has its own database
+     * \return
+     */
+    bool open (const QString & user);
+    void close ();
+    bool isOpen ();
+
+    QList<Thunder::Task> loadTasks ();
+
+    /*!
+     * \brief Replace cached task list, sub tasks of vanished BT tasks are dropped
+     * \param tasks
+     */
+    void storeTasks (const QList<Thunder::Task> & tasks);
+
+    Thunder::Task findTaskById (const QString & id);
+    Thunder::Task findTaskByCid (const QString & cid);
+
+    QList<Thunder::BTSubTask> loadBTSubTasks (const QString & taskid);
+
+    /*!
+     * \brief Store sub tasks of a BT task
+     * \param taskid
+     * \param subtasks
+     * \param drop previously cached sub tasks (i.e first page)
+     */
+    void storeBTSubTasks (const QString & taskid,
+                          const QList<Thunder::BTSubTask> & subtasks,
+                          bool replace);
+
+    QString sessionValue (const QString & key);
+    void setSessionValue (const QString & key, const QString & value);
+
+private:
+    QSqlDatabase my_db;
+    QString my_connectionName;
+
+    bool exec (QSqlQuery & query);
+    Thunder::Task taskFromQuery (const QSqlQuery & query);
+};
+
+#endif // TASKCACHE_H
@@ -0,0 +1,147 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "taskstore.h"
+
+TaskStore::TaskStore(QObject *parent) :
+    QObject(parent),
+    my_byType(Thunder::Garbage + 1)
+{
+}
+
+int TaskStore::indexOf(quint64 id) const
+{
+    return my_byId.value(id, -1);
+}
+
+const Thunder::Task *TaskStore::taskAt(int row) const
+{
+    return row < 0 ? 0 : &my_tasks.at(row);
+}
+
+const Thunder::Task *TaskStore::findById(quint64 id) const
+{
+    return taskAt(my_byId.value(id, -1));
+}
+
+const Thunder::Task *TaskStore::findByCid(const QByteArray &cid) const
+{
+    return taskAt(my_byCid.value(cid, -1));
+}
+
+const Thunder::Task *TaskStore::findBySource(const QByteArray &source) const
+{
+    return taskAt(my_bySource.value(source, -1));
+}
+
+const QList<int> &TaskStore::rowsOfType(Thunder::TaskType type) const
+{
+    if (type < 0 || type >= my_byType.size())
+        return my_noRows;
+
+    return my_byType.at(type);
+}
+
+const QList<int> &TaskStore::rowsWithStatus(int status) const
+{
+    QHash<int, QList<int> >::const_iterator it = my_byStatus.constFind(status);
+    return it == my_byStatus.constEnd() ? my_noRows : it.value();
+}
+
+void TaskStore::setTasks(const QList<Thunder::Task> &tasks)
+{
+    my_tasks = tasks;
+    rebuildIndexes();
+
+    emit tasksReset();
+}
+
+bool TaskStore::update(const Thunder::Task &task)
+{
+    const int row = indexOf(task.id);
+    if (row < 0)
+        return false;
+
+    Thunder::Task & old = my_tasks[row];
+
+    /// Only status moves rows between views, the rest is fixed per task
+    if (old.status != task.status)
+    {
+        my_byStatus[old.status].removeOne(row);
+
+        QList<int> & rows = my_byStatus[task.status];
+        rows.insert(qLowerBound(rows.begin(), rows.end(), row) - rows.begin(), row);
+    }
+
+    old = task;
+    emit taskChanged(old);
+
+    return true;
+}
+
+void TaskStore::remove(const QList<quint64> &ids)
+{
+    const QSet<quint64> & gone = ids.toSet();
+
+    QList<Thunder::Task> kept;
+    kept.reserve(my_tasks.size());
+
+    foreach (const Thunder::Task & task, my_tasks)
+    {
+        if (! gone.contains(task.id))
+            kept.append(task);
+    }
+
+    if (kept.size() == my_tasks.size())
+        return;
+
+    my_tasks = kept;
+    rebuildIndexes();
+
+    emit tasksRemoved(ids);
+}
+
+void TaskStore::rebuildIndexes()
+{
+    my_byId.clear();
+    my_byCid.clear();
+    my_bySource.clear();
+    my_byStatus.clear();
+
+    for (int i = 0; i < my_byType.size(); ++i)
+        my_byType[i].clear();
+
+    my_byId.reserve(my_tasks.size());
+
+    for (int row = 0; row < my_tasks.size(); ++row)
+    {
+        const Thunder::Task & task = my_tasks.at(row);
+
+        my_byId.insert(task.id, row);
+
+        /// First one wins, the list is sorted by newest task
+        if (! task.cid.isEmpty() && ! my_byCid.contains(task.cid))
+            my_byCid.insert(task.cid, row);
+        if (! task.source.isEmpty() && ! my_bySource.contains(task.source))
+            my_bySource.insert(task.source, row);
+
+        if ((int) task.type < my_byType.size())
+            my_byType[task.type].append(row);
+        my_byStatus[task.status].append(row);
+    }
+}
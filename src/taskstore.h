@@ -0,0 +1,105 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TASKSTORE_H
+#define TASKSTORE_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QVector>
+#include <QSet>
+#include <QtAlgorithms>
+
+#include "CloudObject.h"
+#include "util.h"
+
+/*!
+ * \brief Cloud task list with lookups by id, cid and source address,
+ *        plus rows grouped by type and by status.
+ *
+ *        Tasks are handed out by const reference, indexes are kept in
+ *        step with every change.
+ */
+class TaskStore : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TaskStore(QObject *parent = 0);
+
+    const QList<Thunder::Task> & tasks () const { return my_tasks; }
+    const Thunder::Task & at (int row) const { return my_tasks.at(row); }
+    int size () const { return my_tasks.size(); }
+    bool isEmpty () const { return my_tasks.isEmpty(); }
+
+    /*!
+     * \brief Row of a task
+     * \param id
+     * \return -1 if unknown
+     */
+    int indexOf (quint64 id) const;
+
+    /*!
+     * \brief Lookups, 0 if nothing matches
+     */
+    const Thunder::Task *findById (quint64 id) const;
+    const Thunder::Task *findByCid (const QByteArray & cid) const;
+    const Thunder::Task *findBySource (const QByteArray & source) const;
+
+    /*!
+     * \brief Rows of a type or status, ascending
+     */
+    const QList<int> & rowsOfType (Thunder::TaskType type) const;
+    const QList<int> & rowsWithStatus (int status) const;
+
+    /*!
+     * \brief Replace the whole list
+     * \param tasks
+     */
+    void setTasks (const QList<Thunder::Task> & tasks);
+
+    /*!
+     * \brief Replace a task with the same id in place
+     * \param task
+     * \return false if unknown
+     */
+    bool update (const Thunder::Task & task);
+
+    void remove (const QList<quint64> & ids);
+
+signals:
+    void tasksReset ();
+    void taskChanged (const Thunder::Task & task);
+    void tasksRemoved (const QList<quint64> & ids);
+
+private:
+    QList<Thunder::Task> my_tasks;
+
+    QHash<quint64, int> my_byId;
+    QHash<QByteArray, int> my_byCid, my_bySource;
+    QVector<QList<int> > my_byType;
+    QHash<int, QList<int> > my_byStatus;
+
+    QList<int> my_noRows;
+
+    void rebuildIndexes ();
+    const Thunder::Task *taskAt (int row) const;
+};
+
+#endif // TASKSTORE_H
@@ -0,0 +1,558 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tasktreemodel.h"
+
+#include <QSet>
+#include <algorithm>
+
+// Background of tasks not finished on the cloud yet
+#define UNFINISHED_COLOR "#9CC6EE"
+
+// more scattered removals than this are done as one model reset
+#define REMOVED_RANGES_MAX 16
+
+namespace {
+
+/*!
+ * Order of store rows by the precomputed key of a column
+ */
+struct SortKeyLessThan
+{
+    const TaskStore *store;
+    const QVector<QString> *names;
+    int column;
+    bool descending;
+
+    bool operator() (int a, int b) const
+    {
+        if (descending)
+            qSwap (a, b);
+
+        switch (column)
+        {
+        case 0:
+            return store->at(a).size < store->at(b).size;
+        case 1:
+            return names->at(a) < names->at(b);
+        default:
+            return a < b;
+        }
+    }
+};
+
+}
+
+TaskTreeModel::TaskTreeModel(QObject *parent) :
+    QAbstractItemModel(parent),
+    my_store (0),
+    my_rowOfTaskDirty (false),
+    my_sortColumn (-1),
+    my_sortOrder (Qt::AscendingOrder)
+{
+}
+
+void TaskTreeModel::setTaskStore(const TaskStore *store)
+{
+    if (my_store)
+        disconnect (my_store, 0, this, 0);
+
+    my_store = store;
+
+    connect (my_store, SIGNAL(tasksReset()), SLOT(slotTasksReset()));
+    connect (my_store, SIGNAL(taskChanged(Thunder::Task)), SLOT(slotTaskChanged(Thunder::Task)));
+    connect (my_store, SIGNAL(tasksRemoved(QList<quint64>)), SLOT(slotTasksRemoved(QList<quint64>)));
+
+    slotTasksReset();
+}
+
+const Thunder::Task *TaskTreeModel::taskAt(int row) const
+{
+    if (! my_store || row < 0 || row >= my_rows.size())
+        return 0;
+
+    return my_store->findById(my_rows.at(row));
+}
+
+int TaskTreeModel::rowOfTask(quint64 id) const
+{
+    if (my_rowOfTaskDirty)
+    {
+        my_rowOfTask.clear();
+        my_rowOfTask.reserve(my_rows.size());
+
+        for (int row = 0; row < my_rows.size(); ++row)
+            my_rowOfTask.insert(my_rows.at(row), row);
+
+        my_rowOfTaskDirty = false;
+    }
+
+    return my_rowOfTask.value(id, -1);
+}
+
+int TaskTreeModel::folderOf(quint64 id) const
+{
+    QHash<quint64, int>::const_iterator it = my_folderOfTask.constFind(id);
+    if (it != my_folderOfTask.constEnd())
+        return it.value();
+
+    if (! my_freeFolders.isEmpty())
+    {
+        const int slot = my_freeFolders.last();
+        my_freeFolders.pop_back();
+
+        my_folders[slot].id = id;
+        my_folderOfTask.insert(id, slot);
+
+        return slot;
+    }
+
+    Folder folder;
+    folder.id       = id;
+    folder.complete = false;
+
+    my_folders.append(folder);
+    my_folderOfTask.insert(id, my_folders.size() - 1);
+
+    return my_folders.size() - 1;
+}
+
+const TaskTreeModel::Folder *TaskTreeModel::findFolder(quint64 id) const
+{
+    QHash<quint64, int>::const_iterator it = my_folderOfTask.constFind(id);
+    return it == my_folderOfTask.constEnd() ? 0 : &my_folders.at(it.value());
+}
+
+QModelIndex TaskTreeModel::indexOfTask(quint64 id, int column) const
+{
+    const int row = rowOfTask(id);
+    return row < 0 ? QModelIndex () : createIndex(row, column, quint32 (0));
+}
+
+int TaskTreeModel::setSubtasks(quint64 id, bool replace,
+                               const QList<Thunder::BTSubTask> &subtasks, bool complete)
+{
+    const QModelIndex & parent = indexOfTask(id);
+    if (! parent.isValid())
+        return -1;
+
+    /// Views may add folders while rows change, keep the slot, not a reference
+    const int slot = folderOf(id);
+
+    if (replace && ! my_folders.at(slot).subtasks.isEmpty())
+    {
+        beginRemoveRows(parent, 0, my_folders.at(slot).subtasks.size() - 1);
+        my_folders[slot].subtasks.clear();
+        endRemoveRows();
+    }
+
+    const int first = my_folders.at(slot).subtasks.size();
+
+    if (complete && ! my_folders.at(slot).complete)
+    {
+        beginRemoveRows(parent, first, first);
+        my_folders[slot].complete = true;
+        endRemoveRows();
+    }
+
+    if (! subtasks.isEmpty())
+    {
+        beginInsertRows(parent, first, first + subtasks.size() - 1);
+        my_folders[slot].subtasks += subtasks;
+        endInsertRows();
+
+        /// The placeholder counts the rows so far
+        if (! my_folders.at(slot).complete)
+        {
+            const QModelIndex & placeholder = index(my_folders.at(slot).subtasks.size(), 1, parent);
+            emit dataChanged(placeholder, placeholder);
+        }
+    }
+
+    if (! complete && my_folders.at(slot).complete)
+    {
+        const int placeholder = my_folders.at(slot).subtasks.size();
+
+        beginInsertRows(parent, placeholder, placeholder);
+        my_folders[slot].complete = false;
+        endInsertRows();
+    }
+
+    return first;
+}
+
+QList<Thunder::BTSubTask> TaskTreeModel::subtasks(const QModelIndex &folder) const
+{
+    if (! folder.isValid() || folder.internalId() != 0)
+        return QList<Thunder::BTSubTask> ();
+
+    const Thunder::Task *task = taskAt(folder.row());
+    const Folder *found = task ? findFolder(task->id) : 0;
+
+    return found ? found->subtasks : QList<Thunder::BTSubTask> ();
+}
+
+bool TaskTreeModel::isLoading(const QModelIndex &folder) const
+{
+    if (! folder.isValid() || folder.internalId() != 0)
+        return false;
+
+    const Thunder::Task *task = taskAt(folder.row());
+    if (! task || task->type != Thunder::BT)
+        return false;
+
+    const Folder *found = findFolder(task->id);
+    return ! found || ! found->complete;
+}
+
+QModelIndex TaskTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (! hasIndex(row, column, parent))
+        return QModelIndex ();
+
+    if (! parent.isValid())
+        return createIndex(row, column, quint32 (0));
+
+    const Thunder::Task *task = taskAt(parent.row());
+    if (! task)
+        return QModelIndex ();
+
+    return createIndex(row, column, quint32 (folderOf(task->id) + 1));
+}
+
+QModelIndex TaskTreeModel::parent(const QModelIndex &child) const
+{
+    if (! child.isValid() || child.internalId() == 0)
+        return QModelIndex ();
+
+    return indexOfTask(my_folders.at(child.internalId() - 1).id);
+}
+
+int TaskTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if (! parent.isValid())
+        return my_rows.size();
+
+    if (parent.internalId() != 0 || parent.column() != 0)
+        return 0;
+
+    const Thunder::Task *task = taskAt(parent.row());
+    if (! task || task->type != Thunder::BT)
+        return 0;
+
+    /// Until complete, the last row says "Loading .."
+    const Folder *folder = findFolder(task->id);
+    if (! folder)
+        return 1;
+
+    return folder->subtasks.size() + (folder->complete ? 0 : 1);
+}
+
+int TaskTreeModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return 2;
+}
+
+QVariant TaskTreeModel::data(const QModelIndex &index, int role) const
+{
+    if (! index.isValid())
+        return QVariant ();
+
+    if (role == Qt::TextAlignmentRole)
+        return (int) Qt::AlignCenter;
+
+    if (index.internalId() == 0)
+    {
+        const Thunder::Task *task = taskAt(index.row());
+        if (! task)
+            return QVariant ();
+
+        if (index.column() == 0)
+        {
+            switch (role)
+            {
+            case Qt::DisplayRole:
+                return Util::toReadableSize(task->size);
+            case Qt::DecorationRole:
+                return Util::getFileIcon(task->name, task->type == Thunder::BT);
+            case DownloadRole:
+                return QString::fromUtf8(task->link);
+            case SourceRole:
+                return QString::fromUtf8(task->source);
+            case TaskIdRole:
+                return task->taskid();
+            case TypeRole:
+                return (int) task->type;
+            case CidRole:
+                return QString::fromAscii(task->cid);
+            }
+
+            return QVariant ();
+        }
+
+        const bool unfinished = task->link.isEmpty() && task->type != Thunder::BT;
+
+        switch (role)
+        {
+        case Qt::DisplayRole:
+            return task->name;
+        case Qt::BackgroundRole:
+            return unfinished ? QBrush (QColor (UNFINISHED_COLOR)) : QVariant ();
+        case Qt::ToolTipRole:
+            return unfinished ? QString ("Progress: %1%").arg((int) task->progress) : QVariant ();
+        }
+
+        return QVariant ();
+    }
+
+    const Folder & folder = my_folders.at(index.internalId() - 1);
+
+    if (index.row() >= folder.subtasks.size())
+    {
+        if (index.column() == 0 && role == PlaceholderRole)
+            return true;
+        if (index.column() == 1 && role == Qt::DisplayRole)
+            return folder.subtasks.isEmpty()
+                    ? tr("Loading ..")
+                    : tr("Loading .. %1 file(s) so far").arg(folder.subtasks.size());
+
+        return QVariant ();
+    }
+
+    const Thunder::BTSubTask & subtask = folder.subtasks.at(index.row());
+
+    if (index.column() == 0)
+    {
+        switch (role)
+        {
+        case Qt::DisplayRole:
+            return subtask.size;
+        case Qt::DecorationRole:
+            return Util::getFileIcon(subtask.name);
+        case DownloadRole:
+            return subtask.link;
+        }
+
+        return QVariant ();
+    }
+
+    switch (role)
+    {
+    case Qt::DisplayRole:
+        return subtask.name;
+    case Qt::BackgroundRole:
+        return subtask.link.isEmpty() ? QBrush (QColor (UNFINISHED_COLOR)) : QVariant ();
+    }
+
+    return QVariant ();
+}
+
+QVariant TaskTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant ();
+
+    switch (section)
+    {
+    case 0:
+        return tr("Size");
+    case 1:
+        return tr("Name");
+    }
+
+    return QVariant ();
+}
+
+bool TaskTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    return isLoading(parent);
+}
+
+void TaskTreeModel::fetchMore(const QModelIndex &parent)
+{
+    emit fetchRequested(parent.sibling(parent.row(), 0));
+}
+
+void TaskTreeModel::sortRows(QVector<quint64> &rows)
+{
+    if (! my_store)
+        return;
+
+    if (my_sortColumn == 1 && my_nameKeys.size() != my_store->size())
+    {
+        my_nameKeys.resize(my_store->size());
+        for (int i = 0; i < my_store->size(); ++i)
+            my_nameKeys[i] = my_store->at(i).name.toCaseFolded();
+    }
+
+    QVector<int> storeRows;
+    storeRows.reserve(rows.size());
+
+    foreach (const quint64 & id, rows)
+        storeRows.append(my_store->indexOf(id));
+
+    SortKeyLessThan lessThan;
+    lessThan.store      = my_store;
+    lessThan.names      = &my_nameKeys;
+    lessThan.column     = my_sortColumn;
+    lessThan.descending = my_sortColumn >= 0 && my_sortOrder == Qt::DescendingOrder;
+
+    std::stable_sort (storeRows.begin(), storeRows.end(), lessThan);
+
+    for (int i = 0; i < storeRows.size(); ++i)
+        rows[i] = my_store->at(storeRows.at(i)).id;
+}
+
+void TaskTreeModel::sort(int column, Qt::SortOrder order)
+{
+    my_sortColumn = column;
+    my_sortOrder  = order;
+
+    emit layoutAboutToBeChanged();
+
+    const QVector<quint64> before = my_rows;
+    sortRows(my_rows);
+    my_rowOfTaskDirty = true;
+
+    /// Sub tasks keep their rows, only folders move
+    const QModelIndexList & from = persistentIndexList();
+    QModelIndexList to;
+
+    foreach (const QModelIndex & index, from)
+    {
+        if (index.internalId() == 0)
+            to.append(indexOfTask(before.at(index.row()), index.column()));
+        else
+            to.append(index);
+    }
+
+    changePersistentIndexList(from, to);
+
+    emit layoutChanged();
+}
+
+void TaskTreeModel::slotTasksReset()
+{
+    beginResetModel();
+
+    my_folders.clear();
+    my_folderOfTask.clear();
+    my_freeFolders.clear();
+    my_nameKeys.clear();
+
+    my_rows.resize(my_store->size());
+    for (int i = 0; i < my_rows.size(); ++i)
+        my_rows[i] = my_store->at(i).id;
+
+    if (my_sortColumn >= 0)
+        sortRows(my_rows);
+
+    my_rowOfTaskDirty = true;
+
+    endResetModel();
+}
+
+void TaskTreeModel::slotTaskChanged(const Thunder::Task &task)
+{
+    const int row = rowOfTask(task.id);
+    if (row < 0)
+        return;
+
+    emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+}
+
+void TaskTreeModel::slotTasksRemoved(const QList<quint64> &ids)
+{
+    const QSet<quint64> & gone = ids.toSet();
+
+    /// Rows of the store moved
+    my_nameKeys.clear();
+
+    /// Contiguous ranges of rows to remove, bottom up
+    QList<QPair<int, int> > ranges;
+    for (int row = my_rows.size() - 1; row >= 0; --row)
+    {
+        if (! gone.contains(my_rows.at(row)))
+            continue;
+
+        const int last = row;
+        while (row > 0 && gone.contains(my_rows.at(row - 1)))
+            -- row;
+
+        ranges.append(qMakePair (row, last));
+    }
+
+    if (ranges.isEmpty())
+        return;
+
+    /// Scattered removals are one reset, instead of a signal per range
+    const bool reset = ranges.size() > REMOVED_RANGES_MAX;
+
+    if (! reset)
+    {
+        /// A removed range doesn't move the ranges still to remove
+        for (int i = 0; i < ranges.size(); ++i)
+        {
+            beginRemoveRows(QModelIndex (), ranges.at(i).first, ranges.at(i).second);
+            my_rows.remove(ranges.at(i).first, ranges.at(i).second - ranges.at(i).first + 1);
+            my_rowOfTaskDirty = true;
+            endRemoveRows();
+        }
+    }
+    else
+    {
+        beginResetModel();
+
+        QVector<quint64> kept;
+        kept.reserve(my_rows.size());
+        foreach (const quint64 & id, my_rows)
+        {
+            if (! gone.contains(id))
+                kept.append(id);
+        }
+
+        my_rows = kept;
+        my_rowOfTaskDirty = true;
+
+        /// Views fetch sub tasks again after a reset, as in slotTasksReset()
+        my_folders.clear();
+        my_folderOfTask.clear();
+        my_freeFolders.clear();
+    }
+
+    /// Children of the removed rows are gone with them, their slots are
+    /// handed out again by folderOf()
+    foreach (const quint64 & id, ids)
+    {
+        QHash<quint64, int>::iterator it = my_folderOfTask.find(id);
+        if (it == my_folderOfTask.end())
+            continue;
+
+        Folder & folder = my_folders[it.value()];
+        folder.id       = 0;
+        folder.complete = false;
+        folder.subtasks.clear();
+
+        my_freeFolders.append(it.value());
+        my_folderOfTask.erase(it);
+    }
+
+    if (reset)
+        endResetModel();
+}
@@ -0,0 +1,155 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TASKTREEMODEL_H
+#define TASKTREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QVector>
+#include <QHash>
+#include <QBrush>
+#include <QColor>
+
+#include "CloudObject.h"
+#include "taskstore.h"
+#include "util.h"
+
+/*!
+ * \brief Cloud tasks of a TaskStore as a tree, BT folders hold their sub tasks
+ *
+ *        Nothing is stored per cell, display data is computed when asked for.
+ *        A BT folder that is not complete ends with a "Loading .." row, and
+ *        asks for its sub tasks through fetchMore().
+ */
+class TaskTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    enum Role
+    {
+        DownloadRole    = Qt::UserRole + 1,
+        SourceRole      = Qt::UserRole + 2,
+        TaskIdRole      = Qt::UserRole + 3,
+        TypeRole        = Qt::UserRole + 4,
+        CidRole         = Qt::UserRole + 5,
+        PlaceholderRole = Qt::UserRole + 6
+    };
+
+    explicit TaskTreeModel (QObject *parent = 0);
+
+    void setTaskStore (const TaskStore *store);
+
+    /*!
+     * \brief Top level row of a task
+     * \param id
+     * \return invalid if unknown
+     */
+    QModelIndex indexOfTask (quint64 id, int column = 0) const;
+
+    /*!
+     * \brief Show a page of sub tasks
+     * \param id
+     * \param replace Drop the rows shown before
+     * \param subtasks
+     * \param complete No more pages to come
+     * \return row of the first new sub task, -1 if the task is unknown
+     */
+    int setSubtasks (quint64 id, bool replace,
+                     const QList<Thunder::BTSubTask> & subtasks, bool complete);
+    QList<Thunder::BTSubTask> subtasks (const QModelIndex & folder) const;
+
+    /*!
+     * \brief A BT folder whose sub tasks are not all there
+     */
+    bool isLoading (const QModelIndex & folder) const;
+
+    QModelIndex index (int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    QModelIndex parent (const QModelIndex &child) const;
+    int rowCount (const QModelIndex &parent = QModelIndex()) const;
+    int columnCount (const QModelIndex &parent = QModelIndex()) const;
+    QVariant data (const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData (int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+    bool canFetchMore (const QModelIndex &parent) const;
+    void fetchMore (const QModelIndex &parent);
+
+    /*!
+     * \brief Sort top level rows, column -1 restores the order of the store
+     */
+    void sort (int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+signals:
+    /*!
+     * \brief An expanded BT folder wants its sub tasks
+     */
+    void fetchRequested (const QModelIndex & folder);
+
+private slots:
+    void slotTasksReset ();
+    void slotTaskChanged (const Thunder::Task & task);
+    void slotTasksRemoved (const QList<quint64> & ids);
+
+private:
+    struct Folder
+    {
+        quint64 id;
+        QList<Thunder::BTSubTask> subtasks;
+        bool complete;
+    };
+
+    const TaskStore *my_store;
+
+    /*!
+     * \brief Task id of each top level row, in display order
+     */
+    QVector<quint64> my_rows;
+
+    /*!
+     * \brief Reverse of my_rows, rebuilt when needed
+     */
+    mutable QHash<quint64, int> my_rowOfTask;
+    mutable bool my_rowOfTaskDirty;
+
+    /*!
+     * \brief Sub tasks, children point to their folder by internalId() - 1
+     */
+    mutable QVector<Folder> my_folders;
+    mutable QHash<quint64, int> my_folderOfTask;
+
+    /*!
+     * \brief Slots of my_folders left by removed tasks
+     */
+    mutable QVector<int> my_freeFolders;
+
+    /*!
+     * \brief Case folded names by row of the store, the sort key of column 1
+     */
+    QVector<QString> my_nameKeys;
+
+    int my_sortColumn;
+    Qt::SortOrder my_sortOrder;
+
+    const Thunder::Task *taskAt (int row) const;
+    int rowOfTask (quint64 id) const;
+    int folderOf (quint64 id) const;
+    const Folder *findFolder (quint64 id) const;
+
+    void sortRows (QVector<quint64> & rows);
+};
+
+#endif // TASKTREEMODEL_H
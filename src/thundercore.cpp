@@ -17,19 +17,119 @@
  */
 
 #include "thundercore.h"
+#include "functionfields.h"
 #define TASKS_PER_PAGE 30
 
+// seconds before a fetched BT folder is asked for again
+#define BT_FOLDER_EXPIRY 300
+
+// msecs to wait for further input / commits
+#define QUERY_DEBOUNCE 400
+#define RELOAD_DEBOUNCE 500
+
+// msecs between progress polls, backing off up to the maximum
+#define PROGRESS_POLL_MIN 5000
+#define PROGRESS_POLL_MAX 120000
+
+// secs ahead of expiry a task is renewed, and between failed attempts
+#define RENEW_AHEAD (24 * 3600)
+#define RENEW_RETRY 600
+
+// task ids per task_delay request
+#define RENEW_BATCH_SIZE 30
+
+// URLs per batch_task_check / batch_task_commit, unless General/BatchChunkSize is set
+#define BATCH_CHUNK_SIZE 100
+
+// batch chunks in flight at once, and attempts of a failing chunk
+#define BATCH_CONCURRENCY 2
+#define BATCH_ATTEMPTS 3
+
+// torrents of uploadBitorrents() / magnets of addMagnetTasks() in flight at once
+#define TORRENT_CONCURRENCY 2
+
+#define ATTR_REQUEST_KIND  ((QNetworkRequest::Attribute) (QNetworkRequest::User + 1))
+#define ATTR_REQUEST_START ((QNetworkRequest::Attribute) (QNetworkRequest::User + 2))
+
 ThunderCore::ThunderCore(QObject *parent) :
     QObject(parent),
+    tc_tasks (new TaskStore (this)),
+    tc_tasksFromCache (false),
+    tc_cache (new TaskCache (this)),
     tmp_cookieIsStored (false),
-    tc_nam (new QNetworkAccessManager (this))
+    tc_loginStatus (Failed),
+    tc_resumingSession (false),
+    tc_nam (createNetworkManager()),
+    tc_recorder (0),
+    tc_loginStarted (0),
+    tc_loginDuration (0),
+    tc_scheduler (new RequestScheduler (tc_nam, this)),
+    tc_batchChunkSize (BATCH_CHUNK_SIZE),
+    tc_requestStats (RequestKindCount)
 {
     connect (tc_nam, SIGNAL(finished(QNetworkReply*)),
              SLOT(slotFinished(QNetworkReply*)));
+    connect (tc_scheduler, SIGNAL(cancelled(int,QNetworkRequest)),
+             SLOT(slotRequestCancelled(int,QNetworkRequest)));
+    connect (tc_tasks, SIGNAL(taskChanged(Thunder::Task)),
+             SIGNAL(CloudTaskUpdated(Thunder::Task)));
+
+    /// fill_bt_list pages of all BT folders share the prefetch lane
+    tc_scheduler->setLaneLimit(RequestScheduler::Interactive, 4);
+    tc_scheduler->setLaneLimit(RequestScheduler::Refresh, 2);
+    tc_scheduler->setLaneLimit(RequestScheduler::Prefetch, 4);
+    tc_scheduler->setLaneLimit(RequestScheduler::Housekeeping, 1);
+    tc_scheduler->setRateLimit(10);
+
+    /// Query style calls fire once input settles
+    tc_taskCheckTimer.setSingleShot(true);
+    tc_taskCheckTimer.setInterval(QUERY_DEBOUNCE);
+    connect (&tc_taskCheckTimer, SIGNAL(timeout()), SLOT(slotQueryTaskCheck()));
+
+    tc_urlQueryTimer.setSingleShot(true);
+    tc_urlQueryTimer.setInterval(QUERY_DEBOUNCE);
+    connect (&tc_urlQueryTimer, SIGNAL(timeout()), SLOT(slotQueryMagnet()));
+
+    /// Several commits in a row trigger a single refresh
+    tc_reloadTimer.setSingleShot(true);
+    tc_reloadTimer.setInterval(RELOAD_DEBOUNCE);
+    connect (&tc_reloadTimer, SIGNAL(timeout()), SLOT(slotReloadCloudTasks()));
+
+    tc_progressInterval = PROGRESS_POLL_MIN;
+    tc_progressTimer.setSingleShot(true);
+    connect (&tc_progressTimer, SIGNAL(timeout()), SLOT(slotPollProgress()));
+
+    tc_renewTimer.setSingleShot(true);
+    connect (&tc_renewTimer, SIGNAL(timeout()), SLOT(slotRenewTasks()));
+
+    const QStringList & args = QCoreApplication::arguments();
+    const int record = args.indexOf("--record-traffic");
+    if (record > 0 && record + 1 < args.size())
+    {
+        tc_recorder = new TrafficRecorder (this);
+        if (! tc_recorder->open(args.at(record + 1)))
+            qWarning() << "Cannot record traffic to" << args.at(record + 1);
+    }
 
     loadSettings();
 }
 
+QNetworkAccessManager *ThunderCore::createNetworkManager()
+{
+    const QStringList & args = QCoreApplication::arguments();
+    const int replay = args.indexOf("--replay-traffic");
+    if (replay <= 0 || replay + 1 >= args.size())
+        return new QNetworkAccessManager (this);
+
+    ReplayNetworkAccessManager *nam = new ReplayNetworkAccessManager (this);
+    nam->setTimed(args.contains("--replay-timed"));
+
+    if (! nam->load(args.at(replay + 1)))
+        qWarning() << "Cannot replay traffic from" << args.at(replay + 1);
+
+    return nam;
+}
+
 void ThunderCore::loadSettings()
 {
     QSettings settings;
@@ -46,11 +146,67 @@ void ThunderCore::loadSettings()
         tc_nam->setProxy(proxy);
     }
 
+    settings.endGroup();
+    settings.beginGroup("Server");
+
+    tc_baseUrl = settings.value("BaseUrl").toUrl();
+    if (tc_baseUrl.isValid())
+        error (tr("Using server %1.").arg(tc_baseUrl.toString()), Info);
+
+    settings.endGroup();
+    settings.beginGroup("General");
+
+    tc_batchChunkSize = qMax (1, settings.value("BatchChunkSize", BATCH_CHUNK_SIZE).toInt());
+    settings.endGroup();
+}
+
+void ThunderCore::loadCachedTasks(const QString &user)
+{
+    /// Re-login of the same account, tasks are on screen already
+    if (tc_cache->isOpen() && user == tc_userName)
+        return;
+
+    if (! tc_cache->open(user))
+        return;
+
+    tc_tasks->setTasks(tc_cache->loadTasks());
+    if (tc_tasks->isEmpty())
+        return;
+
+    tc_tasksFromCache = true;
+    error (tr("%1 cached task(s) loaded.").arg(tc_tasks->size()), Info);
+
+    const QString & gdriveid = tc_cache->sessionValue("gdriveid");
+    if (! gdriveid.isEmpty())
+        emit CookiesReady (gdriveid);
+
+    emit StatusChanged(TaskChanged);
+
+    foreach (int row, tc_tasks->rowsOfType(Thunder::BT))
+    {
+        const Thunder::Task & task = tc_tasks->at(row);
+
+        Thunder::BitorrentTask bt_task;
+        bt_task.taskid   = task.taskid();
+        bt_task.subtasks = tc_cache->loadBTSubTasks(bt_task.taskid);
+        bt_task.page     = 1;
+
+        /// Shown, but fetched again once visible
+        bt_task.complete = false;
+
+        if (! bt_task.subtasks.isEmpty())
+            emit BTSubTaskReady (bt_task);
+    }
+}
+
+const QList<Thunder::Task> &ThunderCore::getCloudTasks()
+{
+    return tc_tasks->tasks();
 }
 
-QList<Thunder::Task> ThunderCore::getCloudTasks()
+const TaskStore *ThunderCore::getTaskStore()
 {
-    return tc_cloudTasks;
+    return tc_tasks;
 }
 
 QList<Thunder::Task> ThunderCore::getGarbagedTasks()
@@ -70,35 +226,233 @@ Thunder::RemoteTask ThunderCore::getSingleRemoteTask()
 
 void ThunderCore::addBatchTaskPre(const QString &urls)
 {
-    post (QUrl("http://dynamic.cloud.vip.xunlei.com/interface/batch_task_check"),
-          "random=123456&url=" + urls.toUtf8().toPercentEncoding());
+    /// A new list replaces the one being checked
+    cancelBatchChunks(BatchTaskCheck);
+    queueBatchChunks(urls.split(QRegExp("[\r\n]+"), QString::SkipEmptyParts), BatchTaskCheck);
 }
 
 void ThunderCore::addBatchTaskPost(const QStringList &urls)
 {
-    QByteArray postData = "cid%5B%5D=&class_id=0&"
-            "batch_old_taskid=0&batch_old_database=0";
+    queueBatchChunks(urls, BatchTaskCommit);
+}
 
-    foreach (const QString & url, urls)
+bool ThunderCore::isBatchCheckPending()
+{
+    foreach (const BatchChunk & chunk, tc_batchQueue)
+    {
+        if (chunk.kind == BatchTaskCheck)
+            return true;
+    }
+
+    foreach (const BatchChunk & chunk, tc_batchInFlight)
+    {
+        if (chunk.kind == BatchTaskCheck)
+            return true;
+    }
+
+    return false;
+}
+
+void ThunderCore::queueBatchChunks(const QStringList &urls, ThunderCore::RequestKind kind)
+{
+    for (int i = 0; i < urls.size(); i += tc_batchChunkSize)
+    {
+        BatchChunk chunk;
+        chunk.kind = kind;
+        chunk.urls = urls.mid(i, tc_batchChunkSize);
+
+        tc_batchQueue.append(chunk);
+    }
+
+    dispatchBatchChunks();
+}
+
+void ThunderCore::dispatchBatchChunks()
+{
+    while (tc_batchInFlight.size() < BATCH_CONCURRENCY && ! tc_batchQueue.isEmpty())
+    {
+        BatchChunk chunk = tc_batchQueue.takeFirst();
+        ++ chunk.attempts;
+
+        int ticket = 0;
+        if (chunk.kind == BatchTaskCheck)
+        {
+            ticket = post (QUrl("http://dynamic.cloud.vip.xunlei.com/interface/batch_task_check"),
+                           "random=123456&url=" + chunk.urls.join("\n").toUtf8().toPercentEncoding(),
+                           BatchTaskCheck);
+        }
+        else
+        {
+            QByteArray postData = "cid%5B%5D=&class_id=0&"
+                    "batch_old_taskid=0&batch_old_database=0";
+
+            foreach (const QString & url, chunk.urls)
+            {
+                postData.append("&url%5B%5D=").append(url.toUtf8().toPercentEncoding());
+            }
+
+            ticket = post (QUrl("http://dynamic.cloud.vip.xunlei.com/interface/"
+                                "batch_task_commit?callback=a"),
+                           postData, BatchTaskCommit);
+        }
+
+        tc_batchInFlight.insert(ticket, chunk);
+    }
+}
+
+void ThunderCore::cancelBatchChunks(ThunderCore::RequestKind kind)
+{
+    for (int i = tc_batchQueue.size() - 1; i >= 0; --i)
+    {
+        if (tc_batchQueue.at(i).kind == kind)
+            tc_batchQueue.removeAt(i);
+    }
+
+    foreach (int ticket, tc_batchInFlight.keys())
     {
-        postData.append("&url%5B%5D=").append(url.toUtf8().toPercentEncoding());
+        if (tc_batchInFlight.value(ticket).kind != kind)
+            continue;
+
+        tc_batchInFlight.remove(ticket);
+        tc_scheduler->cancel(ticket);
+    }
+}
+
+void ThunderCore::retryBatchChunk(int ticket)
+{
+    if (! tc_batchInFlight.contains(ticket))
+        return;
+
+    const BatchChunk chunk = tc_batchInFlight.take(ticket);
+    if (chunk.attempts < BATCH_ATTEMPTS)
+    {
+        /// Ahead of the rest, results stay roughly in order
+        tc_batchQueue.prepend(chunk);
+    }
+    else
+    {
+        error (chunk.kind == BatchTaskCheck
+               ? tr("%1 URL(s) could not be checked, giving up.").arg(chunk.urls.size())
+               : tr("%1 URL(s) could not be added, giving up.").arg(chunk.urls.size()),
+               Warning);
+
+        /// Let the dialog know the check is over
+        if (chunk.kind == BatchTaskCheck && ! isBatchCheckPending())
+        {
+            tmp_batchTasks.clear();
+            emit RemoteTaskChanged(BatchTaskReady);
+        }
     }
 
-    post (QUrl("http://dynamic.cloud.vip.xunlei.com/interface/batch_task_commit?callback=a"),
-          postData);
+    dispatchBatchChunks();
 }
 
 void ThunderCore::delayCloudTask(const QStringList &ids)
 {
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+
     QString id_list;
     foreach (const QString & id, ids)
     {
         id_list.append(id).append("_1,");
+
+        Renewal & renewal = tc_renewals[id];
+        renewal.status    = RenewPending;
+        renewal.attempted = now;
     }
 
     get (QUrl ("http://dynamic.cloud.vip.xunlei.com/interface/task_delay"
                "?taskids=" + id_list +
-               "&interfrom=task&noCacheIE=1362310408959"));
+               "&interfrom=task&noCacheIE=1362310408959"), TaskDelay);
+}
+
+ThunderCore::RenewStatus ThunderCore::getRenewStatus(const QString &taskid)
+{
+    return tc_renewals.value(taskid).status;
+}
+
+qint64 ThunderCore::renewalDueAt(const Thunder::Task &task)
+{
+    if (task.expires == 0)
+        return 0;
+
+    const Renewal & renewal = tc_renewals.value(task.taskid());
+    if (renewal.status == RenewPending)
+        return 0;
+
+    /// A renewal that leaves the task inside the window, failed or not,
+    /// waits like a failed one instead of being due again right away
+    qint64 due = (qint64) task.expires - RENEW_AHEAD;
+    if (renewal.attempted > 0)
+        due = qMax (due, renewal.attempted + RENEW_RETRY);
+
+    return due;
+}
+
+void ThunderCore::scheduleRenewals()
+{
+    qint64 next = 0;
+    foreach (const Thunder::Task & task, tc_tasks->tasks())
+    {
+        const qint64 due = renewalDueAt(task);
+        if (due > 0 && (next == 0 || due < next))
+            next = due;
+    }
+
+    if (next == 0)
+    {
+        tc_renewTimer.stop();
+        return;
+    }
+
+    /// QTimer takes an int, check back daily at most
+    const qint64 wait = next - QDateTime::currentMSecsSinceEpoch() / 1000;
+    tc_renewTimer.start(qBound<qint64> (0, wait, 24 * 3600) * 1000);
+}
+
+void ThunderCore::slotRenewTasks()
+{
+    if (tc_loginStatus != NoError)
+        return;
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    QStringList batch;
+
+    foreach (const Thunder::Task & task, tc_tasks->tasks())
+    {
+        const qint64 due = renewalDueAt(task);
+        if (due <= 0 || due > now)
+            continue;
+
+        batch.append(task.taskid());
+        if (batch.size() == RENEW_BATCH_SIZE)
+        {
+            delayCloudTask(batch);
+            batch.clear();
+        }
+    }
+
+    if (! batch.isEmpty())
+        delayCloudTask(batch);
+
+    scheduleRenewals();
+}
+
+QStringList ThunderCore::trackRenewals(const QUrl &url, ThunderCore::RenewStatus status)
+{
+    QStringList ids;
+
+    /// taskids=id_1,id_1,
+    foreach (const QString & item,
+             url.queryItemValue("taskids").split(",", QString::SkipEmptyParts))
+    {
+        const QString & id = item.section('_', 0, 0);
+
+        tc_renewals[id].status = status;
+        ids.append(id);
+    }
+
+    return ids;
 }
 
 void ThunderCore::cleanupHistory()
@@ -107,7 +461,7 @@ void ThunderCore::cleanupHistory()
               "?tcache=1328430359476&flag=6");
 
     url.addQueryItem("uid", tc_session.value("userid"));
-    get (url);
+    get (url, HistoryClear);
 }
 
 void ThunderCore::fetchHistoryData()
@@ -117,10 +471,16 @@ void ThunderCore::fetchHistoryData()
     url.addQueryItem("cache", QDateTime::currentDateTime()
                      .toString("ddd MMM dd yyyy hh:mm:ss"));
 
-    get (url);
+    get (url, UserHistory);
 }
 
 void ThunderCore::commitBitorrentTask(const QList<Thunder::BTSubTask> &tasks)
+{
+    commitBitorrentTask(tmp_btTask, tasks);
+}
+
+void ThunderCore::commitBitorrentTask(const Thunder::BitorrentTask &bt_task,
+                                      const QList<Thunder::BTSubTask> &tasks)
 {
     QString indices, sizes;
     foreach (const Thunder::BTSubTask & task, tasks)
@@ -135,10 +495,10 @@ void ThunderCore::commitBitorrentTask(const QList<Thunder::BTSubTask> &tasks)
           "goldbean=0&class_id=0&o_taskid=0&o_page=task&silverbean=0"
           "&findex=" + indices.toAscii() +
           "&uid=" + tc_session.value("userid").toAscii() +
-          "&btname=" + tmp_btTask.ftitle.toUtf8().toPercentEncoding() +
-          "&tsize=" + QByteArray::number(tmp_btTask.btsize) +
+          "&btname=" + bt_task.ftitle.toUtf8().toPercentEncoding() +
+          "&tsize=" + QByteArray::number(bt_task.btsize) +
           "&size=" + sizes.toAscii() +
-          "&cid=" + tmp_btTask.infoid.toAscii());
+          "&cid=" + bt_task.infoid.toAscii(), BTTaskCommit);
 }
 
 void ThunderCore::addCloudTaskPost(const Thunder::RemoteTask &task)
@@ -152,7 +512,7 @@ void ThunderCore::addCloudTaskPost(const Thunder::RemoteTask &task)
     url.addQueryItem("t", task.name);
     url.addQueryItem("url", task.url);
 
-    get (url);
+    get (url, TaskCommit);
 }
 
 void ThunderCore::loginWithCapcha(const QByteArray &capcha)
@@ -163,17 +523,80 @@ void ThunderCore::loginWithCapcha(const QByteArray &capcha)
           "login_hour=720&login_enable=0&u=" + tc_userName.toAscii() +
           "&verifycode=" + capcha +
           "&p=" + Util::getEncryptedPassword(
-              tc_passwd, QString::fromAscii(capcha), true).toAscii());
+              tc_passwd, QString::fromAscii(capcha), true).toAscii(), Sec2Login);
 }
 
 void ThunderCore::getContentsOfBTFolder(const Thunder::Task &bt_task, const int & page)
 {
-    get ("http://dynamic.cloud.vip.xunlei.com/interface/fill_bt_list"
-         "?callback=fill_bt_list&g_net=1&noCacheIE=1328405858893&"
-         "&p=" + QString::number(page) +
-         "&infoid=" + bt_task.cid +
-         "&tid=" + bt_task.id +
-         "&uid=" + tc_session.value("userid"));
+    /// Cached tasks are shown before login, nothing to ask for yet
+    if (tc_loginStatus != NoError)
+        return;
+
+    BTFolderEntry & folder = tc_btFolders[bt_task.taskid()];
+    folder.cid = QString::fromAscii(bt_task.cid);
+
+    folder.tickets.append(
+                get ("http://dynamic.cloud.vip.xunlei.com/interface/fill_bt_list"
+                     "?callback=fill_bt_list&g_net=1&noCacheIE=1328405858893&"
+                     "&p=" + QString::number(page) +
+                     "&infoid=" + folder.cid +
+                     "&tid=" + bt_task.taskid() +
+                     "&uid=" + tc_session.value("userid"), BTFolder));
+}
+
+bool ThunderCore::isBTFolderLoading(const QString &taskid)
+{
+    foreach (int ticket, tc_btFolders.value(taskid).tickets)
+    {
+        if (tc_scheduler->isActive(ticket))
+            return true;
+    }
+
+    return false;
+}
+
+void ThunderCore::fetchBTFolder(const QString &taskid, const QString &cid)
+{
+    if (tc_loginStatus != NoError)
+        return;
+
+    if (isBTFolderLoading(taskid))
+        return;
+
+    const BTFolderEntry & folder = tc_btFolders.value(taskid);
+    if (folder.fetched.isValid() &&
+            folder.fetched.secsTo(QDateTime::currentDateTime()) < BT_FOLDER_EXPIRY)
+    {
+        Thunder::BitorrentTask bt_task;
+        bt_task.taskid   = taskid;
+        bt_task.subtasks = folder.subtasks;
+        bt_task.page     = 1;
+        bt_task.complete = true;
+
+        emit BTSubTaskReady (bt_task);
+        return;
+    }
+
+    /// Page 1 tells how many pages follow
+    tc_btFolders.insert(taskid, BTFolderEntry());
+
+    Thunder::Task task;
+    task.id  = taskid.toULongLong();
+    task.cid = cid.toAscii();
+
+    getContentsOfBTFolder(task, 1);
+}
+
+void ThunderCore::cancelBTFolder(const QString &taskid)
+{
+    if (! isBTFolderLoading(taskid))
+        return;
+
+    /// Partial pages are useless, start over next time
+    foreach (int ticket, tc_btFolders.take(taskid).tickets)
+    {
+        tc_scheduler->cancel(ticket);
+    }
 }
 
 void ThunderCore::setCapcha(const QString &code)
@@ -185,7 +608,10 @@ void ThunderCore::reloadCloudTasks(const int page)
 {
     /// Set new timestamp on newly created requests
     if (page == 1)
+    {
+        tc_reloadTimer.stop();
         tc_timeStampForCloudTasks = QDateTime::currentDateTime().toString();
+    }
 
     /// Never play with callback parameter!
     QUrl url = QUrl::fromEncoded("http://dynamic.cloud.vip.xunlei.com/interface/showtask_unfresh?"
@@ -194,479 +620,1039 @@ void ThunderCore::reloadCloudTasks(const int page)
     url.addQueryItem("page", QString::number(page));
     url.addQueryItem("t", tc_timeStampForCloudTasks);
 
-    get (url);
+    /// Pages of an older refresh would be rejected anyway
+    supersede (TaskPage, get (url, TaskPage));
 
     //    fetchHistoryData();
 }
 
+void ThunderCore::scheduleReload()
+{
+    tc_reloadTimer.start();
+}
+
+void ThunderCore::slotReloadCloudTasks()
+{
+    reloadCloudTasks();
+}
+
+void ThunderCore::startProgressPolling()
+{
+    tc_progressInterval = PROGRESS_POLL_MIN;
+    tc_progressTimer.start(tc_progressInterval);
+}
+
+void ThunderCore::slotPollProgress()
+{
+    QStringList ids, nm_ids, bt_ids;
+    foreach (const Thunder::Task & task, tc_tasks->tasks())
+    {
+        if (task.status == 2)
+            continue;
+
+        ids.append(task.taskid());
+        if (task.type == Thunder::BT)
+            bt_ids.append(task.taskid());
+        else
+            nm_ids.append(task.taskid());
+    }
+
+    /// Nothing pending, wait for the next refresh
+    if (ids.isEmpty() || tc_loginStatus != NoError)
+        return;
+
+    /// Keep polling even if this one fails
+    tc_progressTimer.start(tc_progressInterval);
+
+    supersede (TaskProgress,
+               post (QUrl("http://dynamic.cloud.vip.xunlei.com/interface/task_process"
+                          "?callback=tp&t=" + QString::number(QDateTime::currentMSecsSinceEpoch())),
+                     "list=" + ids.join(",").toAscii() +
+                     "&nm_list=" + nm_ids.join(",").toAscii() +
+                     "&bt_list=" + bt_ids.join(",").toAscii() +
+                     "&uid=" + tc_session.value("userid").toAscii() +
+                     "&interfrom=task", TaskProgress));
+}
+
+void ThunderCore::supersede(ThunderCore::RequestKind kind, int ticket)
+{
+    int previous = tc_latestReplies.value(kind);
+    tc_latestReplies.insert(kind, ticket);
+
+    if (previous != ticket)
+        tc_scheduler->cancel(previous);
+}
+
 void ThunderCore::addCloudTaskPre(const QString &url)
+{
+    /// Called upon each keystroke, ask once typing stops
+    tc_pendingTaskCheck = url;
+    tc_taskCheckTimer.start();
+}
+
+void ThunderCore::slotQueryTaskCheck()
 {
     QUrl link ("http://dynamic.cloud.vip.xunlei.com/interface/"
                "task_check?callback=queryCid"
                "&random=13271369889801529719.0135479392&tcache=1327136998160");
-    link.addQueryItem("url", url);
+    link.addQueryItem("url", tc_pendingTaskCheck);
 
-    get (link);
+    supersede (TaskCheck, get (link, TaskCheck));
 }
 
 void ThunderCore::addMagnetTask(const QString &url)
+{
+    /// Nothing the server could answer yet, or nothing to ask for
+    const MagnetLink magnet (url);
+    if (! magnet.isValid() || findTorrentTask(magnet.infoHash()))
+    {
+        tc_urlQueryTimer.stop();
+        return;
+    }
+
+    tc_pendingUrlQuery = url;
+    tc_urlQueryTimer.start();
+}
+
+void ThunderCore::slotQueryMagnet()
+{
+    supersede (UrlQuery, get (magnetQueryUrl(tc_pendingUrlQuery), UrlQuery));
+}
+
+QUrl ThunderCore::magnetQueryUrl(const QString &url)
 {
     QUrl link ("http://dynamic.cloud.vip.xunlei.com/interface/url_query?"
                "callback=queryUrl&interfrom=task&random="
                "1387004514910746411.906726174&tcache=1387004515771");
     link.addQueryItem("u", url);
 
-    get (link);
-    return;
+    return link;
 }
 
-void ThunderCore::slotFinished(QNetworkReply *reply)
+void ThunderCore::addMagnetTasks(const QStringList &urls)
 {
-    const QUrl & url = reply->url();
-    const QString & urlStr = url.toString();
-    const QByteArray & data = reply->readAll();
-    int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-
-    if (httpStatus < 200 || httpStatus > 400)
+    QSet<QByteArray> hashes;
+    foreach (const QString & url, urls)
     {
-        error (tr("Error reading %1, got %2 (Reason: %3)")
-               .arg(urlStr)
-               .arg(httpStatus)
-               .arg(reply->errorString()), Notice);
-        return;
-    }
-    /////
+        const MagnetLink magnet (url);
+        if (! magnet.isValid())
+        {
+            error (tr("Not a BT magnet link: %1").arg(url), Notice);
+            continue;
+        }
 
-    if (urlStr.startsWith("http://login.xunlei.com/check"))
-    {
-        QByteArray capcha;
-        foreach (const QNetworkCookie & cookie, tc_nam->cookieJar()->cookiesForUrl(url))
+        const Thunder::Task *existing = findTorrentTask(magnet.infoHash());
+        if (existing || hashes.contains(magnet.infoHash()))
         {
-            if (cookie.name() == "check_result") { capcha = cookie.value(); break; }
+            error (tr("%1 was added already, skipped.")
+                   .arg(existing ? existing->name : magnet.name()), Notice);
+            continue;
         }
 
-        /* Get rid of heading 0: */
-        capcha = capcha.remove(0, 2);
+        hashes.insert(magnet.infoHash());
+        tc_magnetQueue.append(url);
+    }
+
+    dispatchMagnetQueries();
+}
 
-        if (capcha.isEmpty())
-        {
-            error (tr("Capcha required, retrieving .."), Notice);
-            tc_loginStatus = Failed; emit StatusChanged (LoginChanged);
+void ThunderCore::dispatchMagnetQueries()
+{
+    while (tc_magnetQueries.size() < TORRENT_CONCURRENCY && ! tc_magnetQueue.isEmpty())
+    {
+        const QString & url = tc_magnetQueue.takeFirst();
 
-            /* TODO: */
-            get (QString("http://verify.xunlei.com/image?cachetime=1359365355018"));
+        /// Not merged through get(), the dialog supersedes its own url_query
+        /// and would cancel a shared one
+        const int ticket = tc_scheduler->get(createRequest(magnetQueryUrl(url), UrlQuery),
+                                             tc_requestLanes[UrlQuery]);
+        tc_magnetQueries.insert(ticket, url);
+    }
+}
 
-            return;
-        }
+void ThunderCore::finishMagnetQuery(int ticket)
+{
+    if (tc_magnetQueries.remove(ticket))
+        dispatchMagnetQueries();
+}
 
-        loginWithCapcha(capcha);
+/*!
+ * Reply handlers, indexed by RequestKind. Keep in sync with the enum!
+ */
+const ThunderCore::ReplyHandler ThunderCore::tc_replyHandlers[RequestKindCount] =
+{
+    &ThunderCore::handleLoginCheck,
+    &ThunderCore::handleCapchaImage,
+    &ThunderCore::handleSec2Login,
+    &ThunderCore::handleCloudLogin,
+    &ThunderCore::handleTaskPage,
+    &ThunderCore::handleTaskDelete,
+    &ThunderCore::handleTaskCheck,
+    &ThunderCore::handleTaskCommit,
+    &ThunderCore::handleTorrentUpload,
+    &ThunderCore::handleBTTaskCommit,
+    &ThunderCore::handleUserHistory,
+    &ThunderCore::handleHistoryClear,
+    &ThunderCore::handleBTFolder,
+    &ThunderCore::handleBatchTaskCheck,
+    &ThunderCore::handleBatchTaskCommit,
+    &ThunderCore::handleTaskDelay,
+    &ThunderCore::handleUrlQuery,
+    &ThunderCore::handleTaskProgress
+};
+
+/*!
+ * Scheduler lane of each RequestKind. Keep in sync with the enum!
+ */
+const RequestScheduler::Lane ThunderCore::tc_requestLanes[RequestKindCount] =
+{
+    RequestScheduler::Interactive,      // LoginCheck
+    RequestScheduler::Interactive,      // CapchaImage
+    RequestScheduler::Interactive,      // Sec2Login
+    RequestScheduler::Interactive,      // CloudLogin
+    RequestScheduler::Refresh,          // TaskPage
+    RequestScheduler::Interactive,      // TaskDelete
+    RequestScheduler::Interactive,      // TaskCheck
+    RequestScheduler::Interactive,      // TaskCommit
+    RequestScheduler::Interactive,      // TorrentUpload
+    RequestScheduler::Interactive,      // BTTaskCommit
+    RequestScheduler::Housekeeping,     // UserHistory
+    RequestScheduler::Interactive,      // HistoryClear
+    RequestScheduler::Prefetch,         // BTFolder
+    RequestScheduler::Interactive,      // BatchTaskCheck
+    RequestScheduler::Interactive,      // BatchTaskCommit
+    RequestScheduler::Housekeeping,     // TaskDelay
+    RequestScheduler::Interactive,      // UrlQuery
+    RequestScheduler::Refresh           // TaskProgress
+};
 
-        return;
+void ThunderCore::slotFinished(QNetworkReply *reply)
+{
+    reply->deleteLater();
+
+    if (reply->operation() == QNetworkAccessManager::GetOperation)
+    {
+        const QByteArray & key = pendingGetKey(
+                    reply->request().url(),
+                    (RequestKind) reply->request().attribute(ATTR_REQUEST_KIND).toInt());
+        if (tc_pendingGets.value(key) ==
+                reply->request().attribute(RequestScheduler::TicketAttribute).toInt())
+            tc_pendingGets.remove(key);
     }
 
-    if (urlStr.startsWith("http://verify.xunlei.com/image"))
+    const QNetworkRequest & request = reply->request();
+    const QByteArray & data = reply->readAll();
+    int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    bool hasKind = false;
+    int kind = request.attribute(ATTR_REQUEST_KIND).toInt(&hasKind);
+    const qint64 latency = QDateTime::currentMSecsSinceEpoch()
+            - request.attribute(ATTR_REQUEST_START).toLongLong();
+
+    if (hasKind && kind >= 0 && kind < RequestKindCount)
     {
-        tc_capcha = data;
-        error (tr("Capcha received, size %1").arg(tc_capcha.size()), Notice);
+        RequestStats & stats = tc_requestStats[kind];
+        ++ stats.count;
+        stats.bytes   += data.size();
+        stats.latency += latency;
+    }
 
-        emit StatusChanged(CapchaReady);
+    if (tc_recorder && reply->error() != QNetworkReply::OperationCanceledError)
+        tc_recorder->record(reply, data, hasKind ? kind : -1, latency);
 
+    /// Superseded or cancelled on purpose
+    if (reply->error() == QNetworkReply::OperationCanceledError)
+    {
+        abandonRequest(request);
         return;
     }
 
-    if (urlStr.startsWith("http://login.xunlei.com/sec2login/"))
+    if (httpStatus < 200 || httpStatus > 400)
     {
-        /* blogresult? another WTF name */
-        int blogresult = 0;
+        error (tr("Error reading %1, got %2 (Reason: %3)")
+               .arg(reply->url().toString())
+               .arg(httpStatus)
+               .arg(reply->errorString()), Notice);
 
-        foreach (const QNetworkCookie & cookie, tc_nam->cookieJar()->cookiesForUrl(url))
+        if (hasKind && kind == TaskPage && tc_resumingSession)
+            rejectSession();
+
+        if (hasKind && kind == TaskDelay)
         {
-            if (cookie.name() == "usernick")
-            {
-                error (tr("User nick: %1").arg(QString::fromAscii(cookie.value())), Info);
-            }
-            else if (cookie.name() == "blogresult")
-            {
-                blogresult = cookie.value().toInt();
-            }
-
-            tc_session.insert(cookie.name(), cookie.value());
+            trackRenewals(reply->url(), RenewFailed);
+            scheduleRenewals();
         }
 
-        switch (blogresult)
-        {
-        case 1:
-            /* Captcha */
-            error (tr("Wrong capcha submitted, re-fetching image .."), Notice);
-            tc_loginStatus = Failed; emit StatusChanged (LoginChanged);
-
-            /* TODO: */
-            get (QString("http://verify.xunlei.com/image?cachetime=1359365355018"));
-
-            break;
-        case 2:
-            /* Invalid credential combination */
-            error (tr("Logon failure, invalid credential combination"), Warning);
-            tc_loginStatus = Failed; emit StatusChanged (LoginChanged);
-
-            break;
-        case 0:
-            /* Success */
-        default:
-            break;
-        }
+        if (hasKind && (kind == BatchTaskCheck || kind == BatchTaskCommit))
+            retryBatchChunk(request.attribute(RequestScheduler::TicketAttribute).toInt());
 
-        if (! tc_session.contains("jumpkey"))
-        {
-            error (tr("Cannot retrieve jumpkey, is the protocol changed?"), Warning);
-            tc_loginStatus = Failed; emit StatusChanged (LoginChanged);
+        if (hasKind && kind == TorrentUpload)
+            finishTorrentUpload(request.attribute(RequestScheduler::TicketAttribute).toInt());
 
-            return;
-        }
+        if (hasKind && kind == UrlQuery)
+            finishMagnetQuery(request.attribute(RequestScheduler::TicketAttribute).toInt());
 
-        get (QUrl("http://dynamic.cloud.vip.xunlei.com/login?"
-                  "cachetime=1327129660280&cachetime=1327129660555&from=0"));
+        if (hasKind && kind == TaskDelete)
+            finishTaskDelete(request.attribute(RequestScheduler::TicketAttribute).toInt(), false);
 
         return;
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/login"))
+    if (hasKind && kind >= 0 && kind < RequestKindCount)
     {
-        get (QUrl("http://dynamic.cloud.vip.xunlei.com/user_task?userid=" +
-                  tc_session.value("userid")));
-
-        tc_loginStatus = NoError; emit StatusChanged (LoginChanged);
-
+        (this->*tc_replyHandlers[kind]) (reply, data);
         return;
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/interface/showtask_unfresh"))
-    {
-        error (tr("Parsing task data .."), Info);
-        parseCloudPage(data, url.queryItemValue("page").toInt(), url.queryItemValue("t"));
+    /// Cookies and body may carry the session, leave them out
+    error (tr("Unhandled reply from %1").arg(reply->url().toString(QUrl::RemoveQuery)), Warning);
+}
 
+void ThunderCore::slotRequestCancelled(int ticket, const QNetworkRequest &request)
+{
+    /// Never sent, slotFinished() won't see it
+    const QByteArray & key = pendingGetKey(
+                request.url(), (RequestKind) request.attribute(ATTR_REQUEST_KIND).toInt());
+    if (tc_pendingGets.value(key) == ticket)
+        tc_pendingGets.remove(key);
+
+    abandonRequest(request);
+}
+
+void ThunderCore::abandonRequest(const QNetworkRequest &request)
+{
+    bool hasKind = false;
+    const int kind   = request.attribute(ATTR_REQUEST_KIND).toInt(&hasKind);
+    const int ticket = request.attribute(RequestScheduler::TicketAttribute).toInt();
+
+    if (! hasKind)
         return;
-    }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/user_task"))
+    switch (kind)
     {
-        /*
-        * It's best to handle the page with QtScript!
-        */
-        error (tr("Retrieved user page, fetching task data .."), Info);
-        reloadCloudTasks();
+    case TaskDelay:
+        /// Pending forever otherwise, try again later
+        trackRenewals(request.url(), RenewFailed);
+        scheduleRenewals();
+        break;
+    case BatchTaskCheck:
+    case BatchTaskCommit:
+        tc_batchInFlight.remove(ticket);
+        break;
+    case TorrentUpload:
+        finishTorrentUpload(ticket);
+        break;
+    case UrlQuery:
+        finishMagnetQuery(ticket);
+        break;
+    case TaskDelete:
+        tc_pendingDeletes.remove(ticket);
+        break;
+    default:
+        break;
+    }
+}
 
-        return;
+qint64 ThunderCore::getLoginDuration()
+{
+    return tc_loginDuration;
+}
+
+ThunderCore::RequestStats ThunderCore::getRequestStats(ThunderCore::RequestKind kind)
+{
+    return tc_requestStats.value(kind);
+}
+
+RequestScheduler *ThunderCore::getScheduler()
+{
+    return tc_scheduler;
+}
+
+void ThunderCore::handleLoginCheck(QNetworkReply *reply, const QByteArray &data)
+{
+    Q_UNUSED(data);
+
+    QByteArray capcha;
+    foreach (const QNetworkCookie & cookie, tc_nam->cookieJar()->cookiesForUrl(reply->url()))
+    {
+        if (cookie.name() == "check_result") { capcha = cookie.value(); break; }
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/interface/task_delete"))
+    /* Get rid of heading 0: */
+    capcha = capcha.remove(0, 2);
+
+    if (capcha.isEmpty())
     {
-        error (tr("Task removed from cloud!"), Info);
-        return;
+        error (tr("Capcha required, retrieving .."), Notice);
+        tc_loginStatus = Failed; emit StatusChanged (LoginChanged);
 
-        /*!
-         * \brief Reload user page!
-         */
-        reloadCloudTasks();
+        /* TODO: */
+        get (QString("http://verify.xunlei.com/image?cachetime=1359365355018"), CapchaImage);
 
-        error (tr("Task removed, reloading page .."), Info);
         return;
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/interface/task_check"))
-    {
-        QStringList fields = Util::parseFunctionFields(data);
+    loginWithCapcha(capcha);
+}
 
-        if (fields.size() < 10)
-        {
-            error (tr("Protocol changed or parser failure (incorrect column count), submit this line: %1")
-                   .arg(QString::fromUtf8(data)), Warning);
-            return;
-        }
+void ThunderCore::handleCapchaImage(QNetworkReply *reply, const QByteArray &data)
+{
+    Q_UNUSED(reply);
 
-        tmp_singleTask.name = fields.at(4);
-        tmp_singleTask.size = Util::toReadableSize(fields.at(2).toULongLong());
+    tc_capcha = data;
+    error (tr("Capcha received, size %1").arg(tc_capcha.size()), Notice);
 
-        emit RemoteTaskChanged(SingleTaskReady);
+    emit StatusChanged(CapchaReady);
+}
 
-        return;
+void ThunderCore::handleSec2Login(QNetworkReply *reply, const QByteArray &data)
+{
+    Q_UNUSED(data);
+
+    /* blogresult? another WTF name */
+    int blogresult = 0;
+
+    foreach (const QNetworkCookie & cookie, tc_nam->cookieJar()->cookiesForUrl(reply->url()))
+    {
+        if (cookie.name() == "usernick")
+        {
+            error (tr("User nick: %1").arg(QString::fromAscii(cookie.value())), Info);
+        }
+        else if (cookie.name() == "blogresult")
+        {
+            blogresult = cookie.value().toInt();
+        }
+
+        tc_session.insert(cookie.name(), cookie.value());
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/interface/task_commit"))
+    switch (blogresult)
     {
-        error(tr("Task added, reloading page .."), Notice);
+    case 1:
+        /* Captcha */
+        error (tr("Wrong capcha submitted, re-fetching image .."), Notice);
+        tc_loginStatus = Failed; emit StatusChanged (LoginChanged);
+
+        /* TODO: */
+        get (QString("http://verify.xunlei.com/image?cachetime=1359365355018"), CapchaImage);
+
+        break;
+    case 2:
+        /* Invalid credential combination */
+        error (tr("Logon failure, invalid credential combination"), Warning);
+        tc_loginStatus = Failed; emit StatusChanged (LoginChanged);
+
+        break;
+    case 0:
+        /* Success */
+    default:
+        break;
+    }
 
-        reloadCloudTasks();
+    if (! tc_session.contains("jumpkey"))
+    {
+        error (tr("Cannot retrieve jumpkey, is the protocol changed?"), Warning);
+        tc_loginStatus = Failed; emit StatusChanged (LoginChanged);
 
         return;
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/"
-                          "interface/torrent_upload"))
-    {
-        // todo: bt task editing?
-        QByteArray json = data;
+    get (QUrl("http://dynamic.cloud.vip.xunlei.com/login?"
+              "cachetime=1327129660280&cachetime=1327129660555&from=0"), CloudLogin);
+}
 
-        // remove btResult =
-        json.remove (0, 51);
+void ThunderCore::handleCloudLogin(QNetworkReply *reply, const QByteArray &data)
+{
+    Q_UNUSED(reply);
+    Q_UNUSED(data);
 
-        // chop </script>
-        json.chop (10);
+    /// user_task page was never used, go for the task list directly
+    storeSession();
+    reloadCloudTasks();
 
-        QJson::Parser parser;
-        bool ok = false;
-        QVariant result = parser.parse(json, &ok);
+    tc_loginStatus = NoError; emit StatusChanged (LoginChanged);
+}
 
-        if (! ok)
-        {
-            error (tr("JSON parse failure, protocol changed or invalid data."),
-                   Warning);
-            qDebug() << json;
+void ThunderCore::handleTaskPage(QNetworkReply *reply, const QByteArray &data)
+{
+    const QUrl & url = reply->url();
 
-            return;
-        }
+    error (tr("Parsing task data .."), Info);
+    parseCloudPage(data, url.queryItemValue("page").toInt(), url.queryItemValue("t"));
+}
 
-        tmp_btTask.ftitle = result.toMap().value("ftitle").toString();
-        tmp_btTask.infoid = result.toMap().value("infoid").toString();
-        tmp_btTask.btsize = result.toMap().value("btsize").toULongLong();
+void ThunderCore::handleTaskDelete(QNetworkReply *reply, const QByteArray &data)
+{
+    const int ticket = reply->request().attribute(RequestScheduler::TicketAttribute).toInt();
 
-        foreach (const QVariant & item, result.toMap().value("filelist").toList())
-        {
-            QVariantMap map = item.toMap();
+    /// Optional callback around the object
+    int begin = data.indexOf('('), end = data.lastIndexOf(')');
+    if (begin < 0 || end <= begin)
+    {
+        begin = -1;
+        end   = data.size();
+    }
 
-            Thunder::BTSubTask task;
-            task.name = map.value("subtitle").toString();
-            task.format_size = map.value("subformatsize").toString();
-            task.size = map.value("subsize").toString();
-            task.id = map.value("id").toString();
-            task.findex = map.value("findex").toString();
+    JsonReader reader (data.constData() + begin + 1, data.constData() + end);
+    JsonReader::Slice key;
 
-            tmp_btTask.subtasks.append(task);
+    /// No result field at all counts as done, as before
+    int result = 1;
+    if (reader.beginObject())
+    {
+        while (reader.nextMember(key))
+        {
+            if (key == "result")
+                result = reader.readInt();
+            else
+                reader.skipValue();
         }
+    }
 
-        emit RemoteTaskChanged(BitorrentTaskReady);
+    finishTaskDelete(ticket, result == 1);
+}
 
+void ThunderCore::finishTaskDelete(int ticket, bool removed)
+{
+    const QList<quint64> & ids = tc_pendingDeletes.take(ticket);
+    if (ids.isEmpty())
         return;
 
+    if (! removed)
+    {
+        error (tr("Server refused to remove %1 task(s)").arg(ids.size()), Warning);
+        return;
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/"
-                          "interface/bt_task_commit"))
-    {
-        error(tr("Bitorrent commited, reloading tasks .."), Notice);
+    /// All rows in one go
+    tc_tasks->remove(ids);
+    tc_cache->storeTasks(tc_tasks->tasks());
 
-        reloadCloudTasks();
+    error (tr("%1 task(s) removed from cloud!").arg(ids.size()), Info);
+}
 
+void ThunderCore::handleTaskCheck(QNetworkReply *reply, const QByteArray &data)
+{
+    Q_UNUSED(reply);
+
+    const FunctionFields fields (data);
+
+    if (fields.size() < 10)
+    {
+        error (tr("Protocol changed or parser failure (incorrect column count), submit this line: %1")
+               .arg(QString::fromUtf8(data)), Warning);
         return;
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/user_history"))
-    {
-        error(tr("History data acquired, parsing .."), Notice);
+    tmp_singleTask.name = fields.at(4);
+    tmp_singleTask.size = Util::toReadableSize(fields.toULongLong(2));
+
+    emit RemoteTaskChanged(SingleTaskReady);
+}
 
+void ThunderCore::handleTaskCommit(QNetworkReply *reply, const QByteArray &data)
+{
+    Q_UNUSED(reply);
+    Q_UNUSED(data);
+
+    error(tr("Task added, reloading page .."), Notice);
+
+    scheduleReload();
+}
+
+void ThunderCore::handleTorrentUpload(QNetworkReply *reply, const QByteArray &data)
+{
+    const int ticket = reply->request().attribute(RequestScheduler::TicketAttribute).toInt();
+    Thunder::BitorrentTask bt_task;
+
+    if (! decodeTorrentUpload(data, bt_task))
+    {
+        error (tr("JSON parse failure, protocol changed or invalid data."),
+               Warning);
         qDebug() << data;
 
+        finishTorrentUpload(ticket);
         return;
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/interface/history_clear"))
+    /// Part of uploadBitorrents(), every file of the torrent is wanted
+    if (tc_torrentUploads.contains(ticket))
     {
-        error(tr("History emptied"), Notice);
-
-        // ERROR checking?
+        error (tr("Adding %1 (%2 file(s)) ..").arg(bt_task.ftitle).arg(bt_task.subtasks.size()),
+               Info);
 
+        commitBitorrentTask(bt_task, bt_task.subtasks);
+        finishTorrentUpload(ticket);
         return;
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/interface/fill_bt_list"))
+    tmp_btTask = bt_task;
+    emit RemoteTaskChanged(BitorrentTaskReady);
+}
+
+bool ThunderCore::decodeTorrentUpload(const QByteArray &data, Thunder::BitorrentTask &bt_task)
+{
+    // todo: bt task editing?
+    // skip "btResult =" and trailing </script>
+    if (data.size() < 61)
+        return false;
+
+    JsonReader reader (data.constData() + 51, data.constData() + data.size() - 10);
+    JsonReader::Slice key;
+
+    bt_task.subtasks.clear();
+    reader.beginObject();
+
+    while (reader.nextMember(key))
     {
-        error(tr("BT task page retrieved, parsing (page %1)..").arg(url.queryItemValue("p")), Notice);
+        if (key == "ftitle")
+            bt_task.ftitle = reader.readString();
+        else if (key == "infoid")
+            bt_task.infoid = reader.readString();
+        else if (key == "btsize")
+            bt_task.btsize = reader.readULongLong();
+        else if (key == "filelist" && reader.beginArray())
+        {
+            while (reader.nextElement() && reader.beginObject())
+            {
+                Thunder::BTSubTask task;
+                while (reader.nextMember(key))
+                {
+                    if (key == "subtitle")
+                        task.name = reader.readString();
+                    else if (key == "subformatsize")
+                        task.format_size = reader.readString();
+                    else if (key == "subsize")
+                        task.size = reader.readString();
+                    else if (key == "id")
+                        task.id = reader.readString();
+                    else if (key == "findex")
+                        task.findex = reader.readString();
+                    else
+                        reader.skipValue();
+                }
+
+                bt_task.subtasks.append(task);
+            }
+        }
+        else
+            reader.skipValue();
+    }
 
-        QByteArray json = data;
+    return ! reader.hasError();
+}
 
-        // remove a(
-        json.remove (0, 13);
+void ThunderCore::handleBTTaskCommit(QNetworkReply *reply, const QByteArray &data)
+{
+    Q_UNUSED(reply);
+    Q_UNUSED(data);
 
-        // chop )
-        json.chop (1);
+    error(tr("Bitorrent commited, reloading tasks .."), Notice);
 
-        QJson::Parser parser;
-        bool ok = false;
-        QVariant result = parser.parse(json, &ok);
+    scheduleReload();
+}
 
-        if (! ok)
-        {
-            error (tr("BT task page: JSON parse failure, "
-                      "protocol changed or invalid data."),
-                   Warning);
-            qDebug() << json;
+void ThunderCore::handleUserHistory(QNetworkReply *reply, const QByteArray &data)
+{
+    Q_UNUSED(reply);
 
-            return;
-        }
+    error(tr("History data acquired, parsing .."), Notice);
 
-        result = result.toMap().value("Result");
+    qDebug() << data;
+}
 
-        Thunder::BitorrentTask bt_task;
-        const QVariantMap & resultMap = result.toMap();
+void ThunderCore::handleHistoryClear(QNetworkReply *reply, const QByteArray &data)
+{
+    Q_UNUSED(reply);
+    Q_UNUSED(data);
+
+    error(tr("History emptied"), Notice);
+
+    // ERROR checking?
+}
+
+bool ThunderCore::decodeBTFolderPage(const QByteArray &data,
+                                     Thunder::BitorrentTask &bt_task,
+                                     int &now_page, int &btnum, int &btpernum,
+                                     bool &finished)
+{
+    // a( ... )
+    if (data.size() < 14)
+        return false;
+
+    JsonReader reader (data.constData() + 13, data.constData() + data.size() - 1);
+    JsonReader::Slice key;
 
-        int now_page = resultMap.value ("now_page").toInt();
-        int btnum = resultMap.value("btnum").toInt();
-        int btpernum = resultMap.value("btpernum").toInt();
+    finished = false;
+    now_page = btnum = btpernum = 0;
 
-        //        qDebug() << btnum << now_page << btpernum;
+    if (! reader.beginObject())
+        return false;
 
-        if (btpernum != 0)
+    while (reader.nextMember(key))
+    {
+        if (key != "Result")
+        {
+            reader.skipValue();
+            continue;
+        }
+
+        if (! reader.beginObject())
+            return false;
+
+        while (reader.nextMember(key))
         {
-            if (now_page < btnum / btpernum + 1)
+            finished = true;
+
+            if (key == "now_page")
+                now_page = reader.readInt();
+            else if (key == "btnum")
+                btnum = reader.readInt();
+            else if (key == "btpernum")
+                btpernum = reader.readInt();
+            else if (key == "Tid")
+                bt_task.taskid = reader.readString();
+            else if (key == "Record" && reader.beginArray())
             {
-                /// dirty hack: repicate current request!
-                QNetworkRequest request = reply->request();
-                QUrl url = request.url();
-                url.removeQueryItem("p");
-                url.addQueryItem("p", QString::number(++ now_page));
-                request.setUrl(url);
-
-                tc_nam->get(request);
+                while (reader.nextElement() && reader.beginObject())
+                {
+                    Thunder::BTSubTask subtask;
+                    while (reader.nextMember(key))
+                    {
+                        if (key == "id")
+                            subtask.id = reader.readString();
+                        else if (key == "filesize")
+                            subtask.size = Util::toReadableSize(reader.readULongLong());
+                        else if (key == "downurl")
+                            subtask.link = reader.readString().replace("\\/", "/");
+                        else if (key == "title")
+                            subtask.name = reader.readString();
+                        else
+                            reader.skipValue();
+                    }
+
+                    bt_task.subtasks.append(subtask);
+                }
             }
+            else
+                reader.skipValue();
         }
+    }
 
-        if (resultMap.size() == 0)
+    return ! reader.hasError();
+}
+
+void ThunderCore::handleBTFolder(QNetworkReply *reply, const QByteArray &data)
+{
+    const QUrl & url = reply->url();
+    const QString & taskid = url.queryItemValue("tid");
+    int page = url.queryItemValue("p").toInt();
+
+    /// Leftover of a cancelled fetch
+    if (! tc_btFolders.contains(taskid) ||
+            tc_btFolders[taskid].tickets.removeAll(
+                reply->request().attribute(RequestScheduler::TicketAttribute).toInt()) == 0)
+        return;
+
+    error(tr("BT task page retrieved, parsing (page %1)..").arg(page), Notice);
+
+    Thunder::BitorrentTask bt_task;
+    int now_page, btnum, btpernum;
+    bool finished;
+
+    if (! decodeBTFolderPage(data, bt_task, now_page, btnum, btpernum, finished))
+    {
+        error (tr("BT task page: JSON parse failure, "
+                  "protocol changed or invalid data."),
+               Warning);
+        qDebug() << data;
+
+        return;
+    }
+
+    BTFolderEntry & folder = tc_btFolders[taskid];
+
+    if (page <= 1)
+    {
+        if (! finished)
         {
             error(tr("BT task not finished, skipping sub tasks."), Notice);
             return;
         }
 
-        bt_task.taskid = resultMap.value("Tid").toString();
+        /// Ask for all remaining pages at once
+        folder.pages = btpernum > 0 ? qMax (1, (btnum + btpernum - 1) / btpernum) : 1;
 
-        QVariant mainMap = resultMap.value("Record");
+        Thunder::Task task;
+        task.id  = taskid.toULongLong();
+        task.cid = folder.cid.toAscii();
 
-        foreach (const QVariant & record, mainMap.toList())
-        {
-            const QVariantMap & map = record.toMap();
-            Thunder::BTSubTask subtask;
+        for (int i = 2; i <= folder.pages; ++ i)
+            getContentsOfBTFolder(task, i);
+    }
 
-            subtask.id = map.value("id").toString();
-            subtask.size = Util::toReadableSize(map.value("filesize").toULongLong());
-            subtask.link = map.value("downurl").toString().replace("\\/", "/");
-            subtask.name = map.value("title").toString();
+    folder.arrived.insert(page, bt_task.subtasks);
 
-            bt_task.subtasks.append(subtask);
-        }
+    /// Deliver in order, as soon as the preceding pages are there
+    while (folder.arrived.contains(folder.delivered + 1))
+    {
+        Thunder::BitorrentTask ready;
+        ready.taskid   = taskid;
+        ready.page     = ++ folder.delivered;
+        ready.subtasks = folder.arrived.take(ready.page);
+        ready.complete = folder.delivered >= folder.pages;
 
-        emit BTSubTaskReady (bt_task);
+        folder.subtasks.append(ready.subtasks);
+        tc_cache->storeBTSubTasks(taskid, ready.subtasks, ready.page == 1);
+
+        if (ready.complete)
+            folder.fetched = QDateTime::currentDateTime();
+
+        emit BTSubTaskReady (ready);
+    }
+}
+
+void ThunderCore::handleBatchTaskCheck(QNetworkReply *reply, const QByteArray &data)
+{
+    const int ticket = reply->request().attribute(RequestScheduler::TicketAttribute).toInt();
+
+    /// Chunk of a list that was replaced meanwhile
+    if (! tc_batchInFlight.contains(ticket))
+        return;
+
+    QByteArray json = data;
+
+    // remove <script>document.domain='xunlei.com';parent.begin_task_batch_resp(
+    json.remove(0, json.indexOf("(") + 1);
+
+    // chop ,'123456');</script>"
+    json.chop(json.length() - json.lastIndexOf("]") - 1);
+
+    QJson::Parser parser;
+    bool ok = false;
+
+    QVariant result = parser.parse(json, &ok);
+    if (! ok)
+    {
+        error (tr("Batch task parser: JSON parse failure, "
+                  "protocol changed or invalid data."),
+               Warning);
+        qDebug() << json;
+
+        retryBatchChunk(ticket);
         return;
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/interface/batch_task_check"))
+    tc_batchInFlight.remove(ticket);
+    dispatchBatchChunks();
+
+    tmp_batchTasks.clear();
+    foreach (const QVariant & item, result.toList())
     {
-        QByteArray json = data;
+        const QVariantMap & itemData = item.toMap();
+        Thunder::BatchTask batch_task;
 
-        // remove <script>document.domain='xunlei.com';parent.begin_task_batch_resp(
-        json.remove(0, json.indexOf("(") + 1);
+        batch_task.url = itemData.value("url").toString();
+        batch_task.name = itemData.value("name").toString();
+        batch_task.size = itemData.value("filesize").toULongLong();
+        batch_task.formatsize = itemData.value("formatsize").toString();
 
-        // chop ,'123456');</script>"
-        json.chop(json.length() - json.lastIndexOf("]") - 1);
+        tmp_batchTasks.push_back(batch_task);
+    }
 
-        QJson::Parser parser;
-        bool ok = false;
+    emit RemoteTaskChanged(ThunderCore::BatchTaskReady);
+}
 
-        QVariant result = parser.parse(json, &ok);
-        if (! ok)
-        {
-            error (tr("Batch task parser: JSON parse failure, "
-                      "protocol changed or invalid data."),
-                   Warning);
-            qDebug() << json;
+void ThunderCore::handleBatchTaskCommit(QNetworkReply *reply, const QByteArray &data)
+{
+    Q_UNUSED(data);
+
+    tc_batchInFlight.remove(reply->request().attribute(RequestScheduler::TicketAttribute).toInt());
+    dispatchBatchChunks();
 
+    /// Reload once the last chunk is in
+    foreach (const BatchChunk & chunk, tc_batchQueue + tc_batchInFlight.values())
+    {
+        if (chunk.kind == BatchTaskCommit)
             return;
-        }
+    }
 
-        tmp_batchTasks.clear();
-        foreach (const QVariant & item, result.toList())
-        {
-            const QVariantMap & itemData = item.toMap();
-            Thunder::BatchTask batch_task;
+    scheduleReload();
+}
 
-            batch_task.url = itemData.value("url").toString();
-            batch_task.name = itemData.value("name").toString();
-            batch_task.size = itemData.value("filesize").toULongLong();
-            batch_task.formatsize = itemData.value("formatsize").toString();
+void ThunderCore::handleTaskDelay(QNetworkReply *reply, const QByteArray &data)
+{
+    int result = 0;
+    QHash<QString, int> results, liveTimes;
 
-            tmp_batchTasks.push_back(batch_task);
-        }
+    if (! decodeTaskDelay(data, result, results, liveTimes))
+    {
+        trackRenewals(reply->url(), RenewFailed);
+        scheduleRenewals();
+        return;
+    }
 
-        emit RemoteTaskChanged(ThunderCore::BatchTaskReady);
+    const QStringList & ids = trackRenewals(reply->url(), result == 1 ? Renewed : RenewFailed);
 
-        return;
+    int failed = 0;
+    foreach (const QString & id, ids)
+    {
+        Renewal & renewal = tc_renewals[id];
+        if (results.contains(id))
+            renewal.status = results.value(id) == 1 ? Renewed : RenewFailed;
+
+        if (renewal.status == RenewFailed)
+            ++ failed;
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/interface/batch_task_commit"))
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+    foreach (const QString & id, ids)
     {
-        reloadCloudTasks();
+        const Thunder::Task *found = tc_tasks->findById(id.toULongLong());
+        if (! found || tc_renewals.value(id).status != Renewed)
+            continue;
+
+        /// Unknown expiry, next refresh tells
+        Thunder::Task task = *found;
+        task.expires = liveTimes.contains(id) ? now + liveTimes.value(id) : 0;
+        tc_tasks->update(task);
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/interface/task_delay"))
+    if (failed > 0)
+        error (tr("%1 of %2 task(s) could not be renewed, retrying later.")
+               .arg(failed).arg(ids.size()), Notice);
+
+    scheduleRenewals();
+}
+
+void ThunderCore::handleTaskProgress(QNetworkReply *reply, const QByteArray &data)
+{
+    Q_UNUSED(reply);
+
+    QList<Thunder::Task> records;
+    if (! decodeTaskProgress(data, records))
     {
+        error (tr("Protocol changed or parser failure (task progress), submit this line: %1")
+               .arg(QString::fromUtf8(data)), Warning);
         return;
     }
 
-    if (urlStr.startsWith("http://dynamic.cloud.vip.xunlei.com/interface/url_query"))
+    bool changed = false, finished = false;
+
+    foreach (const Thunder::Task & record, records)
     {
-        tmp_btTask.subtasks.clear();
+        const Thunder::Task *found = tc_tasks->findById(record.id);
+        if (! found)
+            continue;
+
+        if (found->progress == record.progress && found->status == record.status &&
+                (record.link.isEmpty() || record.link == found->link))
+            continue;
+
+        Thunder::Task task = *found;
+        const bool justFinished = task.status != 2 && record.status == 2;
+
+        task.progress = record.progress;
+        task.status   = record.status;
+        if (! record.link.isEmpty())
+            task.link = record.link;
 
-        const QStringList & fields = Util::parseFunctionFields(data);
-        //        for (int i = 0; i < fields.size(); ++i )
-        //            qDebug() << i << fields.at(i);
+        /// CloudTaskUpdated is relayed from the store
+        changed = true;
+        tc_tasks->update(task);
 
-        if (fields.size() < 10)
+        if (justFinished)
         {
-            error (tr("Invalid magnet link response, parse error?"), Notice);
+            finished = true;
+            emit CloudTaskFinished (task);
         }
-        else
-        {
-            tmp_btTask.infoid = fields.at(1);
-            tmp_btTask.btsize = fields.at(2).toULongLong();
-            tmp_btTask.ftitle = fields.at(3);
-
-            /* dirty hack! */
-            int count = fields.size() - 2 /* last two fields */ - 5 /* top 5 fields */;
-
-            /* 6 different "arrays"
-             * 0 array of file names
-             * 1 array of sizes (formatted)
-             * 2 array of raw sizes (in bytes)
-             * 3 array of unknown fields (never mind)
-             * 4 array of file extentions (icons)
-             * 5 array of raw file NO. (maintaining an list order?!)
-            */
-            int subs  = count / 6;
-
-//            qDebug() << "Torrent tasks count" << subs;
-            for (int i = 0; i < subs; ++ i)
-            {
-                Thunder::BTSubTask task;
-                task.id          = fields.at(1);
-                task.name        = fields.at(5 + 0 * subs + i);
-                task.format_size = fields.at(5 + 1 * subs + i);
-                task.size        = fields.at(5 + 2 * subs + i);
-                task.findex      = fields.at(5 + 5 * subs + i);
+    }
 
-                tmp_btTask.subtasks.append(task);
-            }
+    /// Download links are worth keeping
+    if (finished)
+        tc_cache->storeTasks(tc_tasks->tasks());
+
+    /// Back off while nothing moves
+    tc_progressInterval = changed ? PROGRESS_POLL_MIN
+                                  : qMin (tc_progressInterval * 2, PROGRESS_POLL_MAX);
+    tc_progressTimer.start(tc_progressInterval);
+}
+
+void ThunderCore::handleUrlQuery(QNetworkReply *reply, const QByteArray &data)
+{
+    const int ticket = reply->request().attribute(RequestScheduler::TicketAttribute).toInt();
+    Thunder::BitorrentTask bt_task;
+
+    const bool ok = decodeUrlQuery(data, bt_task);
+    if (! ok)
+        error (tr("Invalid magnet link response, parse error?"), Notice);
+
+    /// Part of addMagnetTasks(), every file is wanted
+    if (tc_magnetQueries.contains(ticket))
+    {
+        if (ok)
+        {
+            error (tr("Adding %1 (%2 file(s)) ..").arg(bt_task.ftitle).arg(bt_task.subtasks.size()),
+                   Info);
+            commitBitorrentTask(bt_task, bt_task.subtasks);
         }
 
-        emit RemoteTaskChanged(BitorrentTaskReady);
+        finishMagnetQuery(ticket);
         return;
     }
 
-    qDebug() << "Unhandled reply:" << "\n----";
-    qDebug() << "URL: " << urlStr;
-    qDebug() << "Cookie: ";
-    foreach (const QNetworkCookie & cookie, tc_nam->cookieJar()->cookiesForUrl(url))
+    if (ok)
+        tmp_btTask = bt_task;
+    else
+        tmp_btTask.subtasks.clear();
+
+    emit RemoteTaskChanged(BitorrentTaskReady);
+}
+
+bool ThunderCore::decodeUrlQuery(const QByteArray &data, Thunder::BitorrentTask &bt_task)
+{
+    bt_task.subtasks.clear();
+
+    const FunctionFields fields (data);
+
+    /* queryUrl(flag, infoid, size, title, ?, 6 arrays, ?, ?)
+     * 5 array of file names
+     * 6 array of sizes (formatted)
+     * 7 array of raw sizes (in bytes)
+     * 8 array of unknown fields (never mind)
+     * 9 array of file extentions (icons)
+     * 10 array of raw file NO. (maintaining an list order?!)
+    */
+    if (fields.hasError() || fields.argumentCount() < 11)
+        return false;
+
+    for (int i = 1; i <= 3; ++i)
     {
-        qDebug() << cookie.name() << cookie.value();
+        if (fields.countOf(i) != 1)
+            return false;
     }
-    qDebug() << "Data: " << data;
+
+    const int subs = fields.countOf(5);
+    if (fields.countOf(6) != subs || fields.countOf(7) != subs || fields.countOf(10) != subs)
+        return false;
+
+    bt_task.infoid = fields.at(fields.firstOf(1));
+    bt_task.btsize = fields.toULongLong(fields.firstOf(2));
+    bt_task.ftitle = fields.at(fields.firstOf(3));
+
+    for (int i = 0; i < subs; ++ i)
+    {
+        Thunder::BTSubTask task;
+        task.id          = bt_task.infoid;
+        task.name        = fields.at(fields.firstOf(5) + i);
+        task.format_size = fields.at(fields.firstOf(6) + i);
+        task.size        = fields.at(fields.firstOf(7) + i);
+        task.findex      = fields.at(fields.firstOf(10) + i);
+
+        bt_task.subtasks.append(task);
+    }
+
+    return true;
 }
 
 QByteArray ThunderCore::getCapchaCode()
@@ -689,155 +1675,590 @@ QString ThunderCore::getgdriveid()
     return tc_session.value("gdriveid");
 }
 
-void ThunderCore::parseCloudPage(const QByteArray &body, int pageNo, const QString & timestamp)
+bool ThunderCore::decodeTask(JsonReader &reader, Thunder::Task &task)
 {
-    /// Rejectes extensive task refreshes
-    if (timestamp != tc_timeStampForCloudTasks)
+    JsonReader::Slice key;
+
+    task.type     = Thunder::Single;
+    task.status   = 0;
+    task.size     = 0;
+    task.progress = 0;
+    task.expires  = 0;
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() / 1000;
+
+    if (! reader.beginObject())
+        return false;
+
+    while (reader.nextMember(key))
     {
-        return;
+        if (key == "id")
+            task.id = reader.readULongLong();
+        else if (key == "url")
+            task.source = reader.readString().toUtf8();
+        else if (key == "cid")
+            task.cid = reader.readString().toAscii();
+        else if (key == "taskname")
+            task.name = reader.readString();
+        else if (key == "lixian_url")
+            task.link = reader.readString().toUtf8();
+        else if (key == "ysfilesize")
+            task.size = reader.readULongLong();
+        else if (key == "download_status")
+            task.status = reader.readInt();
+        else if (key == "progress")
+            task.progress = reader.readInt();
+        else if (key == "left_live_time")
+        {
+            const int secs = Util::parseLiveTime(reader.readString());
+            if (secs >= 0)
+                task.expires = now + secs;
+        }
+        else
+            reader.skipValue();
     }
 
-    /// CACHE TASK IDS for automatic task renewal
-    QStringList local_taskids;
+    return ! reader.hasError();
+}
 
-    QVariantMap json_map, json_info, user_info;
-    QJson::Parser parser;
-    bool ok = false;
-    int total_task_num = 0;
+bool ThunderCore::decodeCloudPage(const QByteArray &body,
+                                  QList<Thunder::Task> &tasks,
+                                  int &total_task_num,
+                                  QString &gdriveid)
+{
+    if (body.size() < 4)
+        return false;
 
-    QByteArray json = body; json.chop(1); json.remove(0, 3);
-    QVariant result = parser.parse(json, &ok);
+    /// tc( ... )
+    JsonReader reader (body.constData() + 3, body.constData() + body.size() - 1);
+    JsonReader::Slice key;
+    bool hasTasks = false, hasUser = false;
 
-    if (! ok)
-        goto error;
+    if (! reader.beginObject())
+        return false;
 
-    json_map = result.toMap();
-    if (! json_map.contains("info"))
-        goto error;
+    while (reader.nextMember(key))
+    {
+        if (key != "info")
+        {
+            reader.skipValue();
+            continue;
+        }
 
-    json_info = json_map.value("info").toMap();
-    total_task_num = json_info.value("total_num").toInt();
-    if (! json_info.contains("tasks"))
-        goto error;
+        if (! reader.beginObject())
+            return false;
 
-    user_info = json_info.value("user").toMap();
-    if (user_info.isEmpty())
-        goto error;
+        while (reader.nextMember(key))
+        {
+            if (key == "total_num")
+            {
+                total_task_num = reader.readInt();
+            }
+            else if (key == "user")
+            {
+                if (! reader.beginObject())
+                    return false;
+
+                while (reader.nextMember(key))
+                {
+                    hasUser = true;
+
+                    if (key == "cookie")
+                        gdriveid = reader.readString();
+                    else
+                        reader.skipValue();
+                }
+            }
+            else if (key == "tasks")
+            {
+                if (! reader.beginArray())
+                    return false;
+
+                hasTasks = true;
+                while (reader.nextElement())
+                {
+                    Thunder::Task task;
+                    if (! decodeTask (reader, task))
+                        return false;
+
+                    if (! task.isEmpty())
+                        tasks.append(task);
+                }
+            }
+            else
+            {
+                reader.skipValue();
+            }
+        }
+    }
 
-    /// LOAD TASKS
-    if (pageNo == 1)
-        tc_cloudTasks.clear();
+    return hasTasks && hasUser && ! reader.hasError();
+}
+
+bool ThunderCore::decodeTaskProgress(const QByteArray &data, QList<Thunder::Task> &records)
+{
+    /// tp({"Process":{"Record":[ ... ]}})
+    int begin = data.indexOf('('), end = data.lastIndexOf(')');
+    if (begin < 0 || end <= begin)
+        return false;
 
-    foreach (const QVariant & taskItem, json_info.value("tasks").toList())
+    JsonReader reader (data.constData() + begin + 1, data.constData() + end);
+    JsonReader::Slice key;
+    bool hasRecords = false;
+
+    if (! reader.beginObject())
+        return false;
+
+    while (reader.nextMember(key))
     {
-        const QVariantMap & taskMap = taskItem.toMap();
+        if (key != "Process" || ! reader.beginObject())
+        {
+            reader.skipValue();
+            continue;
+        }
 
-        Thunder::Task task;
-        task.id     = taskMap.value("id").toString();
-        task.type   = Thunder::Single;
-
-        task.source   = taskMap.value("url").toString();
-        task.cid      = taskMap.value("cid").toString();
-        task.name     = taskMap.value("taskname").toString();
-        task.link     = taskMap.value("lixian_url").toString();
-        task.bt_url   = taskMap.value("url").toString();
-        task.size     = taskMap.value("ysfilesize").toULongLong();
-        task.status   = taskMap.value("download_status").toInt();
-        task.progress = taskMap.value("progress").toInt();
-
-        if (! tmp_cookieIsStored)
+        while (reader.nextMember(key))
         {
-            const QString & gdriveidCookie = user_info.value("cookie").toString();
+            if (key != "Record" || ! reader.beginArray())
+            {
+                reader.skipValue();
+                continue;
+            }
 
-            tmp_cookieIsStored = true;
-            tc_session.insert("gdriveid", gdriveidCookie);
-            emit CookiesReady (gdriveidCookie);
+            hasRecords = true;
+            while (reader.nextElement() && reader.beginObject())
+            {
+                Thunder::Task record;
+                record.status   = 0;
+                record.progress = 0;
+
+                while (reader.nextMember(key))
+                {
+                    if (key == "tid" || key == "id")
+                        record.id = reader.readULongLong();
+                    else if (key == "download_status")
+                        record.status = reader.readInt();
+                    else if (key == "percent" || key == "progress")
+                        record.progress = (int) reader.readString().toDouble();
+                    else if (key == "lixian_url")
+                        record.link = reader.readString().toUtf8();
+                    else
+                        reader.skipValue();
+                }
+
+                records.append(record);
+            }
+        }
+    }
 
-            Util::writeFile(getCookieFilePath(),
-                            ".vip.xunlei.com\tTRUE\t/\tFALSE\t90147186842\tgdriveid\t" +
-                            tc_session.value("gdriveid").toAscii() + "\n");
+    return hasRecords && ! reader.hasError();
+}
 
-            //            Util::writeCookieToFile(getCookieFilePath(),
-            //                                    tc_nam->cookieJar()->cookiesForUrl(
-            //                                        QUrl("http://gdl.lixian.vip.xunlei.com")));
+bool ThunderCore::decodeTaskDelay(const QByteArray &data,
+                                  int &result,
+                                  QHash<QString, int> &results,
+                                  QHash<QString, int> &liveTimes)
+{
+    /// Optional callback around the object
+    int begin = data.indexOf('('), end = data.lastIndexOf(')');
+    if (begin < 0 || end <= begin)
+    {
+        begin = -1;
+        end   = data.size();
+    }
 
-        }
+    JsonReader reader (data.constData() + begin + 1, data.constData() + end);
+    JsonReader::Slice key;
+    bool hasResult = false;
+
+    if (! reader.beginObject())
+        return false;
 
-        if (! task.isEmpty())
+    while (reader.nextMember(key))
+    {
+        if (key == "result")
+        {
+            result = reader.readInt();
+            hasResult = true;
+        }
+        else if (key == "list" && reader.beginArray())
         {
-            if (task.bt_url.startsWith("bt://"))
-                task.type = Thunder::BT;
-            tc_cloudTasks.push_back(task);
+            while (reader.nextElement() && reader.beginObject())
+            {
+                QString id, live_time;
+                int task_result = result;
+
+                while (reader.nextMember(key))
+                {
+                    if (key == "tid" || key == "id")
+                        id = reader.readString();
+                    else if (key == "result")
+                        task_result = reader.readInt();
+                    else if (key == "left_live_time")
+                        live_time = reader.readString();
+                    else
+                        reader.skipValue();
+                }
+
+                if (id.isEmpty())
+                    continue;
+
+                results.insert(id, task_result);
+
+                const int secs = Util::parseLiveTime(live_time);
+                if (secs >= 0)
+                    liveTimes.insert(id, secs);
+            }
+        }
+        else
+            reader.skipValue();
+    }
+
+    return hasResult && ! reader.hasError();
+}
+
+void ThunderCore::parseCloudPage(const QByteArray &body, int pageNo, const QString & timestamp)
+{
+    /// Rejectes extensive task refreshes
+    if (timestamp != tc_timeStampForCloudTasks)
+    {
+        return;
+    }
+
+    QList<Thunder::Task> tasks;
+    QString gdriveidCookie;
+    bool complete = false;
+    int total_task_num = 0;
 
-            local_taskids.append(task.id);
+    if (! decodeCloudPage(body, tasks, total_task_num, gdriveidCookie))
+    {
+        /// Most likely an expired session, not a protocol change
+        if (tc_resumingSession)
+        {
+            rejectSession();
+            return;
         }
+
+        error (tr("JSON parse error! Was the protocol changed?"), Warning);
+        return;
+    }
+
+    if (tc_resumingSession)
+    {
+        tc_resumingSession = false;
+
+        error (tr("Session resumed."), Info);
+        tc_loginStatus = NoError; emit StatusChanged (LoginChanged);
+    }
+
+    /// LOAD TASKS
+    if (pageNo == 1)
+        tc_refreshedTasks.clear();
+
+    if (! tmp_cookieIsStored && ! tasks.isEmpty())
+    {
+        tmp_cookieIsStored = true;
+        tc_session.insert("gdriveid", gdriveidCookie);
+        tc_cache->setSessionValue("gdriveid", gdriveidCookie);
+        tc_cache->setSessionValue("userid", tc_session.value("userid"));
+        emit CookiesReady (gdriveidCookie);
+
+        Util::writeFile(getCookieFilePath(),
+                        ".vip.xunlei.com\tTRUE\t/\tFALSE\t90147186842\tgdriveid\t" +
+                        tc_session.value("gdriveid").toAscii() + "\n");
+
+        //            Util::writeCookieToFile(getCookieFilePath(),
+        //                                    tc_nam->cookieJar()->cookiesForUrl(
+        //                                        QUrl("http://gdl.lixian.vip.xunlei.com")));
     }
 
-    /// MAGIC!
-    delayCloudTask(local_taskids);
+    for (int i = 0; i < tasks.size(); ++i)
+    {
+        Thunder::Task & task = tasks[i];
+
+        if (task.source.startsWith("bt://"))
+            task.type = Thunder::BT;
+        tc_refreshedTasks.push_back(task);
+    }
 
     /// No re-assembling magics! crap
-    if (tc_cloudTasks.size() != total_task_num)
+    complete = tc_refreshedTasks.size() == total_task_num;
+    if (! complete)
     {
         reloadCloudTasks (pageNo + 1);
     }
 
-    error (tr("%1 task(s) loaded. (Page %2)").arg(tc_cloudTasks.size()).arg(pageNo), Notice);
-    emit StatusChanged(TaskChanged);
+    error (tr("%1 task(s) loaded. (Page %2)").arg(tc_refreshedTasks.size()).arg(pageNo), Notice);
 
-    return;
+    /// Keep the cached list on screen until the refresh is complete
+    if (complete || ! tc_tasksFromCache)
+    {
+        tc_tasks->setTasks(tc_refreshedTasks);
+        emit StatusChanged(TaskChanged);
+    }
 
-error:
-    error (tr("JSON parse error! Was the protocol changed?"), Warning);
-    return;
+    if (complete)
+    {
+        tc_tasksFromCache = false;
+        tc_cache->storeTasks(tc_tasks->tasks());
+
+        startProgressPolling();
+        scheduleRenewals();
+
+        if (tc_loginStarted)
+        {
+            tc_loginDuration = QDateTime::currentMSecsSinceEpoch() - tc_loginStarted;
+            tc_loginStarted  = 0;
+        }
+    }
 }
 
 void ThunderCore::removeCloudTasks(const QStringList &ids)
 {
-    post (QUrl("http://dynamic.cloud.vip.xunlei.com/interface/task_delete?type=2&callback=a"),
-          "databases=0,&old_databaselist=&old_idlist=&taskids=" + ids.join(",").toAscii());
+    if (ids.isEmpty())
+        return;
+
+    const int ticket = post (QUrl("http://dynamic.cloud.vip.xunlei.com/interface/task_delete?type=2&callback=a"),
+                             "databases=0,&old_databaselist=&old_idlist=&taskids=" + ids.join(",").toAscii(),
+                             TaskDelete);
+
+    QList<quint64> & pending = tc_pendingDeletes[ticket];
+    foreach (const QString & id, ids)
+        pending.append(id.toULongLong());
+}
+
+QNetworkRequest ThunderCore::createRequest(const QUrl &url, ThunderCore::RequestKind kind)
+{
+    QNetworkRequest request (serverUrl(url));
+    request.setAttribute(ATTR_REQUEST_KIND, kind);
+    request.setAttribute(ATTR_REQUEST_START, QDateTime::currentMSecsSinceEpoch());
+
+    return request;
+}
+
+QUrl ThunderCore::serverUrl(const QUrl &url) const
+{
+    if (! tc_baseUrl.isValid())
+        return url;
+
+    QUrl result (url);
+    result.setScheme(tc_baseUrl.scheme());
+    result.setHost(tc_baseUrl.host());
+    result.setPort(tc_baseUrl.port());
+
+    return result;
 }
 
-void ThunderCore::get(const QUrl &url)
+QByteArray ThunderCore::pendingGetKey(const QUrl &url, ThunderCore::RequestKind kind)
 {
-    tc_nam->get(QNetworkRequest(url));
+    return QByteArray::number(kind) + ' ' + url.toEncoded();
+}
+
+int ThunderCore::get(const QUrl &url, ThunderCore::RequestKind kind)
+{
+    /// Identical GETs of the same kind share one reply, handlers notify
+    /// every caller anyway. Keyed by the URL sent as slotFinished() only
+    /// sees that one
+    const QByteArray & key = pendingGetKey(serverUrl(url), kind);
+    int pending = tc_pendingGets.value(key);
+
+    if (pending && tc_scheduler->isActive(pending))
+        return pending;
+
+    int ticket = tc_scheduler->get(createRequest(url, kind), tc_requestLanes[kind]);
+    tc_pendingGets.insert(key, ticket);
+
+    return ticket;
 }
 
 void ThunderCore::uploadBitorrent(const QString &file)
 {
     tmp_btTask.subtasks.clear();
+    postTorrent(file);
+}
 
-    const QByteArray & torrent = Util::readWholeFile(file);
-    const QByteArray & boundary = Util::getRandomString(10).toAscii();
+void ThunderCore::uploadBitorrents(const QStringList &files)
+{
+    QSet<QByteArray> hashes;
+    foreach (const QString & file, files)
+    {
+        /// Unreadable locally, the server decides
+        TorrentFile torrent;
+        if (torrent.load(file))
+        {
+            const Thunder::Task *existing = findTorrentTask(torrent.infoHash());
+            if (existing || hashes.contains(torrent.infoHash()))
+            {
+                error (tr("%1 was added already, skipped.")
+                       .arg(existing ? existing->name : torrent.name()), Notice);
+                continue;
+            }
 
-    QNetworkRequest request (QString("http://dynamic.cloud.vip.xunlei.com/"
-                                     "interface/torrent_upload"));
-    request.setHeader(QNetworkRequest::ContentTypeHeader,
-                      "multipart/form-data; boundary=----" + boundary);
-    tc_nam->post(request, "------" + boundary + "\n"
-                 "Content-Disposition: form-data; "
-                 "name=\"filepath\"; filename=sample.torrent\n"
-                 "Content-Type: application/x-bitorrent\n\n" + torrent +
-                 "Content-Disposition: form-data; name=\"random\"\n\n" +
-                 "13284335922471757912.3826739355\n"
-                 "------" + boundary + "\n");
+            hashes.insert(torrent.infoHash());
+        }
+
+        tc_torrentQueue.append(file);
+    }
+
+    dispatchTorrentUploads();
 }
 
-void ThunderCore::post(const QUrl &url, const QByteArray &body)
+const Thunder::Task *ThunderCore::findTorrentTask(const QByteArray &infoHash)
 {
-    QNetworkRequest request (url);
+    /// BT tasks carry the info-hash as cid, and in their bt:// source
+    const QByteArray & hash = infoHash.toUpper();
+
+    if (const Thunder::Task *task = tc_tasks->findByCid(hash))
+        return task;
+    if (const Thunder::Task *task = tc_tasks->findByCid(hash.toLower()))
+        return task;
+
+    return tc_tasks->findBySource("bt://" + hash);
+}
+
+int ThunderCore::postTorrent(const QString &file)
+{
+    QHttpMultiPart *multiPart = new QHttpMultiPart (QHttpMultiPart::FormDataType);
+
+    /// Read from disk as the request goes out, never held in memory
+    QFile *device = new QFile (file, multiPart);
+    if (! device->open(QIODevice::ReadOnly))
+    {
+        error (tr("Unable to read %1").arg(file), Warning);
+
+        delete multiPart;
+        return 0;
+    }
+
+    QHttpPart torrent;
+    torrent.setHeader(QNetworkRequest::ContentDispositionHeader,
+                      "form-data; name=\"filepath\"; filename=\"sample.torrent\"");
+    torrent.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-bittorrent");
+    torrent.setBodyDevice(device);
+
+    QHttpPart random;
+    random.setHeader(QNetworkRequest::ContentDispositionHeader, "form-data; name=\"random\"");
+    random.setBody("13284335922471757912.3826739355");
+
+    multiPart->append(torrent);
+    multiPart->append(random);
+
+    return tc_scheduler->post(createRequest(QUrl("http://dynamic.cloud.vip.xunlei.com/"
+                                                 "interface/torrent_upload"),
+                                            TorrentUpload),
+                              multiPart,
+                              tc_requestLanes[TorrentUpload]);
+}
+
+void ThunderCore::dispatchTorrentUploads()
+{
+    while (tc_torrentUploads.size() < TORRENT_CONCURRENCY && ! tc_torrentQueue.isEmpty())
+    {
+        const QString & file = tc_torrentQueue.takeFirst();
+
+        int ticket = postTorrent(file);
+        if (ticket)
+            tc_torrentUploads.insert(ticket, file);
+    }
+}
+
+void ThunderCore::finishTorrentUpload(int ticket)
+{
+    if (tc_torrentUploads.remove(ticket))
+        dispatchTorrentUploads();
+}
+
+int ThunderCore::post(const QUrl &url, const QByteArray &body, ThunderCore::RequestKind kind)
+{
+    QNetworkRequest request = createRequest(url, kind);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
 
-    tc_nam->post(request, body);
+    if (tc_recorder)
+        request.setAttribute(TrafficRecorder::BodyAttribute, body);
+
+    return tc_scheduler->post(request, body, tc_requestLanes[kind]);
 }
 
 void ThunderCore::login(const QString &user, const QString &passwd)
 {
     tc_userName = user;
     tc_passwd   = passwd;
+    tc_loginStarted = QDateTime::currentMSecsSinceEpoch();
+
+    if (resumeSession())
+    {
+        error (tr("Checking stored session .."), Info);
+        reloadCloudTasks();
+
+        return;
+    }
+
+    fullLogin();
+}
+
+void ThunderCore::fullLogin()
+{
+    tc_resumingSession = false;
 
     error ("Getting capcha code ..", Info);
     this->get(QString("http://login.xunlei.com/check?u=%1&cachetime=%2")
-              .arg(user)
-              .arg(QString::number(QDateTime::currentMSecsSinceEpoch())));
+              .arg(tc_userName)
+              .arg(QString::number(QDateTime::currentMSecsSinceEpoch())), LoginCheck);
+}
+
+bool ThunderCore::resumeSession()
+{
+    const QByteArray & raw = tc_cache->sessionValue("cookies").toAscii();
+    if (raw.isEmpty())
+        return false;
+
+    const QUrl & url = serverUrl(QUrl("http://dynamic.cloud.vip.xunlei.com/"));
+    QList<QNetworkCookie> cookies;
+
+    foreach (const QByteArray & line, raw.split('\n'))
+    {
+        cookies.append(QNetworkCookie::parseCookies(line));
+    }
+
+    /// Expired cookies are dropped by the jar
+    tc_nam->cookieJar()->setCookiesFromUrl(cookies, url);
+
+    tc_session.clear();
+    foreach (const QNetworkCookie & cookie, tc_nam->cookieJar()->cookiesForUrl(url))
+    {
+        tc_session.insert(cookie.name(), cookie.value());
+    }
+
+    if (! tc_session.contains("jumpkey") || ! tc_session.contains("userid"))
+        return false;
+
+    tc_resumingSession = true;
+    return true;
+}
+
+void ThunderCore::storeSession()
+{
+    QByteArray raw;
+    foreach (const QNetworkCookie & cookie,
+             tc_nam->cookieJar()->cookiesForUrl(
+                 serverUrl(QUrl("http://dynamic.cloud.vip.xunlei.com/"))))
+    {
+        raw += cookie.toRawForm() + "\n";
+    }
+
+    /// Cache file is readable by its owner only
+    tc_cache->setSessionValue("cookies", QString::fromAscii(raw));
+}
+
+void ThunderCore::rejectSession()
+{
+    error (tr("Stored session expired, logging in .."), Info);
+
+    tc_cache->setSessionValue("cookies", QString());
+    tc_session.clear();
+
+    /// The manager owns and deletes the old jar
+    tc_nam->setCookieJar(new QNetworkCookieJar);
+
+    fullLogin();
 }
@@ -32,9 +32,22 @@
 #include <QList>
 #include <QSettings>
 #include <QDateTime>
+#include <QVector>
+#include <QTimer>
+#include <QMap>
+#include <QSet>
+#include <QCoreApplication>
 
 #include "qjson/parser.h"
 #include "CloudObject.h"
+#include "jsonreader.h"
+#include "magnetlink.h"
+#include "requestscheduler.h"
+#include "replaynetworkmanager.h"
+#include "taskcache.h"
+#include "taskstore.h"
+#include "torrentfile.h"
+#include "trafficrecorder.h"
 #include "util.h"
 
 class ThunderCore : public QObject
@@ -83,15 +96,73 @@ public:
         // that call getSingleRemoteTask();
         SingleTaskReady,
 
-        // that call getUploadedBatchTasks();
+        // that call getUploadedBatchTasks(), once per checked chunk
         BatchTaskReady,
 
         // that call getUploadedBTTasks
         BitorrentTaskReady
     };
 
+    /*!
+     * \brief Kind of an outgoing request, selects the reply handler
+     */
+    enum RequestKind
+    {
+        LoginCheck,
+        CapchaImage,
+        Sec2Login,
+        CloudLogin,
+        TaskPage,
+        TaskDelete,
+        TaskCheck,
+        TaskCommit,
+        TorrentUpload,
+        BTTaskCommit,
+        UserHistory,
+        HistoryClear,
+        BTFolder,
+        BatchTaskCheck,
+        BatchTaskCommit,
+        TaskDelay,
+        UrlQuery,
+        TaskProgress,
+
+        RequestKindCount
+    };
+
+    /*!
+     * \brief Outcome of the last task_delay of a task
+     */
+    enum RenewStatus
+    {
+        NotRenewed,
+        RenewPending,
+        Renewed,
+        RenewFailed
+    };
+
+    /*!
+     * \brief Accumulated reply statistics of a request kind
+     */
+    struct RequestStats
+    {
+        RequestStats () : count (0), latency (0), bytes (0) {}
+
+        int count;
+
+        // in msecs
+        qint64 latency;
+        qint64 bytes;
+    };
+
     explicit ThunderCore(QObject *parent = 0);
 
+    /*!
+     * \brief Login, the stored session of the account is tried first
+     *        if loadCachedTasks() was called before
+     * \param user
+     * \param passwd
+     */
     void login (const QString & user, const QString & passwd);
     LoginStatus getLoginStatus ();
     QByteArray getCapchaCode ();
@@ -99,20 +170,75 @@ public:
     QString getCookieFilePath ();
     QString getgdriveid ();
 
-    QList<Thunder::Task> getCloudTasks ();
+    /*!
+     * \brief Show the last known task list of an account, prior to login
+     * \param user
+     */
+    void loadCachedTasks (const QString & user);
+
+    const QList<Thunder::Task> & getCloudTasks ();
+
+    /*!
+     * \brief Indexed view of cloud tasks, see TaskStore
+     * \return
+     */
+    const TaskStore *getTaskStore ();
     QList<Thunder::Task> getGarbagedTasks ();
     void reloadCloudTasks (const int page = 1);
     void addCloudTaskPre (const QString & url);
     void addCloudTaskPost (const Thunder::RemoteTask & task);
+    /*!
+     * \brief Remove tasks with one task_delete, rows of the task store
+     *        go once the server confirms
+     * \param ids
+     */
     void removeCloudTasks (const QStringList & ids);
     void delayCloudTask (const QStringList & ids);
 
+    /*!
+     * \brief Check and commit URLs in chunks of General/BatchChunkSize,
+     *        results of each chunk are reported as BatchTaskReady
+     * \param urls one per line
+     */
     void addBatchTaskPre (const QString & urls);
     void addBatchTaskPost (const QStringList & urls);
 
+    /*!
+     * \brief Whether chunks of the last addBatchTaskPre() are outstanding
+     * \return
+     */
+    bool isBatchCheckPending ();
+
+    /*!
+     * \brief Ask for the files of a magnet link once typing stops,
+     *        half typed links without an info-hash and links already in
+     *        the cloud are ignored
+     * \param url
+     */
     void addMagnetTask (const QString & url);
 
+    /*!
+     * \brief Query several magnet links one after another and add all
+     *        files of each. Links already in the cloud are skipped
+     * \param urls
+     */
+    void addMagnetTasks (const QStringList & urls);
+
     void uploadBitorrent (const QString & file);
+
+    /*!
+     * \brief Upload several torrents and add all files of each,
+     *        a few at a time. Torrents already in the cloud are skipped
+     * \param files
+     */
+    void uploadBitorrents (const QStringList & files);
+
+    /*!
+     * \brief Cloud BT task of a torrent
+     * \param infoHash hex, see TorrentFile::infoHash()
+     * \return 0 if the torrent was never added
+     */
+    const Thunder::Task *findTorrentTask (const QByteArray & infoHash);
     void commitBitorrentTask (const QList<Thunder::BTSubTask> &tasks);
     void getContentsOfBTFolder (const Thunder::Task &bt_task, const int &page);
 
@@ -124,6 +250,37 @@ public:
     void cleanupHistory ();
 
     void loginWithCapcha (const QByteArray & capcha);
+
+    RequestStats getRequestStats (RequestKind kind);
+
+    /*!
+     * \brief Time from the last login to a complete task list
+     * \return msecs, 0 before the list is complete
+     */
+    qint64 getLoginDuration ();
+    RenewStatus getRenewStatus (const QString & taskid);
+
+    /*!
+     * \brief For queue depth and wait time of each lane
+     * \return
+     */
+    RequestScheduler *getScheduler ();
+
+    /*!
+     * \brief Decoders filling structs straight from reply data, they keep
+     *        no state and are benchmarked in contrib/tests
+     */
+    static bool decodeTask (JsonReader & reader, Thunder::Task & task);
+    static bool decodeCloudPage (const QByteArray & body,
+                                 QList<Thunder::Task> & tasks,
+                                 int & total_task_num,
+                                 QString & gdriveid);
+    static bool decodeBTFolderPage (const QByteArray & data,
+                                    Thunder::BitorrentTask & bt_task,
+                                    int & now_page, int & btnum, int & btpernum,
+                                    bool & finished);
+    static bool decodeTorrentUpload (const QByteArray & data, Thunder::BitorrentTask & bt_task);
+    static bool decodeUrlQuery (const QByteArray & data, Thunder::BitorrentTask & bt_task);
     
 signals:
     void error (const QString & body, ThunderCore::ErrorCategory category);
@@ -154,8 +311,29 @@ signals:
      */
     void CookiesReady (const QString & tdcookie);
 
+    /*!
+     * \brief Progress or download link of a single task changed
+     * \param task
+     */
+    void CloudTaskUpdated (const Thunder::Task & task);
+
+    /*!
+     * \brief An offline download just completed, emitted once per task
+     * \param task
+     */
+    void CloudTaskFinished (const Thunder::Task & task);
+
 private:
-    QList<Thunder::Task> tc_cloudTasks, tc_garbagedTasks;
+    TaskStore *tc_tasks;
+    QList<Thunder::Task> tc_garbagedTasks;
+
+    /*!
+     * \brief Pages of an ongoing refresh, swapped into tc_tasks when complete
+     */
+    QList<Thunder::Task> tc_refreshedTasks;
+    bool tc_tasksFromCache;
+    TaskCache *tc_cache;
+
     void parseCloudPage (const QByteArray & body, int pageNo, const QString &timestamp);
     void parseCloudTaskData (const QByteArray & jsonp);
     bool tmp_cookieIsStored;
@@ -170,14 +348,251 @@ private:
     LoginStatus tc_loginStatus;
     QByteArray tc_capcha;
 
+    /*!
+     * \brief Whether the first task page validates stored cookies
+     */
+    bool tc_resumingSession;
+
+    /*!
+     * \brief Reuse cookies of the last login, stored in the task cache
+     * \return false if there's nothing to reuse
+     */
+    bool resumeSession ();
+    void storeSession ();
+
+    /*!
+     * \brief Stored cookies were rejected, drop them and login from scratch
+     */
+    void rejectSession ();
+    void fullLogin ();
+
     QString tc_timeStampForCloudTasks;
     
     QNetworkAccessManager *tc_nam;
-    void get (const QUrl & url);
-    void post (const QUrl & url, const QByteArray & body);
+    QNetworkRequest createRequest (const QUrl & url, RequestKind kind);
+
+    /*!
+     * \brief Replays a capture given by --replay-traffic FILE instead of
+     *        going online, timed as captured with --replay-timed
+     */
+    QNetworkAccessManager *createNetworkManager ();
+
+    /*!
+     * \brief Capture of --record-traffic FILE, 0 if not recording
+     */
+    TrafficRecorder *tc_recorder;
+
+    /*!
+     * \brief Server/BaseUrl setting, replaces every Xunlei host when set,
+     *        e.g. http://127.0.0.1:8080 for contrib/mockserver
+     */
+    QUrl tc_baseUrl;
+    QUrl serverUrl (const QUrl & url) const;
+
+    /*!
+     * \brief Start of the last login in msecs, 0 once the task list is complete
+     */
+    qint64 tc_loginStarted;
+
+    // msecs from the last login to a complete task list
+    qint64 tc_loginDuration;
+    RequestScheduler *tc_scheduler;
+    static const RequestScheduler::Lane tc_requestLanes[RequestKindCount];
+
+    /*!
+     * \brief Queue a request in the lane of its kind
+     * \return scheduler ticket
+     */
+    int get (const QUrl & url, RequestKind kind);
+    int post (const QUrl & url, const QByteArray & body, RequestKind kind);
+
+    /*!
+     * \brief Sub tasks of a BT task, fetched on demand
+     */
+    struct BTFolderEntry
+    {
+        BTFolderEntry () : pages (1), delivered (0) {}
+
+        QString cid;
+        QList<Thunder::BTSubTask> subtasks;
+
+        // invalid until all pages arrived
+        QDateTime fetched;
+
+        int pages, delivered;
+
+        // pages arrived ahead of their predecessors
+        QMap<int, QList<Thunder::BTSubTask> > arrived;
+        QList<int> tickets;
+    };
+
+    QHash<QString, BTFolderEntry> tc_btFolders;
+
+    bool isBTFolderLoading (const QString & taskid);
+
+    /*!
+     * \brief GETs in flight by kind and encoded url, identical requests
+     *        are merged
+     */
+    QHash<QByteArray, int> tc_pendingGets;
+
+    /*!
+     * \brief Key of tc_pendingGets, the kind picks the handler of the reply
+     * \param url as sent, after serverUrl()
+     * \param kind
+     */
+    static QByteArray pendingGetKey (const QUrl & url, RequestKind kind);
+
+    /*!
+     * \brief Forget what was kept for a request cancelled on purpose,
+     *        queued or in flight
+     * \param request
+     */
+    void abandonRequest (const QNetworkRequest & request);
+
+    /*!
+     * \brief Latest request of a kind, see supersede()
+     */
+    QHash<int, int> tc_latestReplies;
+
+    /*!
+     * \brief Abort the previous request of the same kind, its result is stale
+     * \param kind
+     * \param ticket
+     */
+    void supersede (RequestKind kind, int ticket);
+
+    QString tc_pendingTaskCheck, tc_pendingUrlQuery;
+    QTimer tc_taskCheckTimer, tc_urlQueryTimer, tc_reloadTimer;
+
+    /*!
+     * \brief Slice of a batch check or commit, retried on its own
+     */
+    struct BatchChunk
+    {
+        BatchChunk () : kind (BatchTaskCheck), attempts (0) {}
+
+        RequestKind kind;
+        QStringList urls;
+        int attempts;
+    };
+
+    QList<BatchChunk> tc_batchQueue;
+    QHash<int, BatchChunk> tc_batchInFlight;
+    int tc_batchChunkSize;
+
+    void queueBatchChunks (const QStringList & urls, RequestKind kind);
+    void dispatchBatchChunks ();
+    void cancelBatchChunks (RequestKind kind);
+    void retryBatchChunk (int ticket);
+
+    /*!
+     * \brief Torrents of uploadBitorrents(), waiting and in flight by ticket
+     */
+    QStringList tc_torrentQueue;
+    QHash<int, QString> tc_torrentUploads;
+
+    int postTorrent (const QString & file);
+    void dispatchTorrentUploads ();
+    void finishTorrentUpload (int ticket);
+
+    /*!
+     * \brief Magnets of addMagnetTasks(), waiting and in flight by ticket
+     */
+    QStringList tc_magnetQueue;
+    QHash<int, QString> tc_magnetQueries;
+
+    QUrl magnetQueryUrl (const QString & url);
+    void dispatchMagnetQueries ();
+    void finishMagnetQuery (int ticket);
+
+    /*!
+     * \brief Task ids of task_delete requests in flight, by ticket
+     */
+    QHash<int, QList<quint64> > tc_pendingDeletes;
+    void finishTaskDelete (int ticket, bool removed);
+    void commitBitorrentTask (const Thunder::BitorrentTask & bt_task,
+                              const QList<Thunder::BTSubTask> & tasks);
+
+    /*!
+     * \brief Reload page 1 shortly, merging requests in between
+     */
+    void scheduleReload ();
+
+    /*!
+     * \brief Polls unfinished tasks, the interval doubles while nothing changes
+     */
+    QTimer tc_progressTimer;
+    int tc_progressInterval;
+
+    void startProgressPolling ();
+
+    /*!
+     * \brief Renewal state of a task, kept across refreshes
+     */
+    struct Renewal
+    {
+        Renewal () : status (NotRenewed), attempted (0) {}
+
+        RenewStatus status;
+
+        // secs since epoch
+        qint64 attempted;
+    };
+
+    QHash<QString, Renewal> tc_renewals;
+    QTimer tc_renewTimer;
+
+    /*!
+     * \brief Arm the timer for the earliest task to be renewed
+     */
+    void scheduleRenewals ();
+
+    /*!
+     * \brief When a task should be renewed next
+     * \param task
+     * \return secs since epoch, 0 if nothing to do
+     */
+    qint64 renewalDueAt (const Thunder::Task & task);
+    QStringList trackRenewals (const QUrl & url, RenewStatus status);
+    bool decodeTaskDelay (const QByteArray & data,
+                          int & result,
+                          QHash<QString, int> & results,
+                          QHash<QString, int> & liveTimes);
+    bool decodeTaskProgress (const QByteArray & data, QList<Thunder::Task> & records);
+
+    typedef void (ThunderCore::*ReplyHandler) (QNetworkReply *reply, const QByteArray & data);
+    static const ReplyHandler tc_replyHandlers[RequestKindCount];
+    QVector<RequestStats> tc_requestStats;
+
+    void handleLoginCheck (QNetworkReply *reply, const QByteArray & data);
+    void handleCapchaImage (QNetworkReply *reply, const QByteArray & data);
+    void handleSec2Login (QNetworkReply *reply, const QByteArray & data);
+    void handleCloudLogin (QNetworkReply *reply, const QByteArray & data);
+    void handleTaskPage (QNetworkReply *reply, const QByteArray & data);
+    void handleTaskDelete (QNetworkReply *reply, const QByteArray & data);
+    void handleTaskCheck (QNetworkReply *reply, const QByteArray & data);
+    void handleTaskCommit (QNetworkReply *reply, const QByteArray & data);
+    void handleTorrentUpload (QNetworkReply *reply, const QByteArray & data);
+    void handleBTTaskCommit (QNetworkReply *reply, const QByteArray & data);
+    void handleUserHistory (QNetworkReply *reply, const QByteArray & data);
+    void handleHistoryClear (QNetworkReply *reply, const QByteArray & data);
+    void handleBTFolder (QNetworkReply *reply, const QByteArray & data);
+    void handleBatchTaskCheck (QNetworkReply *reply, const QByteArray & data);
+    void handleBatchTaskCommit (QNetworkReply *reply, const QByteArray & data);
+    void handleTaskDelay (QNetworkReply *reply, const QByteArray & data);
+    void handleUrlQuery (QNetworkReply *reply, const QByteArray & data);
+    void handleTaskProgress (QNetworkReply *reply, const QByteArray & data);
 
 private slots:
     void slotFinished (QNetworkReply *reply);
+    void slotRequestCancelled (int ticket, const QNetworkRequest & request);
+
+    void slotQueryTaskCheck ();
+    void slotQueryMagnet ();
+    void slotReloadCloudTasks ();
+    void slotPollProgress ();
+    void slotRenewTasks ();
 
 public slots:
     /*!
@@ -187,6 +602,19 @@ public slots:
     void setCapcha (const QString & code);
 
     void loadSettings ();
+
+    /*!
+     * \brief Fetch sub tasks of a BT task, served from cache while fresh
+     * \param taskid
+     * \param cid
+     */
+    void fetchBTFolder (const QString & taskid, const QString & cid);
+
+    /*!
+     * \brief Abort an unfinished fetchBTFolder()
+     * \param taskid
+     */
+    void cancelBTFolder (const QString & taskid);
 };
 
 #endif // THUNDERCORE_H
@@ -19,10 +19,15 @@
 #include "thunderpanel.h"
 #include "ui_thunderpanel.h"
 
-#define OFFSET_DOWNLOAD 1
-#define OFFSET_SOURCE 2
-#define OFFSET_TASKID 3
-#define OFFSET_TYPE 4
+#define OFFSET_DOWNLOAD (TaskTreeModel::DownloadRole - Qt::UserRole)
+#define OFFSET_SOURCE (TaskTreeModel::SourceRole - Qt::UserRole)
+
+// rows above and below the viewport whose BT folders are loaded too
+#define BT_PREFETCH_ROWS 10
+
+// sub tasks are added in chunks for at most this many ms per event loop pass
+#define POPULATE_BUDGET 10
+#define POPULATE_CHUNK 256
 
 // On windows only double quote is escaped
 #ifdef Q_WS_WIN
@@ -48,9 +53,12 @@ ThunderPanel::ThunderPanel(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::ThunderPanel),
     my_quickViewMode(true),
-    my_filterModel(new QSortFilterProxyModel),
-    my_model(new QStandardItemModel),
+    my_store(0),
+    my_subtaskQueueOffset(0),
+    my_filterModel(new SearchFilterModel (TaskTreeModel::TaskIdRole)),
+    my_model(new TaskTreeModel (this)),
     displayFilterMode(ThunderPanel::FilterWithRegex),
+    my_searchQueued(false),
     my_contextMenu(new QMenu(this))
 {
     ui->setupUi(this);
@@ -116,9 +124,6 @@ ThunderPanel::ThunderPanel(QWidget *parent) :
     connect (ui->treeView, SIGNAL(customContextMenuRequested(QPoint)),
              SLOT(slotShowContextMenu(QPoint)));
 
-    my_model->setHorizontalHeaderLabels(QStringList()
-                                        << tr("Size")
-                                        << tr("Name"));
     my_filterModel->setSourceModel(my_model);
     my_filterModel->setFilterKeyColumn(1);
     my_filterModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
@@ -127,11 +132,28 @@ ThunderPanel::ThunderPanel(QWidget *parent) :
     ui->treeView->resizeColumnToContents(0);
     connect (ui->treeView, SIGNAL(expanded(QModelIndex)), SLOT(slotResizeFirstColumnOfTreeView()));
 
+    /// Sub tasks of BT folders are loaded once they are visible
+    my_visibilityTimer.setSingleShot(true);
+    my_visibilityTimer.setInterval(150);
+    connect (&my_visibilityTimer, SIGNAL(timeout()), SLOT(slotScanVisibleBTFolders()));
+
+    my_populateTimer.setInterval(0);
+    connect (&my_populateTimer, SIGNAL(timeout()), SLOT(slotPopulateBTFolders()));
+
+    connect (my_model, SIGNAL(fetchRequested(QModelIndex)), SLOT(slotFetchBTFolder(QModelIndex)));
+    connect (my_model, SIGNAL(modelReset()), SLOT(slotTasksReset()));
+    connect (ui->treeView->verticalScrollBar(), SIGNAL(valueChanged(int)),
+             SLOT(slotScheduleVisibilityScan()));
+    connect (my_filterModel, SIGNAL(layoutChanged()), SLOT(slotScheduleVisibilityScan()));
+
+    connect (&my_searchWatcher, SIGNAL(finished()), SLOT(slotSearchFinished()));
+
     loadSettings();
 }
 
 ThunderPanel::~ThunderPanel()
 {
+    my_searchWatcher.waitForFinished();
     delete ui;
 }
 
@@ -214,20 +236,11 @@ Thunder::BitorrentTask ThunderPanel::getBTSubTask()
 {
     Thunder::BitorrentTask task;
 
-    QModelIndex currentIndex = my_filterModel->mapToSource(
+    const QModelIndex & currentIndex = my_filterModel->mapToSource(
                 ui->treeView->currentIndex());
 
-    /// BUG: fail if child items are invisible
-    QStandardItem *currentItem = my_model->itemFromIndex(currentIndex);
-    for (int row = 0; row < currentItem->rowCount(); ++ row)
-    {
-        Thunder::BTSubTask subTask;
-        subTask.link = currentItem->child(row, 0)->data
-                (Qt::UserRole + OFFSET_DOWNLOAD).toString();
-        subTask.name = currentItem->child(row, 1)->text();
-
-        task.subtasks.append(subTask);
-    }
+    /// Loaded sub tasks, including the ones hidden by the filter
+    task.subtasks = my_model->subtasks(currentIndex.sibling(currentIndex.row(), 0));
 
     return task;
 }
@@ -334,7 +347,7 @@ Thunder::RemoteTask ThunderPanel::getFirstSelectedTask ()
         idx  = my_filterModel->mapToSource(idx);
         idx2 = my_filterModel->mapToSource(idx2);
 
-        task.url  = my_model->data(idx, Qt::UserRole + OFFSET_DOWNLOAD).toString();
+        task.url  = my_model->data(idx, TaskTreeModel::DownloadRole).toString();
         task.name = my_model->data(idx2).toString();
     }
 
@@ -372,28 +385,19 @@ QString ThunderPanel::getUserDataByOffset (unsigned long long offset, int row)
     return QString ();
 }
 
-void ThunderPanel::removeSelectedTasks (const QList<int> &ids)
-{
-    foreach (const int & row, ids)
-    {
-        my_filterModel->removeRow(row);
-    }
-}
-
-QPair<QStringList, QList<int> > ThunderPanel::getSelectedTaskIDsAndRows()
+QStringList ThunderPanel::getSelectedTaskIds()
 {
-    QPair<QStringList, QList<int> > result;
+    QStringList ids;
 
     foreach (const QModelIndex & idx,
              ui->treeView->selectionModel()->selectedIndexes())
         if (! idx.parent().isValid()
                 && idx.column() == 0)
         {
-            result.first.append(getUserDataByOffset(OFFSET_TASKID, idx.row()));
-            result.second.push_back(idx.row());
+            ids.append(idx.data(TaskTreeModel::TaskIdRole).toString());
         }
 
-    return result;
+    return ids;
 }
 
 void ThunderPanel::slotCopyDownloadAddress()
@@ -410,71 +414,151 @@ void ThunderPanel::slotCopySourceAddress()
 
 void ThunderPanel::setBTSubTask(const Thunder::BitorrentTask &task)
 {
-    if (! my_BTSubTaskMapping.contains(task.taskid))
+    /// Pages queued before a new first page are stale, the one being shown
+    /// is replaced anyway
+    if (task.page <= 1)
     {
-        qDebug() << "Mismatch: " << task.taskid;
-        return;
+        for (int i = my_subtaskQueue.size() - 1; i > 0; --i)
+        {
+            if (my_subtaskQueue.at(i).taskid == task.taskid)
+                my_subtaskQueue.removeAt(i);
+        }
     }
 
-    foreach (const Thunder::BTSubTask & subtask, task.subtasks)
+    my_subtaskQueue.append(task);
+
+    if (! my_populateTimer.isActive())
+        my_populateTimer.start();
+}
+
+void ThunderPanel::slotPopulateBTFolders()
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    while (! my_subtaskQueue.isEmpty() && elapsed.elapsed() < POPULATE_BUDGET)
     {
-        QList<QStandardItem*> items = QList<QStandardItem*>()
-                << new QStandardItem (subtask.size)
-                << new QStandardItem (subtask.name);
+        /// A copy, views may bring in more pages while rows are added
+        const Thunder::BitorrentTask task = my_subtaskQueue.first();
+        const quint64 id = task.taskid.toULongLong();
+
+        const int offset = my_subtaskQueueOffset;
+        const QList<Thunder::BTSubTask> & chunk = task.subtasks.mid(offset, POPULATE_CHUNK);
+        const bool last = offset + chunk.size() >= task.subtasks.size();
+
+        /// Page 1 replaces what was shown before
+        const int firstRow = my_model->setSubtasks(id, offset == 0 && task.page <= 1,
+                                                   chunk, last && task.complete);
+        if (firstRow < 0)
+            qDebug() << "Mismatch: " << task.taskid;
+        else
+            my_searchIndex.setSubtasks(id, firstRow, chunk);
+
+        /// Reset meanwhile
+        if (my_subtaskQueue.isEmpty())
+            break;
 
-        items.first()->setIcon(Util::getFileAttr(subtask.name, false).icon);
+        if (last || firstRow < 0)
+        {
+            my_subtaskQueue.removeFirst();
+            my_subtaskQueueOffset = 0;
+        }
+        else
+            my_subtaskQueueOffset += chunk.size();
+    }
 
-        items.first()->setData(subtask.link, Qt::UserRole + OFFSET_DOWNLOAD);
-        //        items.first()->setData(subtask.id,     Qt::UserRole + OFFSET_TASKID);
+    if (! my_subtaskQueue.isEmpty())
+        return;
 
-        for (int i = 0; i < items.size(); ++i)
-            items.at(i)->setTextAlignment(Qt::AlignCenter);
+    my_populateTimer.stop();
 
-        if (subtask.link.isEmpty())
-            items.at(1)->setBackground(QBrush (QColor("#9CC6EE")));
+    /// New sub tasks may match the running search, ask once all are in
+    if (my_filterModel->hasResult())
+        startSearch(ui->filter->text());
+}
 
-        my_BTSubTaskMapping.value(task.taskid)->appendRow(items);
-    }
+void ThunderPanel::slotScheduleVisibilityScan()
+{
+    my_visibilityTimer.start();
 }
 
-void ThunderPanel::setCloudTasks(const QList<Thunder::Task> &tasks)
+void ThunderPanel::slotFetchBTFolder(const QModelIndex &folder)
 {
-    my_model->setRowCount(0);
-    my_BTSubTaskMapping.clear();
+    const QString & taskid = folder.data(TaskTreeModel::TaskIdRole).toString();
+    my_wantedBTFolders.insert(taskid);
+    emit BTFolderWanted(taskid, folder.data(TaskTreeModel::CidRole).toString());
+}
 
-    foreach (const Thunder::Task & task, tasks)
-    {
-        QList<QStandardItem*> items = QList<QStandardItem*>()
-                << new QStandardItem (Util::toReadableSize(task.size))
-                << new QStandardItem (task.name);
+void ThunderPanel::slotScanVisibleBTFolders()
+{
+    int rows = my_filterModel->rowCount();
+    if (rows == 0)
+        return;
 
-        my_model->appendRow(items);
+    /// Top level rows in view, plus a small window around
+    QModelIndex first = ui->treeView->indexAt(QPoint (0, 0));
+    QModelIndex last  = ui->treeView->indexAt(QPoint (0, ui->treeView->viewport()->height() - 1));
 
-        items.first()->setIcon(Util::getFileAttr(task.name,
-                                                 task.type == Thunder::BT).icon);
+    while (first.parent().isValid()) first = first.parent();
+    while (last.parent().isValid()) last = last.parent();
 
-        items.first()->setData(task.link,   Qt::UserRole + OFFSET_DOWNLOAD);
-        items.first()->setData(task.id,     Qt::UserRole + OFFSET_TASKID);
-        items.first()->setData(task.source, Qt::UserRole + OFFSET_SOURCE);
-        items.first()->setData(task.type,   Qt::UserRole + OFFSET_TYPE);
+    int firstRow = qMax (0, (first.isValid() ? first.row() : 0) - BT_PREFETCH_ROWS);
+    int lastRow  = qMin (rows - 1, (last.isValid() ? last.row() : rows - 1) + BT_PREFETCH_ROWS);
 
-        for (int i = 0; i < items.size(); ++i)
-        {
-            if (task.link.isEmpty() && i == 1 && task.type != Thunder::BT)
-            {
-                items.at(i)->setBackground(QBrush (QColor("#9CC6EE")));
-                items.at(i)->setToolTip(QString ("Progress: %1%").arg(task.progress));
-            }
-            items.at(i)->setTextAlignment(Qt::AlignCenter);
-        }
+    QSet<QString> visible;
+    for (int row = firstRow; row <= lastRow; ++ row)
+    {
+        const QModelIndex & folder = my_filterModel->mapToSource(my_filterModel->index(row, 0));
+        if (! my_model->isLoading(folder))
+            continue;
 
-        if (task.type == Thunder::BT)
-        {
-            my_BTSubTaskMapping.insert(task.id, items.first());
-        }
+        const QString & taskid = folder.data(TaskTreeModel::TaskIdRole).toString();
+        visible.insert(taskid);
+
+        if (! my_wantedBTFolders.contains(taskid))
+            emit BTFolderWanted(taskid, folder.data(TaskTreeModel::CidRole).toString());
     }
 
+    foreach (const QString & taskid, my_wantedBTFolders)
+    {
+        if (! visible.contains(taskid))
+            emit BTFolderUnwanted(taskid);
+    }
+
+    my_wantedBTFolders = visible;
+}
+
+void ThunderPanel::setTaskStore(const TaskStore *store)
+{
+    my_store = store;
+    my_model->setTaskStore(store);
+
+    connect (my_store, SIGNAL(tasksRemoved(QList<quint64>)), SLOT(slotTasksRemoved(QList<quint64>)));
+}
+
+void ThunderPanel::slotTasksRemoved(const QList<quint64> &ids)
+{
+    my_searchIndex.removeTasks(ids);
+    slotScheduleVisibilityScan();
+}
+
+void ThunderPanel::slotTasksReset()
+{
+    /// Folders start over, their sub tasks are fetched again when visible
+    my_wantedBTFolders.clear();
+    my_subtaskQueue.clear();
+    my_subtaskQueueOffset = 0;
+    my_populateTimer.stop();
+
+    foreach (int row, my_store->rowsOfType(Thunder::BT))
+        my_searchIndex.setSubtasks(my_store->at(row).id, 0, QList<Thunder::BTSubTask> ());
+
+    my_searchIndex.setTasks(my_store->tasks());
+    if (my_filterModel->hasResult())
+        startSearch(ui->filter->text());
+
     ui->treeView->resizeColumnToContents(0);
+    slotScheduleVisibilityScan();
 }
 
 void ThunderPanel::on_treeView_doubleClicked(const QModelIndex &index)
@@ -504,13 +588,21 @@ void ThunderPanel::loadSettings()
 {
     QSettings settings;
     settings.beginGroup("General");
-    displayFilterMode = (DisplayFilterMode) settings.value("DisplayFilterMode", 0).toInt();
+    displayFilterMode = (DisplayFilterMode) settings.value("DisplayFilterMode", FilterWithRegex).toInt();
     my_downloaderScriptTemplate = settings.value("DownloaderScriptTemplate",
                                                  TC_DEFAULT_DOWNLOAD_TEMPLATE).toString();
 }
 
 void ThunderPanel::on_filter_textChanged(const QString &arg1)
 {
+    if (displayFilterMode == FilterWithIndex)
+    {
+        startSearch(arg1);
+        return;
+    }
+
+    my_filterModel->clearResult();
+
     switch (displayFilterMode)
     {
     case FilterWithRegex:
@@ -526,6 +618,63 @@ void ThunderPanel::on_filter_textChanged(const QString &arg1)
         Q_ASSERT(false);
         break;
     }
+
+    slotScheduleVisibilityScan();
+}
+
+void ThunderPanel::startSearch(const QString &text)
+{
+    my_pendingSearch = text;
+
+    /// Patterns of the other modes would hide rows too
+    if (! my_filterModel->filterRegExp().isEmpty())
+        my_filterModel->setFilterFixedString(QString());
+
+    if (text.trimmed().isEmpty())
+    {
+        my_filterModel->clearResult();
+        return;
+    }
+
+    /// Picked up by slotSearchFinished
+    if (my_searchWatcher.isRunning())
+    {
+        my_searchQueued = true;
+        return;
+    }
+
+    my_searchWatcher.setFuture(QtConcurrent::run(&my_searchIndex, &SearchIndex::query, text));
+}
+
+void ThunderPanel::slotSearchFinished()
+{
+    /// Text or index changed meanwhile
+    if (my_searchQueued)
+    {
+        my_searchQueued = false;
+        startSearch(my_pendingSearch);
+        return;
+    }
+
+    const SearchIndex::Result & result = my_searchWatcher.result();
+    if (my_pendingSearch.trimmed().isEmpty())
+        return;
+
+    my_filterModel->setResult(result);
+
+    /// Reveal matching files of folders that don't match by themselves
+    QHash<quint64, QSet<int> >::const_iterator it = result.subtasks.constBegin();
+    for (; it != result.subtasks.constEnd(); ++it)
+    {
+        if (result.tasks.contains(it.key()))
+            continue;
+
+        const QModelIndex & index = my_model->indexOfTask(it.key());
+        if (index.isValid())
+            ui->treeView->expand(my_filterModel->mapFromSource(index));
+    }
+
+    slotScheduleVisibilityScan();
 }
 
 void ThunderPanel::on_toolButton_clicked()
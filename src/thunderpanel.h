@@ -20,7 +20,6 @@
 #define THUNDERPANEL_H
 
 #include <QWidget>
-#include <QStandardItemModel>
 #include <QSettings>
 #include <QMenu>
 #include <QHash>
@@ -30,12 +29,20 @@
 #include <QApplication>
 #include <QKeyEvent>
 #include <QClipboard>
-#include <QStandardItem>
+#include <QScrollBar>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QtConcurrentRun>
+#include <QFutureWatcher>
 #include <QDebug>
 
 #include "CloudObject.h"
 #include "util.h"
 #include "config.h"
+#include "searchindex.h"
+#include "taskstore.h"
+#include "tasktreemodel.h"
 
 namespace Ui {
 class ThunderPanel;
@@ -63,7 +70,8 @@ public:
     {
         FilterWithRegex         = 0,
         FilterWithWildcard      = 1,
-        FilterWithFixedString   = 2
+        FilterWithFixedString   = 2,
+        FilterWithIndex         = 3
     };
 
     explicit ThunderPanel(QWidget *parent = 0);
@@ -74,13 +82,19 @@ public:
 
     void setQuickViewMode (bool ok);
 
-    void setCloudTasks (const QList<Thunder::Task> & tasks);
+    /*!
+     * \brief Show the tasks of a store, and follow its changes
+     * \param store
+     */
+    void setTaskStore (const TaskStore *store);
     QPair<QString, int> getTasksAsScript();
 
     Thunder::BitorrentTask getBTSubTask ();
 
-    QPair<QStringList, QList<int> > getSelectedTaskIDsAndRows ();
-    void removeSelectedTasks (const QList<int> & ids);
+    /*!
+     * \brief Ids of the selected tasks, sub tasks of BT folders aside
+     */
+    QStringList getSelectedTaskIds ();
     Thunder::RemoteTask getFirstSelectedTask ();
 
     void keyEvent (QKeyEvent *e);
@@ -95,18 +109,34 @@ signals:
                      bool autoOpen);
     void doIndirectRequest (ThunderPanel::IndirectRequestType type);
 
+    /*!
+     * \brief A BT folder came into view (or is about to), sub tasks wanted
+     */
+    void BTFolderWanted (const QString & taskid, const QString & cid);
+    void BTFolderUnwanted (const QString & taskid);
+
 private:
     Ui::ThunderPanel *ui;
     bool my_quickViewMode;
     QString my_gdriveid;
 
+    const TaskStore *my_store;
+
     /*!
-     * \brief Mapping between task id and sub tasks of a BT task
+     * \brief BT folders being loaded for being visible
      */
-    QHash<QString, QStandardItem*> my_BTSubTaskMapping;
+    QSet<QString> my_wantedBTFolders;
+    QTimer my_visibilityTimer;
 
-    QSortFilterProxyModel *my_filterModel;
-    QStandardItemModel *my_model;
+    /*!
+     * \brief Pages of sub tasks waiting to be shown, a slice per event loop pass
+     */
+    QList<Thunder::BitorrentTask> my_subtaskQueue;
+    int my_subtaskQueueOffset;
+    QTimer my_populateTimer;
+
+    SearchFilterModel *my_filterModel;
+    TaskTreeModel *my_model;
     DisplayFilterMode  displayFilterMode;
 
     /*!
@@ -117,6 +147,20 @@ private:
      */
     QString getUserDataByOffset (unsigned long long offset, int row = -1);
 
+    /*!
+     * \brief Names of tasks and loaded sub tasks, for FilterWithIndex
+     */
+    SearchIndex my_searchIndex;
+    QFutureWatcher<SearchIndex::Result> my_searchWatcher;
+
+    /*!
+     * \brief Latest filter text, searched once the running query is done
+     */
+    QString my_pendingSearch;
+    bool my_searchQueued;
+
+    void startSearch (const QString & text);
+
     QMenu *my_contextMenu;
 
 private slots:
@@ -136,6 +180,14 @@ private slots:
     void slotResizeFirstColumnOfTreeView();
     void slotResizeAllColumnsOfTreeView();
 
+    void slotScheduleVisibilityScan ();
+    void slotScanVisibleBTFolders ();
+    void slotFetchBTFolder (const QModelIndex & folder);
+    void slotTasksReset ();
+    void slotTasksRemoved (const QList<quint64> & ids);
+    void slotPopulateBTFolders ();
+    void slotSearchFinished ();
+
     void on_treeView_doubleClicked(const QModelIndex &index);
     void on_filter_textChanged(const QString &arg1);
     void on_toolButton_clicked();
@@ -0,0 +1,165 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "torrentfile.h"
+#include "bencodereader.h"
+#include "util.h"
+
+#include <QFile>
+#include <QCryptographicHash>
+
+TorrentFile::TorrentFile() :
+    my_totalSize (0)
+{
+}
+
+bool TorrentFile::load(const QString &path)
+{
+    my_infoHash.clear();
+    my_name.clear();
+    my_totalSize = 0;
+    my_files.clear();
+
+    QFile file (path);
+    if (! file.open(QIODevice::ReadOnly) || file.size() == 0)
+        return false;
+
+    const uchar *data = file.map(0, file.size());
+    if (data)
+    {
+        bool ok = parse ((const char*) data, (const char*) data + file.size());
+        file.unmap((uchar*) data);
+
+        return ok;
+    }
+
+    /// Not mappable, i.e a pipe
+    const QByteArray & contents = file.readAll();
+    return parse (contents.constData(), contents.constData() + contents.size());
+}
+
+bool TorrentFile::parse(const char *begin, const char *end)
+{
+    BencodeReader reader (begin, end);
+    BencodeReader::Slice key, info;
+
+    reader.beginDict();
+    while (reader.nextKey(key))
+    {
+        if (key == "info")
+            info = reader.raw();
+        else
+            reader.skipValue();
+    }
+
+    if (reader.hasError() || ! info.data)
+        return false;
+
+    my_infoHash = QCryptographicHash::hash(info.toRawData(), QCryptographicHash::Sha1)
+            .toHex().toUpper();
+
+    /// Second pass over the info dictionary only
+    BencodeReader dict (info.data, info.data + info.size);
+    bool singleFile = true;
+    unsigned long long length = 0;
+    QString utf8Name;
+
+    dict.beginDict();
+    while (dict.nextKey(key))
+    {
+        if (key == "name")
+            my_name = dict.readString().toString();
+        else if (key == "name.utf-8")
+            utf8Name = dict.readString().toString();
+        else if (key == "length")
+            length = dict.readInteger();
+        else if (key == "files" && dict.beginList())
+        {
+            singleFile = false;
+
+            while (dict.nextElement() && dict.beginDict())
+            {
+                Entry entry;
+                entry.size = 0;
+
+                QStringList parts, utf8Parts;
+                while (dict.nextKey(key))
+                {
+                    if (key == "length")
+                        entry.size = dict.readInteger();
+                    else if ((key == "path" || key == "path.utf-8") && dict.beginList())
+                    {
+                        QStringList & target = key == "path" ? parts : utf8Parts;
+                        while (dict.nextElement())
+                            target.append(dict.readString().toString());
+                    }
+                    else
+                        dict.skipValue();
+                }
+
+                entry.path = (utf8Parts.isEmpty() ? parts : utf8Parts).join("/");
+                my_totalSize += entry.size;
+                my_files.append(entry);
+            }
+        }
+        else
+            dict.skipValue();
+    }
+
+    if (dict.hasError())
+        return false;
+
+    if (! utf8Name.isEmpty())
+        my_name = utf8Name;
+
+    if (singleFile)
+    {
+        Entry entry;
+        entry.path = my_name;
+        entry.size = length;
+
+        my_totalSize = length;
+        my_files.append(entry);
+    }
+
+    return true;
+}
+
+Thunder::BitorrentTask TorrentFile::toBitorrentTask() const
+{
+    Thunder::BitorrentTask task;
+    task.ftitle = my_name;
+    task.infoid = QString::fromAscii(my_infoHash);
+    task.btsize = my_totalSize;
+    task.page = 1;
+    task.complete = true;
+
+    for (int i = 0; i < my_files.size(); ++i)
+    {
+        Thunder::BTSubTask sub;
+        sub.id          = QString::number(i);
+        sub.name        = my_files.at(i).path;
+        sub.size        = QString::number(my_files.at(i).size);
+        sub.format_size = Util::toReadableSize(my_files.at(i).size);
+        sub.findex      = QString::number(i);
+
+        task.subtasks.append(sub);
+    }
+
+    return task;
+}
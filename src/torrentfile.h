@@ -0,0 +1,70 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TORRENTFILE_H
+#define TORRENTFILE_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+#include "CloudObject.h"
+
+/*!
+ * \brief Local view of a .torrent, read without any upload
+ *
+ *        The file is memory mapped and parsed in place, only names and
+ *        the SHA-1 info-hash are allocated.
+ */
+class TorrentFile
+{
+public:
+    struct Entry
+    {
+        QString path;
+        unsigned long long size;
+    };
+
+    TorrentFile ();
+
+    bool load (const QString & path);
+
+    /*!
+     * \brief Info-hash in upper case hex, as used by cloud BT tasks
+     */
+    QByteArray infoHash () const { return my_infoHash; }
+    QString name () const { return my_name; }
+    unsigned long long totalSize () const { return my_totalSize; }
+    const QList<Entry> & files () const { return my_files; }
+
+    /*!
+     * \brief Same shape as a torrent_upload reply, file index in torrent order
+     * \return
+     */
+    Thunder::BitorrentTask toBitorrentTask () const;
+
+private:
+    QByteArray my_infoHash;
+    QString my_name;
+    unsigned long long my_totalSize;
+    QList<Entry> my_files;
+
+    bool parse (const char *begin, const char *end);
+};
+
+#endif // TORRENTFILE_H
@@ -0,0 +1,136 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trafficrecorder.h"
+
+#define TRAFFIC_MAGIC   0x43435452
+#define TRAFFIC_VERSION 2
+
+TrafficRecorder::TrafficRecorder(QObject *parent) :
+    QObject(parent)
+{
+}
+
+bool TrafficRecorder::open(const QString &path)
+{
+    my_file.setFileName(path);
+    if (! my_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    /// Cookies of the session are captured too, as private as the cache
+    if (! my_file.setPermissions(QFile::ReadOwner | QFile::WriteOwner))
+    {
+        my_file.close();
+        return false;
+    }
+
+    my_stream.setDevice(&my_file);
+    my_stream.setVersion(QDataStream::Qt_4_8);
+    my_stream << (quint32) TRAFFIC_MAGIC << (quint16) TRAFFIC_VERSION;
+
+    my_file.flush();
+    return true;
+}
+
+void TrafficRecorder::record(QNetworkReply *reply, const QByteArray &body, int kind, qint64 elapsed)
+{
+    if (! my_file.isOpen())
+        return;
+
+    TrafficRecord record;
+    record.operation = reply->operation();
+    record.url       = reply->url().toEncoded();
+    record.kind      = kind;
+    record.status    = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    record.elapsed   = (qint32) elapsed;
+
+    record.requestBody = reply->request().attribute(BodyAttribute).toByteArray();
+
+    record.body        = body;
+
+    foreach (const QNetworkReply::RawHeaderPair & header, reply->rawHeaderPairs())
+    {
+        record.headerNames  << header.first;
+        record.headerValues << header.second;
+    }
+
+    this->record(record);
+}
+
+void TrafficRecorder::record(const TrafficRecord &record)
+{
+    if (! my_file.isOpen())
+        return;
+
+    /// Task pages compress to a fraction of their size
+    my_stream << record.operation << record.url << record.kind
+              << record.status << record.elapsed
+              << record.headerNames << record.headerValues
+              << qCompress (record.body) << qCompress (record.requestBody);
+
+    my_file.flush();
+}
+
+QList<TrafficRecord> TrafficRecorder::load(const QString &path, bool *ok)
+{
+    QList<TrafficRecord> records;
+    if (ok)
+        *ok = false;
+
+    QFile file (path);
+    if (! file.open(QIODevice::ReadOnly))
+        return records;
+
+    QDataStream stream (&file);
+    stream.setVersion(QDataStream::Qt_4_8);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    stream >> magic >> version;
+
+    if (magic != TRAFFIC_MAGIC || version < 1 || version > TRAFFIC_VERSION)
+        return records;
+
+    while (! stream.atEnd())
+    {
+        TrafficRecord record;
+        QByteArray compressed, compressedRequest;
+
+        stream >> record.operation >> record.url >> record.kind
+               >> record.status >> record.elapsed
+               >> record.headerNames >> record.headerValues
+               >> compressed;
+
+        if (version >= 2)
+            stream >> compressedRequest;
+
+        /// Capture of a crashed session, keep what is complete
+        if (stream.status() != QDataStream::Ok)
+            break;
+
+        record.body = qUncompress (compressed);
+        if (! compressedRequest.isEmpty())
+            record.requestBody = qUncompress (compressedRequest);
+        records.append(record);
+    }
+
+    if (ok)
+        *ok = true;
+
+    return records;
+}
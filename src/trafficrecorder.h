@@ -0,0 +1,96 @@
+/*
+ *  CloudClient - A Qt cloud client for lixian.vip.xunlei.com
+ *  Copyright (C) 2012 by Aaron Lewis <the.warl0ck.1989@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRAFFICRECORDER_H
+#define TRAFFICRECORDER_H
+
+#include <QObject>
+#include <QFile>
+#include <QDataStream>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QList>
+
+/*!
+ * \brief One recorded request and its response
+ */
+struct TrafficRecord
+{
+    TrafficRecord () : operation (0), kind (-1), status (0), elapsed (0) {}
+
+    qint32 operation;
+    QByteArray url;
+
+    // ThunderCore::RequestKind, -1 if unknown
+    qint32 kind;
+
+    qint32 status;
+    qint32 elapsed;
+
+    QList<QByteArray> headerNames, headerValues;
+    QByteArray body;
+
+    // form data of a POST, empty for GETs and multipart uploads
+    QByteArray requestBody;
+};
+
+/*!
+ * \brief Appends network replies to a capture file, to be served back
+ *        by ReplayNetworkAccessManager or fed to parsers offline
+ *
+ *        The file is a QDataStream of compressed TrafficRecords
+ *        after a short header, flushed after every record. Version 1
+ *        files have no request bodies.
+ */
+class TrafficRecorder : public QObject
+{
+    Q_OBJECT
+public:
+    /*!
+     * \brief Request attribute holding the body of a POST, which the
+     *        reply does not keep
+     */
+    static const QNetworkRequest::Attribute BodyAttribute =
+            (QNetworkRequest::Attribute) (QNetworkRequest::User + 4);
+
+    explicit TrafficRecorder(QObject *parent = 0);
+
+    bool open (const QString & path);
+    bool isOpen () const { return my_file.isOpen(); }
+
+    void record (QNetworkReply *reply, const QByteArray & body, int kind, qint64 elapsed);
+
+    /*!
+     * \brief Append a record built elsewhere, e.g. a test fixture
+     */
+    void record (const TrafficRecord & record);
+
+    /*!
+     * \brief Read back a capture file
+     * \param path
+     * \param ok false if the file is missing or not a capture
+     * \return records in the order they were captured
+     */
+    static QList<TrafficRecord> load (const QString & path, bool *ok = 0);
+
+private:
+    QFile my_file;
+    QDataStream my_stream;
+};
+
+#endif // TRAFFICRECORDER_H
@@ -18,6 +18,135 @@
 
 #include "util.h"
 
+namespace {
+
+enum FileIcon
+{
+    OtherIcon,
+    MovieIcon,
+    PdfIcon,
+    MusicIcon,
+    ArchiveIcon,
+    ImageIcon,
+    FolderIcon,
+    FileIconCount
+};
+
+const char *fileIconPaths[FileIconCount] =
+{
+    ":/resources/images/exe.png",
+    ":/resources/images/movie.png",
+    ":/resources/images/pdf.png",
+    ":/resources/images/music.png",
+    ":/resources/images/rar.png",
+    ":/resources/images/image.png",
+    ":/resources/images/bt.png"
+};
+
+struct FileType
+{
+    const char *extension;
+    FileIcon icon;
+    Thunder::AutoOpen autoOpen;
+};
+
+/// Lower case, keep sorted for the binary search
+const FileType fileTypes[] =
+{
+    { "7z",   ArchiveIcon, Thunder::Never },
+    { "aac",  MusicIcon,   Thunder::Never },
+    { "ape",  MusicIcon,   Thunder::Never },
+    { "avi",  MovieIcon,   Thunder::Video },
+    { "bmp",  ImageIcon,   Thunder::Never },
+    { "bz2",  ArchiveIcon, Thunder::Never },
+    { "chm",  PdfIcon,     Thunder::Document },
+    { "flac", MusicIcon,   Thunder::Never },
+    { "flv",  MovieIcon,   Thunder::Never },
+    { "gif",  ImageIcon,   Thunder::Image },
+    { "gz",   ArchiveIcon, Thunder::Never },
+    { "img",  ArchiveIcon, Thunder::Never },
+    { "iso",  ArchiveIcon, Thunder::Never },
+    { "jpeg", ImageIcon,   Thunder::Image },
+    { "jpg",  ImageIcon,   Thunder::Image },
+    { "m4a",  MusicIcon,   Thunder::Never },
+    { "m4v",  MovieIcon,   Thunder::Never },
+    { "mkv",  MovieIcon,   Thunder::Video },
+    { "mov",  MovieIcon,   Thunder::Never },
+    { "mp3",  MusicIcon,   Thunder::Never },
+    { "mp4",  MovieIcon,   Thunder::Video },
+    { "mpeg", MovieIcon,   Thunder::Never },
+    { "mpg",  MovieIcon,   Thunder::Never },
+    { "pdf",  PdfIcon,     Thunder::Document },
+    { "png",  ImageIcon,   Thunder::Image },
+    { "psd",  ImageIcon,   Thunder::Never },
+    { "rar",  ArchiveIcon, Thunder::Document },
+    { "rm",   MovieIcon,   Thunder::Never },
+    { "rmvb", MovieIcon,   Thunder::Video },
+    { "tar",  ArchiveIcon, Thunder::Never },
+    { "tif",  ImageIcon,   Thunder::Never },
+    { "tiff", ImageIcon,   Thunder::Never },
+    { "wma",  MusicIcon,   Thunder::Never },
+    { "wmv",  MovieIcon,   Thunder::Never },
+    { "xz",   ArchiveIcon, Thunder::Never },
+    { "zip",  ArchiveIcon, Thunder::Never }
+};
+
+const int fileTypeCount = sizeof (fileTypes) / sizeof (fileTypes[0]);
+
+/*!
+ * Compare an extension with a table key, ignoring ASCII case
+ */
+int compareExtension (const QChar *extension, int size, const char *key)
+{
+    int i = 0;
+    for (; i < size && key[i]; ++i)
+    {
+        ushort c = extension[i].unicode();
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+
+        if (c != (uchar) key[i])
+            return c < (uchar) key[i] ? -1 : 1;
+    }
+
+    if (i < size)
+        return 1;
+
+    return key[i] ? -1 : 0;
+}
+
+/*!
+ * Type of a file by its extension, 0 if unknown. Nothing is allocated
+ */
+const FileType *findFileType (const QString &fileName)
+{
+    const int dot = fileName.lastIndexOf(QLatin1Char ('.'));
+    if (dot == -1)
+        return 0;
+
+    const QChar *extension = fileName.constData() + dot + 1;
+    const int size = fileName.size() - dot - 1;
+
+    int low = 0, high = fileTypeCount - 1;
+    while (low <= high)
+    {
+        const int middle = (low + high) / 2;
+        const int order  = compareExtension(extension, size, fileTypes[middle].extension);
+
+        if (order == 0)
+            return &fileTypes[middle];
+
+        if (order < 0)
+            high = middle - 1;
+        else
+            low = middle + 1;
+    }
+
+    return 0;
+}
+
+}
+
 Util::Util(QObject *parent) :
     QObject(parent)
 {
@@ -58,77 +187,10 @@ void Util::writeCookieToFile (const QString &fileName,
     Util::writeFile(fileName, result.toAscii());
 }
 
-void Util::init()
-{
-    /// not really good design. @TODO
-    static_autoOpenMapping.insert("mkv", Thunder::Video);
-    static_autoOpenMapping.insert("avi", Thunder::Video);
-    static_autoOpenMapping.insert("mp4", Thunder::Video);
-    static_autoOpenMapping.insert("rmvb", Thunder::Video);
-    static_autoOpenMapping.insert("pdf", Thunder::Document);
-    static_autoOpenMapping.insert("chm", Thunder::Document);
-    static_autoOpenMapping.insert("rar", Thunder::Document);
-
-    static_autoOpenMapping.insert("png", Thunder::Image);
-    static_autoOpenMapping.insert("jpg", Thunder::Image);
-    static_autoOpenMapping.insert("jpeg", Thunder::Image);
-    static_autoOpenMapping.insert("gif", Thunder::Image);
-
-    ///
-    static_iconMapping.insert("avi", ":/resources/images/movie.png");
-    static_iconMapping.insert("mp4", ":/resources/images/movie.png");
-    static_iconMapping.insert("mkv", ":/resources/images/movie.png");
-    static_iconMapping.insert("rm", ":/resources/images/movie.png");
-    static_iconMapping.insert("rmvb", ":/resources/images/movie.png");
-    static_iconMapping.insert("flv", ":/resources/images/movie.png");
-    static_iconMapping.insert("wmv", ":/resources/images/movie.png");
-    static_iconMapping.insert("m4v", ":/resources/images/movie.png");
-    static_iconMapping.insert("mov", ":/resources/images/movie.png");
-    static_iconMapping.insert("mpg", ":/resources/images/movie.png");
-    static_iconMapping.insert("mpeg", ":/resources/images/movie.png");
-
-    static_iconMapping.insert("pdf", ":/resources/images/pdf.png");
-    static_iconMapping.insert("chm", ":/resources/images/pdf.png");
-
-    static_iconMapping.insert("mp3", ":/resources/images/music.png");
-    static_iconMapping.insert("wma", ":/resources/images/music.png");
-    static_iconMapping.insert("flac", ":/resources/images/music.png");
-    static_iconMapping.insert("ape", ":/resources/images/music.png");
-    static_iconMapping.insert("aac", ":/resources/images/music.png");
-    static_iconMapping.insert("m4a", ":/resources/images/music.png");
-
-    static_iconMapping.insert("rar", ":/resources/images/rar.png");
-    static_iconMapping.insert("tar", ":/resources/images/rar.png");
-    static_iconMapping.insert("bz2", ":/resources/images/rar.png");
-    static_iconMapping.insert("gz", ":/resources/images/rar.png");
-    static_iconMapping.insert("iso", ":/resources/images/rar.png");
-    static_iconMapping.insert("img", ":/resources/images/rar.png");
-    static_iconMapping.insert("xz", ":/resources/images/rar.png");
-    static_iconMapping.insert("zip", ":/resources/images/rar.png");
-    static_iconMapping.insert("7z", ":/resources/images/rar.png");
-
-    static_iconMapping.insert("png", ":/resources/images/image.png");
-    static_iconMapping.insert("jpg", ":/resources/images/image.png");
-    static_iconMapping.insert("jpeg", ":/resources/images/image.png");
-    static_iconMapping.insert("gif", ":/resources/images/image.png");
-    static_iconMapping.insert("psd", ":/resources/images/image.png");
-    static_iconMapping.insert("tif", ":/resources/images/image.png");
-    static_iconMapping.insert("tiff", ":/resources/images/image.png");
-    static_iconMapping.insert("bmp", ":/resources/images/image.png");
-
-    static_iconMapping.insert("folder", ":/resources/images/bt.png");
-}
-
 Thunder::AutoOpen Util::shouldAutoOpen (const QString &fileName)
 {
-    int idx = fileName.lastIndexOf(".");
-    if (idx != -1)
-    {
-        return static_autoOpenMapping.value(fileName.mid(idx + 1).toLower(),
-                                            Thunder::Never);
-    }
-
-    return Thunder::Never;
+    const FileType *type = findFileType(fileName);
+    return type ? type->autoOpen : Thunder::Never;
 }
 
 QString Util::getMD5Hex(const QString &pass)
@@ -241,14 +303,30 @@ Thunder::File Util::getFileAttr (const QString &fileName, bool isFolder)
         file.extension = fileName.mid(idx + 1);
     }
 
-    file.icon = QIcon (static_iconMapping.value(
-                           file.extension.toLower(),
-                           ":/resources/images/exe.png"));
+    file.icon = getFileIcon(fileName, isFolder);
+
+    return file;
+}
+
+const QIcon &Util::getFileIcon(const QString &fileName, bool isFolder)
+{
+    /// Loaded once, rows only copy a reference
+    static QIcon icons[FileIconCount];
+    static bool loaded = false;
+
+    if (! loaded)
+    {
+        for (int i = 0; i < FileIconCount; ++i)
+            icons[i] = QIcon (QPixmap (fileIconPaths[i]));
+
+        loaded = true;
+    }
 
     if (isFolder)
-        file.icon = QIcon (static_iconMapping.value("folder"));
+        return icons[FolderIcon];
 
-    return file;
+    const FileType *type = findFileType(fileName);
+    return icons[type ? type->icon : OtherIcon];
 }
 
 QString Util::toReadableSize(const unsigned long long & size)
@@ -269,66 +347,26 @@ QString Util::toReadableSize(const unsigned long long & size)
     return QString ("%1 %2").arg(result).arg(labels[i]);
 }
 
-QStringList Util::parseFunctionFields(const QByteArray &d)
+int Util::parseLiveTime(const QString &text)
 {
-    // chop head (before '(')
-    QByteArray data = d;
-    data.remove(0, data.indexOf("("));
+    static const QString hours   = QString::fromUtf8("\xe5\xb0\x8f\xe6\x97\xb6");
+    static const QString minutes = QString::fromUtf8("\xe5\x88\x86");
 
-    // chop last )
-    data.chop(1);
+    int i = 0;
+    while (i < text.size() && text.at(i).isDigit())
+        ++ i;
 
-    QStringList result;
-    bool inQuote = false;
-    int field = 1;
-    int lastPos = 0;
+    if (i == 0)
+        return -1;
 
-    for (int i = 0; i < data.size(); ++i)
-    {
-        if (data.at(i) == ' ' || data.at(i) == '\t')
-            continue;
-        else if (data.at(i) == '\'')
-        {
-            // TODO: handle errors
-            if (i > 0)
-            {
-                // handle escape
-                if (data.at(i - 1) == '\\')
-                {
-                    continue;
-                }
-            }
+    const int value = text.left(i).toInt();
+    const QString & unit = text.mid(i).trimmed();
 
-            if (inQuote)
-            {
-                result.append(QString::fromUtf8(data.mid(lastPos + 1, i - lastPos - 1)));
-                inQuote = false;
-            }
-            else
-            {
-                inQuote = true;
-                lastPos = i;
-            }
-        }
-        else if (data.at(i) == ',')
-        {
-            if (! inQuote)
-            {
-                ++ field;
-            }
-        }
-        else if (! inQuote)
-        {
-            int j = i;
-            while (data.at(j) >= '0' && data.at(j) <= '9' && ++j < data.size());
-            if (j != i)
-            {
-                //                qDebug() << field << data.mid (i, j - i);
-                result.append(QString::fromUtf8(data.mid (i, j - i)));
-                i = j;
-            }
-        }
-    }
+    if (unit.startsWith(hours))
+        return value * 3600;
+    if (unit.startsWith(minutes))
+        return value * 60;
 
-    return result;
+    /// Days by default
+    return value * 86400;
 }
@@ -28,22 +28,18 @@
 #include <QFile>
 #include <QDesktopServices>
 #include <QDateTime>
+#include <QIcon>
+#include <QPixmap>
 
 #include <cstdio>
 #include "CloudObject.h"
 
-static QHash<QString, QString> static_iconMapping;
-
-static QHash<QString, Thunder::AutoOpen> static_autoOpenMapping;
-
 class Util : public QObject
 {
     Q_OBJECT
 public:
     explicit Util(QObject *parent = 0);
 
-    static void init ();
-
     /*!
      * \brief Encrypt password
      * \param plain text password
@@ -73,11 +69,13 @@ public:
     static Thunder::File getFileAttr (const QString & fileName, bool isFolder = false);
 
     /*!
-     * \brief Parse function fields, i.e queryCid('', '', 0, 'Movie')
-     * \param data
+     * \brief Icon of a file type, one instance shared by every caller.
+     *        GUI thread only
+     * \param fileName
+     * \param If target is a folder
      * \return
      */
-    static QStringList parseFunctionFields (const QByteArray & d);
+    static const QIcon & getFileIcon (const QString & fileName, bool isFolder = false);
 
     /*!
      * \brief Return a set of cookie from a mozilla styled cookie file
@@ -137,6 +135,13 @@ public:
      * \return
      */
     static bool createDirectory (const QString & filename);
+
+    /*!
+     * \brief Parse left_live_time of a cloud task, i.e "7天" or "12小时"
+     * \param text
+     * \return seconds, -1 if unknown
+     */
+    static int parseLiveTime (const QString & text);
     
 signals:
     